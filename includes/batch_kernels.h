@@ -0,0 +1,263 @@
+/*
+** Batched escape-time kernels, instantiated once per instruction set by
+** srcs/sample_batch.c (no include guard on purpose). The includer defines:
+**
+**   BK_SUFFIX          function name suffix (_sse2, _avx2, _avx512)
+**   BK_TARGET          attribute enabling the instruction set
+**   BK_WIDTH           lanes per vector
+**   bk_vec, bk_mask    vector and lane-mask types
+**   BK_SET1 BK_LOAD BK_ADD BK_SUB BK_MUL   float lane ops
+**   BK_GT BK_OR BK_BITS BK_NONE            lane-mask ops
+**   BK_HYBRID          optional: also generate the fused hybrid kernel
+**
+** Each kernel iterates BK_WIDTH points held in SoA registers. A lane
+** retires into the sticky escape mask the first time |z|^2 exceeds the
+** threshold, and the loop exits as soon as every lane has retired. The
+** arithmetic mirrors the scalar kernels operation for operation, so the
+** batch and scalar paths classify every point identically.
+**
+** Every kernel is generated by BK_KERNEL() from a start and a step, once
+** per formula so the loop carries no formula switch, and twice each: a
+** loop over julia->max_iter and a fully unrolled BATCH_UNROLLED_ITER
+** variant for the default iteration count.
+*/
+
+#define BK_CAT2(a, b)		a##b
+#define BK_CAT(a, b)		BK_CAT2(a, b)
+#define BK_ALL				((int)((1u << BK_WIDTH) - 1u))
+
+/*
+** z^2 for a quaternion whose components are (x, y, z, w)
+*/
+#define BK_SQ_X(x, y, z, w)	BK_SUB(BK_SUB(BK_SUB(BK_MUL(x, x), BK_MUL(y, y)), BK_MUL(z, z)), BK_MUL(w, w))
+#define BK_MAG_SQ(x, y, z, w) BK_ADD(BK_ADD(BK_ADD(BK_MUL(x, x), BK_MUL(y, y)), BK_MUL(z, z)), BK_MUL(w, w))
+
+static void					BK_CAT(store_inside, BK_SUFFIX)(int escaped_bits, float *out)
+{
+	for (int l = 0; l < BK_WIDTH; l++)
+		out[l] = ((escaped_bits >> l) & 1) ? 0.0f : 1.0f;
+}
+
+/*
+** Starts: z is the position (Julia) or c is (Mandelbrot, z at c_julia / 10)
+*/
+#define BK_START_JULIA \
+	zx = BK_LOAD(px); \
+	zy = BK_LOAD(py); \
+	zz = BK_LOAD(pz); \
+	zw = BK_SET1(julia->w); \
+	cx = BK_SET1(julia->c.x); \
+	cy = BK_SET1(julia->c.y); \
+	cz = BK_SET1(julia->c.z); \
+	cw = BK_SET1(julia->c.w);
+
+#define BK_START_MANDELBROT \
+	cx = BK_LOAD(px); \
+	cy = BK_LOAD(py); \
+	cz = BK_LOAD(pz); \
+	cw = BK_SET1(julia->w); \
+	zx = BK_SET1(julia->c.x * 0.1f); \
+	zy = BK_SET1(julia->c.y * 0.1f); \
+	zz = BK_SET1(julia->c.z * 0.1f); \
+	zw = BK_SET1(julia->c.w * 0.1f);
+
+/*
+** Steps: n = f(z) without the constant, numbered as formula_step()
+*/
+#define BK_STEP_SQUARE \
+	nx = BK_SQ_X(zx, zy, zz, zw); \
+	ny = BK_MUL(BK_SET1(2.0f), BK_MUL(zx, zy)); \
+	nz = BK_MUL(BK_SET1(2.0f), BK_MUL(zx, zz)); \
+	nw = BK_MUL(BK_SET1(2.0f), BK_MUL(zx, zw));
+
+#define BK_STEP_CUBIC /* z * z^2 */ \
+	sx = BK_SQ_X(zx, zy, zz, zw); \
+	sy = BK_MUL(BK_SET1(2.0f), BK_MUL(zx, zy)); \
+	sz = BK_MUL(BK_SET1(2.0f), BK_MUL(zx, zz)); \
+	sw = BK_MUL(BK_SET1(2.0f), BK_MUL(zx, zw)); \
+	nx = BK_SUB(BK_SUB(BK_SUB(BK_MUL(zx, sx), BK_MUL(zy, sy)), BK_MUL(zz, sz)), BK_MUL(zw, sw)); \
+	ny = BK_SUB(BK_ADD(BK_ADD(BK_MUL(zx, sy), BK_MUL(zy, sx)), BK_MUL(zz, sw)), BK_MUL(zw, sz)); \
+	nz = BK_ADD(BK_ADD(BK_SUB(BK_MUL(zx, sz), BK_MUL(zy, sw)), BK_MUL(zz, sx)), BK_MUL(zw, sy)); \
+	nw = BK_ADD(BK_SUB(BK_ADD(BK_MUL(zx, sw), BK_MUL(zy, sz)), BK_MUL(zz, sy)), BK_MUL(zw, sx));
+
+#define BK_STEP_SQUARE_LINEAR /* z^2 + z */ \
+	nx = BK_ADD(BK_SQ_X(zx, zy, zz, zw), zx); \
+	ny = BK_ADD(BK_MUL(BK_SET1(2.0f), BK_MUL(zx, zy)), zy); \
+	nz = BK_ADD(BK_MUL(BK_SET1(2.0f), BK_MUL(zx, zz)), zz); \
+	nw = BK_ADD(BK_MUL(BK_SET1(2.0f), BK_MUL(zx, zw)), zw);
+
+#define BK_STEP_MAGNITUDE /* |z|^2 - z^2 */ \
+	nx = BK_SUB(BK_MAG_SQ(zx, zy, zz, zw), BK_SQ_X(zx, zy, zz, zw)); \
+	ny = BK_MUL(BK_SET1(-2.0f), BK_MUL(zx, zy)); \
+	nz = BK_MUL(BK_SET1(-2.0f), BK_MUL(zx, zz)); \
+	nw = BK_MUL(BK_SET1(-2.0f), BK_MUL(zx, zw));
+
+#define BK_STEP_POWER(n) /* z^n as (A, S) in sx, sy; q in sz, see quaternion_power() */ \
+	sx = zx; \
+	sy = BK_SET1(1.0f); \
+	sz = BK_ADD(BK_ADD(BK_MUL(zy, zy), BK_MUL(zz, zz)), BK_MUL(zw, zw)); \
+	for (int bit = POWER_TOP_BIT(n) - 1; bit >= 0; bit--) \
+	{ \
+		sw = BK_SUB(BK_MUL(sx, sx), BK_MUL(sz, BK_MUL(sy, sy))); \
+		sy = BK_MUL(BK_SET1(2.0f), BK_MUL(sx, sy)); \
+		sx = sw; \
+		if (((n) >> bit) & 1) \
+		{ \
+			sw = BK_SUB(BK_MUL(sx, zx), BK_MUL(sz, sy)); \
+			sy = BK_ADD(sx, BK_MUL(zx, sy)); \
+			sx = sw; \
+		} \
+	} \
+	nx = sx; \
+	ny = BK_MUL(sy, zy); \
+	nz = BK_MUL(sy, zz); \
+	nw = BK_MUL(sy, zw);
+
+/*
+** One kernel: START sets z and c, STEP runs f, esc_sq is the squared
+** escape radius and ITER the trip count, unrolled when UNROLL says so.
+*/
+#define BK_KERNEL(name, START, STEP, esc_sq, ITER, UNROLL) \
+BK_TARGET static void		BK_CAT(name, BK_SUFFIX)(const t_julia *julia, \
+								const float *px, const float *py, const float *pz, float *out) \
+{ \
+	bk_vec					zx, zy, zz, zw; \
+	bk_vec					nx, ny, nz, nw; \
+	bk_vec					sx, sy, sz, sw; \
+	bk_vec					cx, cy, cz, cw; \
+	bk_vec					esc; \
+	bk_mask					escaped; \
+	\
+	(void)sx; (void)sy; (void)sz; (void)sw; \
+	START \
+	esc = BK_SET1(esc_sq); \
+	escaped = BK_NONE; \
+	UNROLL \
+	for (uint iter = 0; iter < (ITER); iter++) \
+	{ \
+		STEP \
+		zx = BK_ADD(nx, cx); \
+		zy = BK_ADD(ny, cy); \
+		zz = BK_ADD(nz, cz); \
+		zw = BK_ADD(nw, cw); \
+		escaped = BK_OR(escaped, BK_GT(BK_MAG_SQ(zx, zy, zz, zw), esc)); \
+		if (BK_BITS(escaped) == BK_ALL) \
+			break; \
+	} \
+	BK_CAT(store_inside, BK_SUFFIX)(BK_BITS(escaped), out); \
+}
+
+#define BK_UNROLL_FIXED		_Pragma("GCC unroll 8")
+
+/*
+** Batched sample_4D_Julia_optimized(), sample_4D_Mandelbrot() and
+** sample_4D_Julia_alternative_formula() for formulas 1 on
+*/
+#define BK_KERNEL_PAIR(name, START, STEP, esc_sq) \
+	BK_KERNEL(name, START, STEP, esc_sq, julia->max_iter, ) \
+	BK_KERNEL(BK_CAT(name, _fixed), START, STEP, esc_sq, BATCH_UNROLLED_ITER, BK_UNROLL_FIXED)
+
+BK_KERNEL_PAIR(batch_julia, BK_START_JULIA, BK_STEP_SQUARE, 4.0f)
+BK_KERNEL_PAIR(batch_mandelbrot, BK_START_MANDELBROT, BK_STEP_SQUARE, 4.0f)
+BK_KERNEL_PAIR(batch_cubic, BK_START_JULIA, BK_STEP_CUBIC, 16.0f)
+BK_KERNEL_PAIR(batch_square_linear, BK_START_JULIA, BK_STEP_SQUARE_LINEAR, 16.0f)
+BK_KERNEL_PAIR(batch_magnitude, BK_START_JULIA, BK_STEP_MAGNITUDE, 16.0f)
+BK_KERNEL_PAIR(batch_power2, BK_START_JULIA, BK_STEP_POWER(2), 16.0f)
+BK_KERNEL_PAIR(batch_power3, BK_START_JULIA, BK_STEP_POWER(3), 16.0f)
+BK_KERNEL_PAIR(batch_power4, BK_START_JULIA, BK_STEP_POWER(4), 16.0f)
+BK_KERNEL_PAIR(batch_power5, BK_START_JULIA, BK_STEP_POWER(5), 16.0f)
+BK_KERNEL_PAIR(batch_power6, BK_START_JULIA, BK_STEP_POWER(6), 16.0f)
+BK_KERNEL_PAIR(batch_power7, BK_START_JULIA, BK_STEP_POWER(7), 16.0f)
+BK_KERNEL_PAIR(batch_power8, BK_START_JULIA, BK_STEP_POWER(8), 16.0f)
+
+#ifdef BK_HYBRID
+
+/*
+** sample_4D_hybrid(): the Julia and Mandelbrot orbits of each lane in one
+** loop, their steps interleaved. Once either set has escaped in every
+** lane the other runs on alone, so the pair never does more steps than
+** the two kernels would. Each set's membership is stored apart, for the
+** caller to blend. Only instantiated where BK_HYBRID says both orbits fit
+** in the vector registers.
+*/
+# define BK_HYBRID_JULIA \
+	BK_STEP_SQUARE \
+	zx = BK_ADD(nx, cx); \
+	zy = BK_ADD(ny, cy); \
+	zz = BK_ADD(nz, cz); \
+	zw = BK_ADD(nw, cw); \
+	j_escaped = BK_OR(j_escaped, BK_GT(BK_MAG_SQ(zx, zy, zz, zw), esc));
+
+# define BK_HYBRID_MANDELBROT \
+	nx = BK_SQ_X(mx, my, mz, mw); \
+	ny = BK_MUL(BK_SET1(2.0f), BK_MUL(mx, my)); \
+	nz = BK_MUL(BK_SET1(2.0f), BK_MUL(mx, mz)); \
+	nw = BK_MUL(BK_SET1(2.0f), BK_MUL(mx, mw)); \
+	mx = BK_ADD(nx, qx); \
+	my = BK_ADD(ny, qy); \
+	mz = BK_ADD(nz, qz); \
+	mw = BK_ADD(nw, qw); \
+	m_escaped = BK_OR(m_escaped, BK_GT(BK_MAG_SQ(mx, my, mz, mw), esc));
+
+BK_TARGET static void		BK_CAT(batch_hybrid, BK_SUFFIX)(const t_julia *julia,
+								const float *px, const float *py, const float *pz,
+								float *julia_out, float *mandel_out)
+{
+	bk_vec					zx, zy, zz, zw;
+	bk_vec					mx, my, mz, mw;
+	bk_vec					nx, ny, nz, nw;
+	bk_vec					cx, cy, cz, cw;
+	bk_vec					qx, qy, qz, qw;			// Mandelbrot c
+	bk_vec					esc;
+	bk_mask					j_escaped;
+	bk_mask					m_escaped;
+	uint					iter;
+
+	BK_START_JULIA
+	qx = zx;
+	qy = zy;
+	qz = zz;
+	qw = zw;
+	mx = BK_SET1(julia->c.x * 0.1f);
+	my = BK_SET1(julia->c.y * 0.1f);
+	mz = BK_SET1(julia->c.z * 0.1f);
+	mw = BK_SET1(julia->c.w * 0.1f);
+	esc = BK_SET1(4.0f);
+	j_escaped = BK_NONE;
+	m_escaped = BK_NONE;
+	for (iter = 0; iter < julia->max_iter
+		&& BK_BITS(j_escaped) != BK_ALL && BK_BITS(m_escaped) != BK_ALL; iter++)
+	{
+		BK_HYBRID_JULIA
+		BK_HYBRID_MANDELBROT
+	}
+	for (; iter < julia->max_iter && BK_BITS(j_escaped) != BK_ALL; iter++)
+	{
+		BK_HYBRID_JULIA
+	}
+	for (; iter < julia->max_iter && BK_BITS(m_escaped) != BK_ALL; iter++)
+	{
+		BK_HYBRID_MANDELBROT
+	}
+	BK_CAT(store_inside, BK_SUFFIX)(BK_BITS(j_escaped), julia_out);
+	BK_CAT(store_inside, BK_SUFFIX)(BK_BITS(m_escaped), mandel_out);
+}
+
+# undef BK_HYBRID_JULIA
+# undef BK_HYBRID_MANDELBROT
+
+#endif
+
+#undef BK_ALL
+#undef BK_SQ_X
+#undef BK_MAG_SQ
+#undef BK_START_JULIA
+#undef BK_START_MANDELBROT
+#undef BK_STEP_SQUARE
+#undef BK_STEP_CUBIC
+#undef BK_STEP_SQUARE_LINEAR
+#undef BK_STEP_MAGNITUDE
+#undef BK_STEP_POWER
+#undef BK_KERNEL
+#undef BK_UNROLL_FIXED
+#undef BK_KERNEL_PAIR
@@ -0,0 +1,165 @@
+/*
+** Double-double Julia kernel, instantiated once per instruction set by
+** srcs/sample_double_double.c (no include guard on purpose). The includer
+** defines:
+**
+**   DK_SUFFIX          function name suffix (_avx2, _avx512)
+**   DK_TARGET          attribute enabling the instruction set and FMA
+**   DK_WIDTH           lanes per vector
+**   dk_vec, dk_mask    vector and lane-mask types
+**   DK_SET1 DK_LOAD_PS DK_ADD DK_SUB DK_MUL DK_DIV   double lane ops
+**   DK_FMS             a * b - c, rounded once
+**   DK_GT DK_OR DK_BITS DK_NONE                      lane-mask ops
+**
+** Each lane holds a number as an unevaluated sum hi + lo of two doubles.
+** The error-free transforms mirror the scalar ones in
+** srcs/sample_double_double.c operation for operation, and a fused
+** multiply-subtract is correctly rounded on every path, so vector and
+** scalar kernels classify every point identically.
+*/
+
+#define DK_CAT2(a, b)		a##b
+#define DK_CAT(a, b)		DK_CAT2(a, b)
+#define DK_FN(name)			DK_CAT(name, DK_SUFFIX)
+#define DK_ALL				((int)((1u << DK_WIDTH) - 1u))
+#define dk_dd				DK_FN(t_ddv)
+
+typedef struct				DK_FN(s_ddv)
+{
+	dk_vec					hi;
+	dk_vec					lo;
+}							dk_dd;
+
+/* s + e == a + b exactly, for any a and b */
+DK_TARGET static inline dk_dd	DK_FN(ddv_two_sum)(dk_vec a, dk_vec b)
+{
+	dk_dd					r;
+	dk_vec					bb;
+
+	r.hi = DK_ADD(a, b);
+	bb = DK_SUB(r.hi, a);
+	r.lo = DK_ADD(DK_SUB(a, DK_SUB(r.hi, bb)), DK_SUB(b, bb));
+	return r;
+}
+
+/* s + e == a + b exactly, for |a| >= |b| */
+DK_TARGET static inline dk_dd	DK_FN(ddv_quick_sum)(dk_vec a, dk_vec b)
+{
+	dk_dd					r;
+
+	r.hi = DK_ADD(a, b);
+	r.lo = DK_SUB(b, DK_SUB(r.hi, a));
+	return r;
+}
+
+DK_TARGET static inline dk_dd	DK_FN(ddv_add)(dk_dd a, dk_dd b)
+{
+	dk_dd					s;
+	dk_dd					t;
+
+	s = DK_FN(ddv_two_sum)(a.hi, b.hi);
+	t = DK_FN(ddv_two_sum)(a.lo, b.lo);
+	s = DK_FN(ddv_quick_sum)(s.hi, DK_ADD(s.lo, t.hi));
+	return DK_FN(ddv_quick_sum)(s.hi, DK_ADD(s.lo, t.lo));
+}
+
+DK_TARGET static inline dk_dd	DK_FN(ddv_sub)(dk_dd a, dk_dd b)
+{
+	b.hi = DK_SUB(DK_SET1(0.0), b.hi);
+	b.lo = DK_SUB(DK_SET1(0.0), b.lo);
+	return DK_FN(ddv_add)(a, b);
+}
+
+/* a + b for a plain double b */
+DK_TARGET static inline dk_dd	DK_FN(ddv_add_d)(dk_dd a, dk_vec b)
+{
+	dk_dd					s;
+
+	s = DK_FN(ddv_two_sum)(a.hi, b);
+	return DK_FN(ddv_quick_sum)(s.hi, DK_ADD(s.lo, a.lo));
+}
+
+DK_TARGET static inline dk_dd	DK_FN(ddv_mul)(dk_dd a, dk_dd b)
+{
+	dk_vec					p;
+	dk_vec					e;
+
+	p = DK_MUL(a.hi, b.hi);
+	e = DK_FMS(a.hi, b.hi, p);
+	e = DK_ADD(e, DK_ADD(DK_MUL(a.hi, b.lo), DK_MUL(a.lo, b.hi)));
+	return DK_FN(ddv_quick_sum)(p, e);
+}
+
+DK_TARGET static inline dk_dd	DK_FN(ddv_sqr)(dk_dd a)
+{
+	dk_vec					p;
+	dk_vec					e;
+
+	p = DK_MUL(a.hi, a.hi);
+	e = DK_FMS(a.hi, a.hi, p);
+	e = DK_ADD(e, DK_MUL(DK_SET1(2.0), DK_MUL(a.hi, a.lo)));
+	return DK_FN(ddv_quick_sum)(p, e);
+}
+
+/* 2 * a, exact */
+DK_TARGET static inline dk_dd	DK_FN(ddv_twice)(dk_dd a)
+{
+	a.hi = DK_ADD(a.hi, a.hi);
+	a.lo = DK_ADD(a.lo, a.lo);
+	return a;
+}
+
+/*
+** sample_4D_Julia_double_double() on DK_WIDTH points
+*/
+DK_TARGET static void		DK_FN(batch_julia_dd)(const t_julia *julia, double zoom_level,
+								const float *px, const float *py, const float *pz, float *out)
+{
+	dk_dd					x, y, z, w;
+	dk_dd					nx, ny, nz;
+	dk_vec					cx, cy, cz, cw;
+	dk_vec					zoom;
+	dk_vec					esc;
+	dk_vec					mag;
+	dk_mask					escaped;
+
+	zoom = DK_SET1(zoom_level);
+	x.hi = DK_DIV(DK_LOAD_PS(px), zoom);
+	y.hi = DK_DIV(DK_LOAD_PS(py), zoom);
+	z.hi = DK_DIV(DK_LOAD_PS(pz), zoom);
+	w.hi = DK_SET1((double)julia->w / zoom_level);
+	x.lo = DK_SET1(0.0);
+	y.lo = x.lo;
+	z.lo = x.lo;
+	w.lo = x.lo;
+	cx = DK_SET1((double)julia->c.x);
+	cy = DK_SET1((double)julia->c.y);
+	cz = DK_SET1((double)julia->c.z);
+	cw = DK_SET1((double)julia->c.w);
+	esc = DK_SET1(4.0);
+	escaped = DK_NONE;
+	for (uint iter = 0; iter < julia->max_iter; iter++)
+	{
+		nx = DK_FN(ddv_sub)(DK_FN(ddv_sub)(DK_FN(ddv_sub)(DK_FN(ddv_sqr)(x),
+			DK_FN(ddv_sqr)(y)), DK_FN(ddv_sqr)(z)), DK_FN(ddv_sqr)(w));
+		ny = DK_FN(ddv_add_d)(DK_FN(ddv_twice)(DK_FN(ddv_mul)(x, y)), cy);
+		nz = DK_FN(ddv_add_d)(DK_FN(ddv_twice)(DK_FN(ddv_mul)(x, z)), cz);
+		w = DK_FN(ddv_add_d)(DK_FN(ddv_twice)(DK_FN(ddv_mul)(x, w)), cw);
+		x = DK_FN(ddv_add_d)(nx, cx);
+		y = ny;
+		z = nz;
+		mag = DK_ADD(DK_ADD(DK_ADD(DK_MUL(x.hi, x.hi), DK_MUL(y.hi, y.hi)),
+			DK_MUL(z.hi, z.hi)), DK_MUL(w.hi, w.hi));
+		escaped = DK_OR(escaped, DK_GT(mag, esc));
+		if (DK_BITS(escaped) == DK_ALL)
+			break;
+	}
+	for (int l = 0; l < DK_WIDTH; l++)
+		out[l] = ((DK_BITS(escaped) >> l) & 1) ? 0.0f : 1.0f;
+}
+
+#undef DK_CAT2
+#undef DK_CAT
+#undef DK_FN
+#undef DK_ALL
+#undef dk_dd
@@ -7,6 +7,7 @@
 # define GRID_ERR 4
 # define NO_ARG_ERR 5
 # define BAD_FILE_ERR 6
+# define FORMULA_ERR 7
 
 # define MALLOC_FAIL "\nERROR: Could not allocate memory\n"
 # define OPEN_FILE "\nERROR: Could not open the file\n"
@@ -16,9 +17,10 @@
 # define ASK_ITER "Please enter number of iterations: "
 
 # define ARGS "\nERROR: Invalid program arguments\n"
-# define USAGE "\nUSAGE: \n./morphosis *step_size* *q.x* *q.y* *q.z* *q.w*\n./morphosis -d\t\t\t\t\t\t| to use default values\n./morphosis -m *file_name.mat*\t\t\t\t| to read data from matrix\n./morphosis -p *file_name*\t\t\t\t| to read data from poem\n\n"
+# define USAGE "\nUSAGE: \n./morphosis *step_size* *q.x* *q.y* *q.z* *q.w*\n./morphosis -d\t\t\t\t\t\t| to use default values\n./morphosis -m *file_name.mat*\t\t\t\t| to read data from matrix\n./morphosis -p *file_name*\t\t\t\t| to read data from poem\n./morphosis -f *formula*\t\t\t\t| to iterate a custom formula, e.g. \"z^3 + c\"\n./morphosis -F *file_name*\t\t\t\t| to read a custom formula from a file\n\n"
 # define NO_ARG "\nThis program calculates, displays and saves a 4d Julia set as an OBJ file in the current directory\nWhen fractal is displayed, press ESC to exit or S to save and export the mesh\n"
 
 # define BAD_FILE "\nERROR: Invalid data in the file\n\n"
+# define FORMULA "\nERROR: Invalid formula\n\n"
 
 #endif
@@ -0,0 +1,254 @@
+/*
+** Custom formula interpreter, instantiated once per instruction set by
+** srcs/formula_vm.c (no include guard on purpose). The includer defines:
+**
+**   FK_SUFFIX          function name suffix (_generic, _avx2, _avx512)
+**   FK_TARGET          attribute enabling the instruction set
+**   FK_WIDTH           lanes per vector
+**   fk_vec, fk_mask    GCC vector types of FK_WIDTH floats and ints
+**
+** Every register holds its four components as FORMULA_LANES floats each,
+** and an op runs over them FK_WIDTH lanes at a time, in fk_vec blocks.
+** Escaped lanes are masked off, and once enough have escaped to empty
+** a block the live ones are moved down over them, so the blocks worked
+** on shrink as orbits escape, as the fixed kernels stop once every lane
+** has. Operations mirror the scalar formulas of
+** srcs/mathematical_enhancements.c one for one, so every level
+** classifies every point alike.
+*/
+
+#define FK_CAT2(a, b)		a##b
+#define FK_CAT(a, b)		FK_CAT2(a, b)
+#define FK_FN(name)			FK_CAT(name, FK_SUFFIX)
+#define FK_V(reg, k, b)		(*(fk_vec *)&r[reg][k][(b) * FK_WIDTH])
+#define FK_BLOCKS(lanes)	(((lanes) + FK_WIDTH - 1) / FK_WIDTH)
+
+/* Load the four components of register reg in block b into v##x .. v##w */
+#define FK_LOAD(v, reg, b)	(v##x = FK_V(reg, 0, b), v##y = FK_V(reg, 1, b), \
+							v##z = FK_V(reg, 2, b), v##w = FK_V(reg, 3, b))
+#define FK_STORE(reg, b, x, y, z, w) (FK_V(reg, 0, b) = (x), FK_V(reg, 1, b) = (y), \
+							FK_V(reg, 2, b) = (z), FK_V(reg, 3, b) = (w))
+
+/*
+** One op on the first blocks of every register. Operands are loaded
+** before dst is stored, since the compiler reuses registers.
+*/
+FK_TARGET static void		FK_FN(formula_op)(float (*r)[4][FORMULA_LANES], const t_formula_op *op, uint blocks)
+{
+	fk_vec					ax, ay, az, aw;
+	fk_vec					bx, by, bz, bw;
+	fk_vec					q, s, t;
+	uint					n;
+	int						top;
+
+	switch (op->op)
+	{
+		case FOP_ADD:
+			for (uint b = 0; b < blocks; b++)
+			{
+				FK_LOAD(a, op->a, b);
+				FK_LOAD(b, op->b, b);
+				FK_STORE(op->dst, b, ax + bx, ay + by, az + bz, aw + bw);
+			}
+			break;
+		case FOP_SUB:
+			for (uint b = 0; b < blocks; b++)
+			{
+				FK_LOAD(a, op->a, b);
+				FK_LOAD(b, op->b, b);
+				FK_STORE(op->dst, b, ax - bx, ay - by, az - bz, aw - bw);
+			}
+			break;
+		case FOP_MUL:
+			for (uint b = 0; b < blocks; b++)
+			{
+				FK_LOAD(a, op->a, b);
+				FK_LOAD(b, op->b, b);
+				FK_STORE(op->dst, b,
+					(ax * bx) - (ay * by) - (az * bz) - (aw * bw),
+					(ax * by) + (ay * bx) + (az * bw) - (aw * bz),
+					(ax * bz) - (ay * bw) + (az * bx) + (aw * by),
+					(ax * bw) + (ay * bz) - (az * by) + (aw * bx));
+			}
+			break;
+		case FOP_SQR:
+			for (uint b = 0; b < blocks; b++)
+			{
+				FK_LOAD(a, op->a, b);
+				FK_STORE(op->dst, b, (ax * ax) - (ay * ay) - (az * az) - (aw * aw),
+					2.0f * (ax * ay), 2.0f * (ax * az), 2.0f * (ax * aw));
+			}
+			break;
+		case FOP_POW:
+			// quaternion_power()'s (A, S) pair, A kept in bx
+			n = op->b;
+			top = 31 - __builtin_clz(n);
+			for (uint b = 0; b < blocks; b++)
+			{
+				FK_LOAD(a, op->a, b);
+				q = (ay * ay) + (az * az) + (aw * aw);
+				bx = ax;
+				s = (fk_vec){0} + 1.0f;
+				for (int bit = top - 1; bit >= 0; bit--)
+				{
+					t = (bx * bx) - (q * (s * s));
+					s = 2.0f * (bx * s);
+					bx = t;
+					if ((n >> bit) & 1)
+					{
+						t = (bx * ax) - (q * s);
+						s = bx + (ax * s);
+						bx = t;
+					}
+				}
+				FK_STORE(op->dst, b, bx, s * ay, s * az, s * aw);
+			}
+			break;
+		case FOP_SCALE:
+			for (uint b = 0; b < blocks; b++)
+			{
+				FK_LOAD(a, op->a, b);
+				FK_STORE(op->dst, b, ax * op->k, ay * op->k, az * op->k, aw * op->k);
+			}
+			break;
+		case FOP_NEG:
+			for (uint b = 0; b < blocks; b++)
+			{
+				FK_LOAD(a, op->a, b);
+				FK_STORE(op->dst, b, -ax, -ay, -az, -aw);
+			}
+			break;
+		case FOP_CONJ:
+			for (uint b = 0; b < blocks; b++)
+			{
+				FK_LOAD(a, op->a, b);
+				FK_STORE(op->dst, b, ax, -ay, -az, -aw);
+			}
+			break;
+		case FOP_NORM:
+			q = (fk_vec){0};
+			for (uint b = 0; b < blocks; b++)
+			{
+				FK_LOAD(a, op->a, b);
+				FK_STORE(op->dst, b, (ax * ax) + (ay * ay) + (az * az) + (aw * aw), q, q, q);
+			}
+			break;
+	}
+}
+
+/*
+** Move the lanes still alive in the first blocks down over the escaped
+** ones, writing the escaped ones out, and return how many are left
+*/
+FK_TARGET static uint		FK_FN(formula_compact)(const t_formula_program *prog, float (*r)[4][FORMULA_LANES],
+								int *alive, unsigned char *lane, uint blocks, float *out, uint n)
+{
+	uint					kept;
+
+	kept = 0;
+	for (uint l = 0; l < blocks * FK_WIDTH; l++)
+	{
+		if (!alive[l])
+		{
+			if (lane[l] < n)
+				out[lane[l]] = 0.0f;
+			continue;
+		}
+		for (uint k = 0; k < 4; k++)
+		{
+			r[FREG_Z][k][kept] = r[FREG_Z][k][l];
+			if (prog->uses_p)
+				r[FREG_P][k][kept] = r[FREG_P][k][l];
+		}
+		lane[kept++] = lane[l];
+	}
+	for (uint l = 0; l < blocks * FK_WIDTH; l++)
+		alive[l] = l < kept ? -1 : 0;
+	for (uint l = kept; l < blocks * FK_WIDTH; l++)
+		lane[l] = FORMULA_LANES;
+	return kept;
+}
+
+/*
+** prog on the n <= FORMULA_LANES points (x, y, z, julia->w), written to
+** out as 1.0f inside and 0.0f escaped. Escaped lanes are only masked off
+** until moving the live ones down saves a whole block.
+*/
+FK_TARGET static void		FK_FN(formula_batch)(const t_formula_program *prog, const t_julia *julia,
+								const float *x, const float *y, const float *z, float *out, uint n)
+{
+	float					r[FORMULA_MAX_REGS][4][FORMULA_LANES] __attribute__((aligned(64)));
+	int						alive[FORMULA_LANES] __attribute__((aligned(64)));
+	unsigned char			lane[FORMULA_LANES];
+	const float				*c;
+	fk_vec					mag;
+	fk_mask					esc, escapes;
+	uint					live, blocks;
+
+	// Lanes past n in the last block start at the origin, already dead
+	blocks = FK_BLOCKS(n);
+	for (uint l = 0; l < blocks * FK_WIDTH; l++)
+	{
+		r[FREG_P][0][l] = l < n ? x[l] : 0.0f;
+		r[FREG_P][1][l] = l < n ? y[l] : 0.0f;
+		r[FREG_P][2][l] = l < n ? z[l] : 0.0f;
+		r[FREG_P][3][l] = julia->w;
+		alive[l] = l < n ? -1 : 0;
+		lane[l] = (unsigned char)l;
+	}
+	for (uint k = 0; k < 4; k++)
+		memcpy(r[FREG_Z][k], r[FREG_P][k], blocks * FK_WIDTH * sizeof(float));
+	for (uint reg = FREG_C; reg < FORMULA_MAX_REGS; reg++)
+	{
+		if (reg != FREG_C && !(prog->const_mask & (1u << reg)))
+			continue;
+		c = reg == FREG_C ? &julia->c.x : &prog->consts[reg].x;
+		for (uint b = 0; b < blocks; b++)
+			FK_STORE(reg, b, (fk_vec){0} + c[0], (fk_vec){0} + c[1], (fk_vec){0} + c[2], (fk_vec){0} + c[3]);
+	}
+	for (uint i = 0; i < prog->setup_len; i++)
+		FK_FN(formula_op)(r, &prog->code[i], blocks);
+
+	live = n;
+	for (uint iter = 0; iter < julia->max_iter && live; iter++)
+	{
+		for (uint i = prog->setup_len; i < prog->len; i++)
+			FK_FN(formula_op)(r, &prog->code[i], blocks);
+		if (prog->result != FREG_Z)
+		{
+			for (uint k = 0; k < 4; k++)
+				memcpy(r[FREG_Z][k], r[prog->result][k], blocks * FK_WIDTH * sizeof(float));
+		}
+
+		// Same escape test as sample_4D_Julia_alternative_formula()
+		escapes = (fk_mask){0};
+		for (uint b = 0; b < blocks; b++)
+		{
+			mag = (FK_V(FREG_Z, 0, b) * FK_V(FREG_Z, 0, b)) + (FK_V(FREG_Z, 1, b) * FK_V(FREG_Z, 1, b))
+				+ (FK_V(FREG_Z, 2, b) * FK_V(FREG_Z, 2, b)) + (FK_V(FREG_Z, 3, b) * FK_V(FREG_Z, 3, b));
+			esc = (mag > 16.0f) & *(fk_mask *)&alive[b * FK_WIDTH];
+			*(fk_mask *)&alive[b * FK_WIDTH] &= ~esc;
+			escapes -= esc;
+		}
+		for (uint l = 0; l < FK_WIDTH; l++)
+			live -= (uint)escapes[l];
+		if (live && FK_BLOCKS(live) < blocks)
+		{
+			live = FK_FN(formula_compact)(prog, r, alive, lane, blocks, out, n);
+			blocks = FK_BLOCKS(live);
+		}
+	}
+	for (uint l = 0; l < blocks * FK_WIDTH; l++)
+	{
+		if (lane[l] < n)
+			out[lane[l]] = alive[l] ? 1.0f : 0.0f;
+	}
+}
+
+#undef FK_CAT2
+#undef FK_CAT
+#undef FK_FN
+#undef FK_V
+#undef FK_BLOCKS
+#undef FK_LOAD
+#undef FK_STORE
@@ -42,6 +42,8 @@ void 						scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
 void 						createVBO(t_gl *gl, GLsizeiptr size, GLfloat *points);
 void						createVAO(t_gl *gl);
+void						createEBO(t_gl *gl, GLsizeiptr size, GLuint *indices);
+void						swap_in_back_buffers(t_gl *gl);
 
 void 						makeShaderProgram(t_gl *gl);
 char						*readShaderSource(char *src_name);
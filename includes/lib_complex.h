@@ -20,6 +20,10 @@ typedef struct {
     unsigned int x, y;
 } uint2;
 
+typedef struct {
+    unsigned int x, y, z;
+} uint3;
+
 // Standard type definitions
 typedef unsigned int uint;
 
@@ -293,5 +293,287 @@ uint						tritable[][16] =
 			{0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 			{-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}};
 
+/*
+** Binary fields (values strictly 0 or 1) put every edge vertex exactly on
+** the edge's inside corner, so a case's whole geometry reduces to corner
+** numbers. binary_tri_count is the number of triangles of each case and
+** binary_tri_corners the corner (0-7) of each of their vertices, in
+** tritable order. 4 KB in total, small enough to stay in L1.
+*/
+const unsigned char			binary_tri_count[256] =
+	{0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 2,
+	1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+	1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+	2, 3, 3, 2, 3, 4, 4, 3, 3, 4, 4, 3, 4, 5, 5, 2,
+	1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 4,
+	2, 3, 3, 4, 3, 4, 2, 3, 3, 4, 4, 5, 4, 5, 3, 2,
+	3, 4, 4, 3, 4, 5, 3, 2, 4, 5, 5, 4, 5, 2, 4, 1,
+	1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 3,
+	2, 3, 3, 4, 3, 4, 4, 5, 3, 2, 4, 3, 4, 3, 5, 2,
+	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 4,
+	3, 4, 4, 3, 4, 5, 5, 4, 4, 3, 5, 2, 5, 4, 2, 1,
+	2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 2, 3, 3, 2,
+	3, 4, 4, 5, 4, 5, 5, 2, 4, 3, 5, 4, 3, 2, 4, 1,
+	3, 4, 4, 5, 4, 5, 3, 4, 4, 5, 5, 2, 3, 4, 2, 1,
+	2, 3, 3, 2, 3, 4, 2, 1, 3, 2, 4, 1, 2, 1, 1, 0};
+
+const unsigned char			binary_tri_corners[256][15] =
+			{{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 2, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 2, 2, 1, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{2, 0, 0, 2, 2, 0, 2, 1, 0, 0, 0, 0, 0, 0, 0},
+			{3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 3, 3, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 1, 1, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 3, 3, 1, 1, 3, 1, 0, 3, 0, 0, 0, 0, 0, 0},
+			{3, 2, 2, 3, 2, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 2, 2, 0, 0, 2, 0, 3, 2, 0, 0, 0, 0, 0, 0},
+			{3, 1, 1, 3, 3, 1, 3, 2, 1, 0, 0, 0, 0, 0, 0},
+			{1, 0, 2, 2, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{4, 0, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 1, 1, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{4, 1, 1, 4, 4, 1, 4, 0, 1, 0, 0, 0, 0, 0, 0},
+			{2, 2, 2, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 4, 4, 0, 0, 4, 2, 2, 2, 0, 0, 0, 0, 0, 0},
+			{1, 2, 2, 1, 1, 2, 4, 4, 4, 0, 0, 0, 0, 0, 0},
+			{2, 2, 1, 2, 1, 4, 2, 4, 0, 4, 1, 4, 0, 0, 0},
+			{4, 4, 4, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{3, 4, 4, 3, 3, 4, 3, 0, 4, 0, 0, 0, 0, 0, 0},
+			{1, 1, 1, 4, 4, 4, 3, 3, 3, 0, 0, 0, 0, 0, 0},
+			{4, 4, 3, 1, 4, 3, 1, 3, 3, 1, 3, 1, 0, 0, 0},
+			{3, 2, 2, 3, 3, 2, 4, 4, 4, 0, 0, 0, 0, 0, 0},
+			{2, 3, 2, 2, 4, 3, 2, 0, 4, 4, 3, 4, 0, 0, 0},
+			{4, 4, 4, 1, 1, 3, 1, 3, 2, 3, 1, 3, 0, 0, 0},
+			{4, 4, 3, 4, 3, 1, 1, 3, 2, 0, 0, 0, 0, 0, 0},
+			{5, 5, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{5, 5, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 5, 5, 1, 5, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 5, 5, 0, 0, 5, 0, 1, 5, 0, 0, 0, 0, 0, 0},
+			{2, 2, 2, 5, 5, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 2, 2, 2, 5, 5, 5, 0, 0, 0, 0, 0, 0},
+			{5, 2, 2, 5, 5, 2, 5, 1, 2, 0, 0, 0, 0, 0, 0},
+			{2, 2, 5, 0, 2, 5, 0, 5, 5, 0, 5, 0, 0, 0, 0},
+			{5, 5, 5, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 3, 3, 0, 0, 3, 5, 5, 5, 0, 0, 0, 0, 0, 0},
+			{1, 5, 5, 1, 1, 5, 3, 3, 3, 0, 0, 0, 0, 0, 0},
+			{3, 1, 5, 3, 5, 0, 3, 0, 3, 5, 0, 5, 0, 0, 0},
+			{2, 3, 3, 2, 2, 3, 5, 5, 5, 0, 0, 0, 0, 0, 0},
+			{5, 5, 5, 0, 0, 2, 0, 2, 2, 0, 3, 2, 0, 0, 0},
+			{5, 5, 1, 5, 1, 3, 5, 3, 2, 3, 1, 3, 0, 0, 0},
+			{5, 5, 0, 5, 0, 2, 2, 0, 3, 0, 0, 0, 0, 0, 0},
+			{5, 4, 4, 5, 4, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{5, 0, 0, 5, 5, 0, 5, 4, 0, 0, 0, 0, 0, 0, 0},
+			{1, 4, 4, 1, 1, 4, 1, 5, 4, 0, 0, 0, 0, 0, 0},
+			{1, 5, 0, 0, 5, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{5, 4, 4, 5, 5, 4, 2, 2, 2, 0, 0, 0, 0, 0, 0},
+			{2, 2, 2, 5, 5, 0, 5, 0, 0, 5, 4, 0, 0, 0, 0},
+			{4, 1, 2, 4, 2, 5, 4, 5, 4, 2, 5, 2, 0, 0, 0},
+			{2, 2, 5, 2, 5, 0, 0, 5, 4, 0, 0, 0, 0, 0, 0},
+			{4, 5, 5, 4, 4, 5, 3, 3, 3, 0, 0, 0, 0, 0, 0},
+			{5, 5, 4, 5, 4, 3, 5, 3, 0, 3, 4, 3, 0, 0, 0},
+			{3, 3, 3, 1, 1, 4, 1, 4, 4, 1, 5, 4, 0, 0, 0},
+			{3, 3, 1, 3, 1, 4, 4, 1, 5, 0, 0, 0, 0, 0, 0},
+			{5, 5, 4, 4, 5, 4, 2, 2, 3, 2, 3, 3, 0, 0, 0},
+			{5, 4, 0, 5, 0, 5, 4, 3, 0, 2, 0, 2, 3, 2, 0},
+			{3, 2, 1, 3, 1, 3, 2, 5, 1, 4, 1, 4, 5, 4, 1},
+			{3, 2, 5, 4, 3, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{6, 6, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 6, 6, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 1, 1, 6, 6, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 0, 0, 1, 1, 0, 6, 6, 6, 0, 0, 0, 0, 0, 0},
+			{2, 6, 6, 2, 6, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{2, 6, 6, 2, 2, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 6, 6, 1, 1, 6, 1, 2, 6, 0, 0, 0, 0, 0, 0},
+			{6, 1, 0, 6, 0, 2, 6, 2, 6, 0, 2, 0, 0, 0, 0},
+			{3, 3, 3, 6, 6, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{3, 0, 0, 3, 3, 0, 6, 6, 6, 0, 0, 0, 0, 0, 0},
+			{1, 1, 1, 3, 3, 3, 6, 6, 6, 0, 0, 0, 0, 0, 0},
+			{6, 6, 6, 1, 1, 3, 1, 3, 3, 1, 0, 3, 0, 0, 0},
+			{6, 3, 3, 6, 6, 3, 6, 2, 3, 0, 0, 0, 0, 0, 0},
+			{0, 0, 3, 0, 3, 6, 0, 6, 2, 6, 3, 6, 0, 0, 0},
+			{3, 3, 6, 1, 3, 6, 1, 6, 6, 1, 6, 1, 0, 0, 0},
+			{6, 6, 1, 6, 1, 3, 3, 1, 0, 0, 0, 0, 0, 0, 0},
+			{6, 6, 6, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{4, 0, 0, 4, 4, 0, 6, 6, 6, 0, 0, 0, 0, 0, 0},
+			{1, 1, 1, 6, 6, 6, 4, 4, 4, 0, 0, 0, 0, 0, 0},
+			{6, 6, 6, 1, 1, 4, 1, 4, 0, 4, 1, 4, 0, 0, 0},
+			{6, 2, 2, 6, 6, 2, 4, 4, 4, 0, 0, 0, 0, 0, 0},
+			{2, 2, 6, 6, 2, 6, 0, 0, 4, 0, 4, 4, 0, 0, 0},
+			{4, 4, 4, 1, 1, 6, 1, 6, 6, 1, 2, 6, 0, 0, 0},
+			{4, 0, 1, 4, 1, 4, 0, 2, 1, 6, 1, 6, 2, 6, 1},
+			{3, 3, 3, 4, 4, 4, 6, 6, 6, 0, 0, 0, 0, 0, 0},
+			{6, 6, 6, 4, 4, 3, 4, 3, 0, 3, 4, 3, 0, 0, 0},
+			{1, 1, 1, 4, 4, 4, 3, 3, 3, 6, 6, 6, 0, 0, 0},
+			{1, 3, 1, 1, 3, 3, 1, 4, 3, 4, 3, 4, 6, 6, 6},
+			{4, 4, 4, 3, 3, 6, 3, 6, 2, 6, 3, 6, 0, 0, 0},
+			{6, 2, 3, 6, 3, 6, 2, 0, 3, 4, 3, 4, 0, 4, 3},
+			{1, 6, 1, 1, 6, 6, 1, 3, 6, 3, 6, 3, 4, 4, 4},
+			{6, 6, 1, 6, 1, 3, 4, 4, 1, 4, 3, 1, 0, 0, 0},
+			{6, 5, 5, 6, 5, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{5, 6, 6, 5, 5, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{6, 1, 1, 6, 6, 1, 6, 5, 1, 0, 0, 0, 0, 0, 0},
+			{0, 0, 1, 0, 1, 6, 0, 6, 5, 6, 1, 6, 0, 0, 0},
+			{2, 5, 5, 2, 2, 5, 2, 6, 5, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 2, 2, 5, 2, 5, 5, 2, 6, 5, 0, 0, 0},
+			{1, 2, 5, 5, 2, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 2, 0, 2, 5, 5, 2, 6, 0, 0, 0, 0, 0, 0},
+			{6, 5, 5, 6, 6, 5, 3, 3, 3, 0, 0, 0, 0, 0, 0},
+			{0, 0, 3, 3, 0, 3, 5, 5, 6, 5, 6, 6, 0, 0, 0},
+			{3, 3, 3, 1, 1, 6, 1, 6, 5, 6, 1, 6, 0, 0, 0},
+			{6, 5, 1, 6, 1, 6, 5, 0, 1, 3, 1, 3, 0, 3, 1},
+			{5, 6, 5, 5, 3, 6, 5, 2, 3, 3, 6, 3, 0, 0, 0},
+			{0, 3, 2, 0, 2, 0, 3, 6, 2, 5, 2, 5, 6, 5, 2},
+			{3, 3, 6, 3, 6, 1, 1, 6, 5, 0, 0, 0, 0, 0, 0},
+			{6, 5, 0, 3, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{4, 6, 6, 4, 4, 6, 4, 5, 6, 0, 0, 0, 0, 0, 0},
+			{0, 4, 0, 0, 6, 4, 0, 5, 6, 6, 4, 6, 0, 0, 0},
+			{6, 6, 4, 1, 6, 4, 1, 4, 4, 1, 4, 1, 0, 0, 0},
+			{6, 6, 4, 6, 4, 1, 1, 4, 0, 0, 0, 0, 0, 0, 0},
+			{2, 2, 6, 2, 6, 4, 2, 4, 5, 4, 6, 4, 0, 0, 0},
+			{2, 6, 5, 2, 5, 2, 6, 4, 5, 0, 5, 0, 4, 0, 5},
+			{4, 4, 1, 4, 1, 6, 6, 1, 2, 0, 0, 0, 0, 0, 0},
+			{4, 0, 2, 6, 4, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{3, 3, 3, 6, 6, 4, 6, 4, 5, 4, 6, 4, 0, 0, 0},
+			{3, 0, 4, 3, 4, 3, 0, 5, 4, 6, 4, 6, 5, 6, 4},
+			{1, 4, 1, 1, 4, 4, 1, 6, 4, 6, 4, 6, 3, 3, 3},
+			{3, 3, 1, 3, 1, 4, 6, 6, 1, 6, 4, 1, 0, 0, 0},
+			{4, 5, 6, 4, 6, 4, 5, 2, 6, 3, 6, 3, 2, 3, 6},
+			{0, 5, 2, 3, 6, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{4, 4, 1, 4, 1, 6, 3, 3, 1, 3, 6, 1, 0, 0, 0},
+			{4, 3, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{7, 7, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 7, 7, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 1, 1, 7, 7, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 1, 1, 0, 0, 1, 7, 7, 7, 0, 0, 0, 0, 0, 0},
+			{2, 2, 2, 7, 7, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{2, 2, 2, 0, 0, 0, 7, 7, 7, 0, 0, 0, 0, 0, 0},
+			{2, 1, 1, 2, 2, 1, 7, 7, 7, 0, 0, 0, 0, 0, 0},
+			{7, 7, 7, 2, 2, 0, 2, 0, 0, 2, 1, 0, 0, 0, 0},
+			{7, 3, 3, 7, 3, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{7, 0, 0, 7, 7, 0, 7, 3, 0, 0, 0, 0, 0, 0, 0},
+			{3, 7, 7, 3, 3, 7, 1, 1, 1, 0, 0, 0, 0, 0, 0},
+			{1, 7, 3, 1, 0, 7, 1, 1, 0, 0, 7, 7, 0, 0, 0},
+			{2, 7, 7, 2, 2, 7, 2, 3, 7, 0, 0, 0, 0, 0, 0},
+			{2, 7, 7, 2, 7, 2, 2, 0, 7, 2, 0, 0, 0, 0, 0},
+			{1, 3, 7, 1, 7, 2, 1, 2, 1, 7, 2, 7, 0, 0, 0},
+			{7, 7, 2, 7, 2, 0, 0, 2, 1, 0, 0, 0, 0, 0, 0},
+			{7, 4, 4, 7, 4, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 7, 7, 0, 0, 7, 0, 4, 7, 0, 0, 0, 0, 0, 0},
+			{4, 7, 7, 4, 4, 7, 1, 1, 1, 0, 0, 0, 0, 0, 0},
+			{1, 4, 7, 1, 7, 0, 1, 0, 1, 7, 0, 7, 0, 0, 0},
+			{7, 4, 4, 7, 7, 4, 2, 2, 2, 0, 0, 0, 0, 0, 0},
+			{2, 2, 2, 0, 0, 7, 0, 7, 7, 0, 4, 7, 0, 0, 0},
+			{4, 7, 4, 4, 7, 7, 1, 2, 1, 2, 2, 1, 0, 0, 0},
+			{2, 1, 0, 2, 0, 2, 1, 4, 0, 7, 0, 7, 4, 7, 0},
+			{4, 3, 3, 4, 4, 3, 4, 7, 3, 0, 0, 0, 0, 0, 0},
+			{0, 4, 3, 4, 7, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 1, 1, 3, 3, 4, 3, 4, 7, 4, 3, 4, 0, 0, 0},
+			{1, 1, 4, 1, 4, 3, 3, 4, 7, 0, 0, 0, 0, 0, 0},
+			{4, 2, 3, 4, 7, 2, 4, 4, 7, 7, 2, 2, 0, 0, 0},
+			{2, 2, 0, 2, 0, 7, 7, 0, 4, 0, 0, 0, 0, 0, 0},
+			{4, 7, 3, 4, 3, 4, 7, 2, 3, 1, 3, 1, 2, 1, 3},
+			{2, 1, 4, 7, 2, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{5, 5, 5, 7, 7, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 5, 5, 5, 7, 7, 7, 0, 0, 0, 0, 0, 0},
+			{5, 1, 1, 5, 5, 1, 7, 7, 7, 0, 0, 0, 0, 0, 0},
+			{7, 7, 7, 0, 0, 5, 0, 5, 5, 0, 1, 5, 0, 0, 0},
+			{5, 5, 5, 2, 2, 2, 7, 7, 7, 0, 0, 0, 0, 0, 0},
+			{7, 7, 7, 2, 2, 2, 0, 0, 0, 5, 5, 5, 0, 0, 0},
+			{7, 7, 7, 5, 5, 2, 5, 2, 2, 5, 1, 2, 0, 0, 0},
+			{0, 5, 0, 0, 5, 5, 0, 2, 5, 2, 5, 2, 7, 7, 7},
+			{7, 3, 3, 7, 7, 3, 5, 5, 5, 0, 0, 0, 0, 0, 0},
+			{5, 5, 5, 0, 0, 7, 0, 7, 3, 7, 0, 7, 0, 0, 0},
+			{3, 7, 3, 3, 7, 7, 1, 5, 1, 5, 5, 1, 0, 0, 0},
+			{7, 3, 0, 7, 0, 7, 3, 1, 0, 5, 0, 5, 1, 5, 0},
+			{5, 5, 5, 2, 2, 7, 2, 7, 7, 2, 3, 7, 0, 0, 0},
+			{2, 7, 2, 2, 7, 7, 2, 0, 7, 0, 7, 0, 5, 5, 5},
+			{5, 1, 2, 5, 2, 5, 1, 3, 2, 7, 2, 7, 3, 7, 2},
+			{7, 7, 2, 7, 2, 0, 5, 5, 2, 5, 0, 2, 0, 0, 0},
+			{7, 5, 5, 7, 7, 5, 7, 4, 5, 0, 0, 0, 0, 0, 0},
+			{0, 7, 7, 0, 7, 0, 0, 5, 7, 0, 5, 5, 0, 0, 0},
+			{1, 7, 4, 1, 5, 7, 1, 1, 5, 5, 7, 7, 0, 0, 0},
+			{7, 7, 0, 7, 0, 5, 5, 0, 1, 0, 0, 0, 0, 0, 0},
+			{2, 2, 2, 5, 5, 7, 5, 7, 4, 7, 5, 7, 0, 0, 0},
+			{0, 7, 0, 0, 7, 7, 0, 5, 7, 5, 7, 5, 2, 2, 2},
+			{7, 4, 5, 7, 5, 7, 4, 1, 5, 2, 5, 2, 1, 2, 5},
+			{7, 7, 0, 7, 0, 5, 2, 2, 0, 2, 5, 0, 0, 0, 0},
+			{5, 4, 5, 5, 3, 4, 5, 7, 3, 3, 4, 3, 0, 0, 0},
+			{5, 5, 7, 5, 7, 0, 0, 7, 3, 0, 0, 0, 0, 0, 0},
+			{1, 5, 4, 1, 4, 1, 5, 7, 4, 3, 4, 3, 7, 3, 4},
+			{1, 5, 7, 3, 1, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{2, 3, 7, 2, 7, 2, 3, 4, 7, 5, 7, 5, 4, 5, 7},
+			{2, 2, 0, 2, 0, 7, 5, 5, 0, 5, 7, 0, 0, 0, 0},
+			{1, 3, 4, 5, 7, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{2, 5, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{7, 6, 6, 7, 6, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{7, 6, 6, 7, 7, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{6, 7, 7, 6, 6, 7, 1, 1, 1, 0, 0, 0, 0, 0, 0},
+			{6, 7, 6, 6, 7, 7, 1, 0, 1, 0, 0, 1, 0, 0, 0},
+			{7, 2, 2, 7, 7, 2, 7, 6, 2, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 2, 2, 7, 2, 7, 6, 7, 2, 7, 0, 0, 0},
+			{1, 7, 6, 1, 2, 7, 1, 1, 2, 2, 7, 7, 0, 0, 0},
+			{7, 6, 2, 7, 2, 7, 6, 1, 2, 0, 2, 0, 1, 0, 2},
+			{3, 6, 6, 3, 3, 6, 3, 7, 6, 0, 0, 0, 0, 0, 0},
+			{0, 3, 0, 0, 6, 3, 0, 7, 6, 6, 3, 6, 0, 0, 0},
+			{1, 1, 1, 6, 6, 3, 6, 3, 7, 3, 6, 3, 0, 0, 0},
+			{1, 0, 3, 1, 3, 1, 0, 7, 3, 6, 3, 6, 7, 6, 3},
+			{2, 3, 6, 3, 7, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 7, 0, 7, 2, 2, 7, 6, 0, 0, 0, 0, 0, 0},
+			{1, 1, 3, 1, 3, 6, 6, 3, 7, 0, 0, 0, 0, 0, 0},
+			{1, 0, 7, 6, 1, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{6, 4, 4, 6, 6, 4, 6, 7, 4, 0, 0, 0, 0, 0, 0},
+			{6, 0, 4, 6, 7, 0, 6, 6, 7, 7, 0, 0, 0, 0, 0},
+			{1, 1, 1, 4, 4, 6, 4, 6, 7, 6, 4, 6, 0, 0, 0},
+			{6, 7, 4, 6, 4, 6, 7, 0, 4, 1, 4, 1, 0, 1, 4},
+			{2, 6, 2, 2, 4, 6, 2, 7, 4, 4, 6, 4, 0, 0, 0},
+			{0, 4, 7, 0, 7, 0, 4, 6, 7, 2, 7, 2, 6, 2, 7},
+			{1, 2, 6, 1, 6, 1, 2, 7, 6, 4, 6, 4, 7, 4, 6},
+			{1, 4, 6, 2, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{3, 6, 6, 3, 6, 3, 3, 4, 6, 3, 4, 4, 0, 0, 0},
+			{6, 6, 3, 6, 3, 4, 4, 3, 0, 0, 0, 0, 0, 0, 0},
+			{3, 6, 3, 3, 6, 6, 3, 4, 6, 4, 6, 4, 1, 1, 1},
+			{6, 6, 3, 6, 3, 4, 1, 1, 3, 1, 4, 3, 0, 0, 0},
+			{4, 4, 6, 4, 6, 3, 3, 6, 2, 0, 0, 0, 0, 0, 0},
+			{0, 4, 6, 2, 0, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{4, 4, 6, 4, 6, 3, 1, 1, 6, 1, 3, 6, 0, 0, 0},
+			{1, 4, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{5, 7, 7, 5, 5, 7, 5, 6, 7, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 5, 5, 7, 5, 7, 7, 5, 6, 7, 0, 0, 0},
+			{1, 6, 7, 1, 7, 5, 1, 5, 1, 7, 5, 7, 0, 0, 0},
+			{0, 1, 5, 0, 5, 0, 1, 6, 5, 7, 5, 7, 6, 7, 5},
+			{5, 7, 7, 5, 7, 5, 5, 2, 7, 5, 2, 2, 0, 0, 0},
+			{5, 7, 5, 5, 7, 7, 5, 2, 7, 2, 7, 2, 0, 0, 0},
+			{7, 7, 5, 7, 5, 2, 2, 5, 1, 0, 0, 0, 0, 0, 0},
+			{7, 7, 5, 7, 5, 2, 0, 0, 5, 0, 2, 5, 0, 0, 0},
+			{3, 5, 6, 3, 7, 5, 3, 3, 7, 7, 5, 5, 0, 0, 0},
+			{5, 6, 7, 5, 7, 5, 6, 3, 7, 0, 7, 0, 3, 0, 7},
+			{3, 7, 6, 3, 6, 3, 7, 5, 6, 1, 6, 1, 5, 1, 6},
+			{1, 6, 3, 0, 7, 5, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{5, 5, 2, 5, 2, 7, 7, 2, 3, 0, 0, 0, 0, 0, 0},
+			{5, 5, 2, 5, 2, 7, 0, 0, 2, 0, 7, 2, 0, 0, 0},
+			{5, 1, 3, 7, 5, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{5, 0, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{5, 6, 4, 6, 7, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 5, 0, 5, 7, 7, 5, 6, 0, 0, 0, 0, 0, 0},
+			{1, 1, 6, 1, 6, 4, 4, 6, 7, 0, 0, 0, 0, 0, 0},
+			{0, 1, 6, 7, 0, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{2, 2, 7, 2, 7, 5, 5, 7, 4, 0, 0, 0, 0, 0, 0},
+			{0, 0, 5, 0, 5, 7, 2, 2, 5, 2, 7, 5, 0, 0, 0},
+			{1, 2, 7, 4, 1, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 2, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{3, 3, 4, 3, 4, 6, 6, 4, 5, 0, 0, 0, 0, 0, 0},
+			{5, 6, 3, 0, 5, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{3, 3, 4, 3, 4, 6, 1, 1, 4, 1, 6, 4, 0, 0, 0},
+			{1, 6, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{2, 3, 4, 5, 2, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 5, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{1, 3, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+			{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}};
 
 #endif
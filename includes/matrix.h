@@ -23,7 +23,7 @@ char							*read_matrix(FILE *stream);
 void							process_matrix(char *file, t_mat_conv_data *data, int mode);
 void							free_matrix1(int ***m);
 int								***alloc_matrix1(void);
-void							fill_matrix(int **matrix, int number, int reset);
+void							fill_matrix(int **matrix, int number, int index);
 
 void 							matrix_hash(int **matrix, t_mat_conv_data *data);
 void 							matrix_hash2(char *matrix, t_mat_conv_data *data);
@@ -5,6 +5,8 @@
 # include "stdlib.h"
 # include "ctype.h"
 # include "string.h"
+# include <float.h>
+# include <limits.h>
 
 # include <gl_includes.h>
 # include <errors.h>
@@ -14,12 +16,141 @@
 # define OUTPUT_FILE "./fractal.obj"
 # define OUTPUT_PRECISION 3
 
+// Planes (sampling) or cell layers (meshing) per z-slab brick of a parallel build
+# define LATTICE_BRICK_DEPTH 2
+// Full lattices larger than this are built by streaming two planes at a time
+# define STREAMING_LATTICE_BYTES ((size_t)1 << 30)
+// Upper bound on build worker threads
+# define MAX_BUILD_THREADS 256
+
+// Vector instruction sets for batched sampling (see detect_simd_level())
+# define SIMD_SCALAR 0
+# define SIMD_SSE2 1
+# define SIMD_AVX2 2
+# define SIMD_AVX512 3
+# define SIMD_LEVELS 4
+
+// Quaternion formulas (quaternion_formula): four fixed ones, then z^n + c
+// for n from FORMULA_POWER_MIN to FORMULA_POWER_MAX
+# define FORMULA_POWER 4
+# define FORMULA_POWER_MIN 2
+# define FORMULA_POWER_MAX 8
+# define FORMULA_COUNT (FORMULA_POWER + FORMULA_POWER_MAX - FORMULA_POWER_MIN + 1)
+# define FORMULA_EXPONENT(f) ((f) - FORMULA_POWER + FORMULA_POWER_MIN)
+// Highest set bit of an exponent up to FORMULA_POWER_MAX
+# define POWER_TOP_BIT(n) ((n) >= 8 ? 3 : (n) >= 4 ? 2 : (n) >= 2 ? 1 : 0)
+// quaternion_formula of the custom formula, once one is loaded
+# define FORMULA_CUSTOM FORMULA_COUNT
+
+// Custom formula register code (t_formula_program): fixed registers, ops
+# define FREG_Z 0					// The orbit's current value
+# define FREG_P 1					// The sample's position, where the orbit started
+# define FREG_C 2					// The Julia constant
+# define FREG_FIRST 3				// First register for constants and temporaries
+# define FOP_ADD 0
+# define FOP_SUB 1
+# define FOP_MUL 2					// Quaternion product
+# define FOP_SQR 3					// a * a
+# define FOP_POW 4					// a ^ b, in closed form
+# define FOP_SCALE 5				// a * k for a real k
+# define FOP_NEG 6
+# define FOP_CONJ 7
+# define FOP_NORM 8					// |a|^2 as a real
+// Largest exponent a custom formula may raise to
+# define FORMULA_MAX_EXPONENT 16
+// Lanes the interpreter runs each op across
+# define FORMULA_LANES SAMPLE_BATCH_CHUNK
+
+// Batched kernel families; the alternative formulas follow in quaternion_formula order
+# define BATCH_JULIA 0
+# define BATCH_MANDELBROT 1
+# define BATCH_CUBIC 2
+# define BATCH_SQUARE_LINEAR 3
+# define BATCH_MAGNITUDE 4
+# define BATCH_POWER 5				// z^n + c, from n = FORMULA_POWER_MIN
+# define BATCH_KINDS (BATCH_POWER + FORMULA_POWER_MAX - FORMULA_POWER_MIN + 1)
+// t_sampler batch_kind besides the families: Julia and Mandelbrot blended,
+// double-double or perturbation deep zoom, a custom formula, or point kernels only
+# define BATCH_HYBRID BATCH_KINDS
+# define BATCH_DOUBLE_DOUBLE (BATCH_KINDS + 1)
+# define BATCH_PERTURBATION (BATCH_KINDS + 2)
+# define BATCH_CUSTOM (BATCH_KINDS + 3)			// The custom formula's interpreter
+# define BATCH_NONE -1
+
+// Deep zoom precision of the Julia set (see deep_zoom_precision()) and the zoom levels it changes at
+# define DEEP_ZOOM_OFF 0
+# define DEEP_ZOOM_DOUBLE 1
+# define DEEP_ZOOM_DOUBLE_DOUBLE 2
+# define DEEP_ZOOM_PERTURBATION 3
+# define DEEP_ZOOM_DOUBLE_MIN 1000.0
+# define DEEP_ZOOM_DD_MIN 1.0e6
+// Deepest zoom: double-double still tells neighbouring points apart at the finest steps
+# define DEEP_ZOOM_MAX 1.0e14
+// Deepest zoom of the fractals only sampled in float (see max_zoom_level())
+# define FLOAT_ZOOM_MAX 1.0e6
+
+// max_iter whose kernels are generated fully unrolled (the default)
+# define BATCH_UNROLLED_ITER 6
+
+// Points per sample_fractal_batch() chunk (multiple of every vector width)
+# define SAMPLE_BATCH_CHUNK 64
+
+// Smallest initial capacity of the flat triangle buffer (triangles)
+# define FLAT_TRIANGLES_MIN 1024
+
+// Empty slot of a t_edge_cache
+# define MESH_NO_VERTEX 0xFFFFFFFFu
+
+// Coarse-to-fine sampling: smallest brick (cells), deepest subdivision, and
+// fewest top-level bricks across the lattice.
+// Leaves smaller than 8 cells queue too few points per batch to fill SIMD lanes.
+# define LATTICE_MS_MIN_CELLS 8
+# define LATTICE_MS_MAX_DEPTH 5
+# define LATTICE_MS_MIN_BRICKS 4
+
+// Two-level budget: the classification cap is max_iter / DIVISOR, at least MIN_ITER.
+// Full-depth points are iterated in tasks of REFINE_TASK_POINTS.
+# define TWO_LEVEL_ITER_DIVISOR 4
+# define TWO_LEVEL_MIN_ITER 2
+# define REFINE_TASK_POINTS 1024
+
+// Symmetries a lattice build samples under (bits of lattice_symmetry())
+# define SYM_MIRROR_Y 1				// y -> -y
+# define SYM_MIRROR_Z 2				// z -> -z
+# define SYM_SWAP_YZ 4				// y <-> z
+# define SYM_CENTRAL 8				// (x, y, z) -> (-x, -y, -z)
+
+// Quantity the samplers return (data->field_mode)
+# define FIELD_MEMBERSHIP 0			// 1 inside the set, 0 outside
+# define FIELD_DISTANCE 1			// Signed distance estimate, > 0 inside
+# define FIELD_ESCAPE_TIME 2		// Normalised iteration count, one shell per iso level
+# define FIELD_MODES 3
+
+// Orbit cache state bit of escaped orbits; the other bits hold the escape step
+# define ORBIT_ESCAPED 0x80000000u
+// Largest orbit cache kept between builds (20 bytes per lattice point)
+# define ORBIT_CACHE_MAX_BYTES ((size_t)1 << 30)
+
+// Periodicity checking: an orbit back within this distance of its saved point is cycling
+# define PERIODICITY_TOL_F (4.0f * FLT_EPSILON)
+# define PERIODICITY_TOL_D (4.0 * DBL_EPSILON)
+
+// Whether the build running on data has been asked to stop
+# define BUILD_CANCELLED(data) ((data)->cancel && *(data)->cancel)
+
+// 64-bit words per lattice row of a bit-packed occupancy lattice
+# define OCCUPANCY_WORDS(dim) (((dim) + 63) / 64)
+
+// Linear index of lattice point (x, y, z) in a dim^3 shared-corner lattice
+# define LATTICE_INDEX(x, y, z, dim) ((((size_t)(z) * (dim)) + (y)) * (dim) + (x))
+
 t_data						*init_data(void);
 t_gl						*init_gl_struct(void);
 t_julia 					*init_julia(void);
 t_fract						*init_fract(void);
 void						init_grid(t_data *data);
 void						init_vertex(t_data *data);
+void						init_lattice(t_data *data);
 
 void 						error(int errno, t_data *data);
 float						s_size_warning(float size);
@@ -27,19 +158,29 @@ float						s_size_warning(float size);
 float3						**arr_float3_cat(float3 **f_from, float3 **f_to, uint2 *len);
 float3 						**alloc_float3_arr(float3 **mem, uint2 *len);
 
-// Memory optimization functions
-void						init_triangle_pool(t_data *data);
-float3						*get_triangle_from_pool(t_data *data);
-void						reset_triangle_pool(t_data *data);
-void						clean_triangle_pool(t_data *data);
-
 // Cache-friendly triangle storage
+int							tribuf_init(t_tribuf *buf, uint capacity);
+int							tribuf_reserve(t_tribuf *buf, uint count);
+int							tribuf_append(t_tribuf *buf, float3 *tris, uint count);
+void						tribuf_free(t_tribuf *buf);
 void						init_flat_triangles(t_data *data);
 void						add_triangle_to_flat(t_data *data, float3 *vertices);
 void						clean_flat_triangles(t_data *data);
+void						init_mesh(t_data *data);
+uint						mesh_add_vertex(t_mesh *mesh, float3 p);
+void						mesh_add_triangle(t_mesh *mesh, uint a, uint b, uint c);
+void						clean_mesh(t_data *data);
 
 // Optimized marching cubes
-float3						**polygonise_optimized(float3 *v_pos, float *v_val, uint2 *pos, t_data *data);
+uint						polygonise_optimized(float3 *v_pos, float *v_val, uint2 *pos, t_data *data);
+uint						polygonise_lattice(float *plane0, float *plane1, uint3 cell, t_data *data, t_tribuf *out);
+uint						polygonise_lattice_binary(float *plane0, float *plane1, uint3 cell, t_data *data, t_tribuf *out);
+uint						polygonise_lattice_row_bits(const uint64_t *plane0, const uint64_t *plane1,
+								uint y, uint z, t_data *data, t_tribuf *out);
+uint						polygonise_lattice_indexed(float *plane0, float *plane1, uint3 cell, t_data *data, t_edge_cache *cache);
+int							init_edge_cache(t_edge_cache *cache, uint dim);
+void						advance_edge_cache(t_edge_cache *cache);
+void						free_edge_cache(t_edge_cache *cache);
 
 // Graphics pipeline optimizations
 void						createVBO_optimized(t_gl *gl, GLsizeiptr size, GLfloat *points);
@@ -48,6 +189,10 @@ void						updateVBO_optimized(t_gl *gl, GLsizeiptr size, GLfloat *points);
 // Enhanced rendering features
 void						processInput_enhanced(GLFWwindow *window, t_gl *gl, t_data *data);
 void						regenerate_fractal(t_data *data);
+void						start_regeneration(t_data *data);
+void						request_regeneration(t_data *data);
+int							poll_regeneration(t_data *data);
+void						stop_regeneration(t_data *data);
 void						print_parameter_info(t_data *data);
 void						handle_render_mode_change(t_gl *gl);
 void						handle_camera_controls(GLFWwindow *window, t_gl *gl);
@@ -65,16 +210,65 @@ void						use_enhanced_shaders(t_gl *gl, t_data *data);
 double						cl_quat_mod_d(cl_quat_d q);
 cl_quat_d					cl_quat_mult_d(cl_quat_d q1, cl_quat_d q2);
 cl_quat_d					cl_quat_sum_d(cl_quat_d q1, cl_quat_d q2);
-float						sample_4D_Julia_deep_zoom(t_julia *julia, double3 pos, double zoom_level);
+float						sample_4D_Julia_deep_zoom(const t_julia *julia, double3 pos, double zoom_level);
+float						sample_4D_Julia_double_double(const t_julia *julia, double3 pos, double zoom_level);
+void						sample_batch_double_double(int level, const t_julia *julia, double zoom_level,
+								const float *x, const float *y, const float *z, float *out, uint n);
+uint						double_double_orbit(const t_julia *julia, double3 pos, double zoom_level, cl_quat *orbit);
+int							deep_zoom_precision(t_data *data);
+double						max_zoom_level(t_data *data);
+void						prepare_reference_orbit(t_data *data);
+float						sample_4D_Julia_perturbation(const t_sampler *s, float3 pos);
+void						sample_batch_perturbation(const t_sampler *s,
+								const float *x, const float *y, const float *z, float *out, uint n);
 
 // Alternative fractal types
-float						sample_4D_Mandelbrot(t_julia *julia, float3 pos);
-float						sample_4D_Julia_alternative_formula(t_julia *julia, float3 pos, int formula);
+float						sample_4D_Mandelbrot(const t_julia *julia, float3 pos);
+float						sample_4D_hybrid(const t_julia *julia, float3 pos);
+float						hybrid_mix(float julia_val, float mandel_val, float3 pos);
+float						sample_4D_Julia_alternative_formula(const t_julia *julia, float3 pos, int formula);
+float						sample_4D_distance(const t_julia *julia, float3 pos, int mandelbrot, int formula);
+float						sample_4D_escape_time(const t_julia *julia, float3 pos, int mandelbrot, int formula);
+float						escape_time_value(uint step, float mag_sq, float radius, int formula, uint max_iter);
+float						orbit_start(const t_julia *julia, float3 pos, int mandelbrot, int formula, cl_quat *z, cl_quat *c);
+cl_quat						formula_step(cl_quat z, int formula);
+cl_quat						quaternion_power(cl_quat z, int n);
+int							formula_degree(int formula);
+const char					*quaternion_formula_name(int formula);
+
+// Custom formulas: compiled once, interpreted across batches of lanes
+int							compile_formula(const char *source, t_formula_program *prog);
+void						load_formula(t_data *data, const char *source);
+void						load_formula_file(t_data *data, const char *path);
+void						run_formula(int level, const t_formula_program *prog, const t_julia *julia,
+								const float *x, const float *y, const float *z, float *out, uint n);
 
 // Advanced sampling techniques
-int							should_refine_grid_cell(t_data *data, float3 center, float cell_size, int current_depth);
-float						sample_with_supersampling(t_data *data, float3 pos);
-float						sample_fractal_enhanced(t_data *data, float3 pos);
+float						supersample_offset(uint k, uint samples, float step);
+float						sample_with_supersampling(const t_sampler *s, float3 pos);
+float						sample_fractal_enhanced(const t_sampler *s, float3 pos);
+void						sample_fractal_batch(const t_sampler *s, const float *x, const float *y, const float *z, float *out, uint n);
+int							field_is_binary(t_data *data);
+int							sampled_field_kind(t_data *data);
+
+// Sampler of one point, resolved per build by init_sampler()
+typedef float				(*t_point_kernel)(const t_sampler *s, float3 pos);
+void						init_sampler(t_data *data);
+void						resolve_sampler(t_sampler *s);
+int							prepare_orbit_cache(t_data *data);
+void						sample_orbit_cache(t_data *data, size_t first, const float *x, const float *y,
+								const float *z, float *out, uint n);
+void						free_orbit_cache(t_orbit_cache *cache);
+uint						shell_count(t_data *data);
+void						select_shell(t_data *data, uint shell);
+
+// Batched SIMD kernels with runtime dispatch
+int							detect_simd_level(void);
+const char					*simd_level_name(int level);
+void						sample_batch(int level, int kind, const t_julia *julia,
+								const float *x, const float *y, const float *z, float *out, uint n);
+void						sample_batch_hybrid(int level, const t_julia *julia,
+								const float *x, const float *y, const float *z, float *out, uint n);
 
 void 						clean_up(t_data *data);
 void						clean_gl(t_gl *gl);
@@ -86,13 +280,35 @@ void 						calculate_point_cloud(t_data *data);
 void						create_grid(t_data *data);
 void 						subdiv_grid(float start, float stop, float step, float *axis);
 void						define_voxel(t_fract *fract, float s);
+uint						lattice_cells(t_fract *fract);
+size_t						lattice_bytes(t_fract *fract, int packed);
+float3						lattice_point_pos(t_fract *fract, uint x, uint y, uint z);
 
 void						build_fractal(t_data *data);
+void						build_fractal_lattice(t_data *data);
+uint						coarse_to_fine_depth(t_data *data);
+void						sample_lattice_coarse_to_fine(t_data *data);
+uint						two_level_low_iter(t_data *data);
+void						refine_lattice_boundary(t_data *data, uint low_iter);
+void						supersample_lattice_boundary(t_data *data, uint samples);
+uint						lattice_symmetry(t_data *data);
+void						init_lattice_symmetry(t_data *data, uint maps, t_lattice_symmetry *s);
+uint64_t					lattice_symmetry_row(const t_lattice_symmetry *s, uint y, uint z, uint x0, uint x1);
+void						copy_lattice_symmetric(t_lattice_symmetry *s);
+void						sample_lattice_symmetric(t_data *data, uint maps);
+int							lattice_culling(t_data *data);
+void						sample_lattice_culled(t_data *data, uint maps);
+void						build_fractal_streaming(t_data *data);
+
+// Work-stealing thread pool
+typedef void				(*t_task_fn)(void *ctx, uint task, uint worker);
+uint						default_thread_count(void);
+void						run_tasks_stealing(uint num_tasks, uint num_threads, t_task_fn fn, void *ctx);
 
-float 						sample_4D_Julia(t_julia *julia, float3 pos);
+float 						sample_4D_Julia(const t_julia *julia, float3 pos);
 
 // Optimized Julia set functions
-float						sample_4D_Julia_optimized(t_julia *julia, float3 pos);
+float						sample_4D_Julia_optimized(const t_julia *julia, float3 pos);
 float						cl_quat_mod_fast(cl_quat q);
 
 float3 						**polygonise(float3 *v_pos, float *v_val, uint2 *pos, t_data *data);
@@ -0,0 +1,101 @@
+/*
+** Perturbation Julia kernel, instantiated once per instruction set by
+** srcs/perturbation.c (no include guard on purpose). The includer
+** defines:
+**
+**   PK_SUFFIX          function name suffix (_avx2, _avx512)
+**   PK_TARGET          attribute enabling the instruction set
+**   PK_WIDTH           lanes per vector
+**   pk_vec, pk_int     float and int32 vector types
+**   pk_mask            lane-mask type
+**   PK_SET1 PK_LOAD PK_ADD PK_SUB PK_MUL             float lane ops
+**   PK_GATHER(p, i)    p[i] for float offsets i
+**   PK_ISET1 PK_IADD PK_IEQ                          int lane ops
+**   PK_BLEND PK_IBLEND (m, a, b): b where m, else a
+**   PK_GT PK_OR PK_BITS PK_NONE                      lane-mask ops
+**
+** Every lane keeps its own place m in the reference orbit, as a float
+** offset 4 * m into it, and rebases on its own; the reference points
+** are gathered. Operations mirror perturbation_orbit() in
+** srcs/perturbation.c one for one, so vector and scalar kernels classify
+** every point identically.
+*/
+
+#define PK_CAT2(a, b)		a##b
+#define PK_CAT(a, b)		PK_CAT2(a, b)
+#define PK_FN(name)			PK_CAT(name, PK_SUFFIX)
+#define PK_ALL				((int)((1u << PK_WIDTH) - 1u))
+
+/*
+** perturbation_orbit() on PK_WIDTH points, starting at offsets d from
+** the reference
+*/
+PK_TARGET static void		PK_FN(batch_julia_perturbation)(const t_sampler *s,
+								const float *dx, const float *dy, const float *dz, float *out)
+{
+	const float				*ref;
+	pk_vec					x, y, z, w;
+	pk_vec					nx, ny, nz;
+	pk_vec					rx, ry, rz, rw;
+	pk_vec					zx, zy, zz, zw;
+	pk_vec					two, esc;
+	pk_vec					mag, dmag;
+	pk_int					m, four, end;
+	pk_mask					escaped;
+	pk_mask					rebase;
+
+	ref = &s->reference[0].x;
+	x = PK_LOAD(dx);
+	y = PK_LOAD(dy);
+	z = PK_LOAD(dz);
+	w = PK_SET1(0.0f);
+	two = PK_SET1(2.0f);
+	esc = PK_SET1(4.0f);
+	m = PK_ISET1(0);
+	four = PK_ISET1(4);
+	end = PK_ISET1(4 * (int)s->reference_len);
+	escaped = PK_NONE;
+	for (uint iter = 0; iter < s->julia.max_iter; iter++)
+	{
+		rx = PK_GATHER(ref, m);
+		ry = PK_GATHER(ref + 1, m);
+		rz = PK_GATHER(ref + 2, m);
+		rw = PK_GATHER(ref + 3, m);
+		nx = PK_ADD(PK_MUL(two, PK_SUB(PK_SUB(PK_SUB(PK_MUL(rx, x), PK_MUL(ry, y)), PK_MUL(rz, z)), PK_MUL(rw, w))),
+			PK_SUB(PK_SUB(PK_SUB(PK_MUL(x, x), PK_MUL(y, y)), PK_MUL(z, z)), PK_MUL(w, w)));
+		ny = PK_MUL(two, PK_ADD(PK_ADD(PK_MUL(rx, y), PK_MUL(x, ry)), PK_MUL(x, y)));
+		nz = PK_MUL(two, PK_ADD(PK_ADD(PK_MUL(rx, z), PK_MUL(x, rz)), PK_MUL(x, z)));
+		w = PK_MUL(two, PK_ADD(PK_ADD(PK_MUL(rx, w), PK_MUL(x, rw)), PK_MUL(x, w)));
+		x = nx;
+		y = ny;
+		z = nz;
+		m = PK_IADD(m, four);
+		zx = PK_ADD(PK_GATHER(ref, m), x);
+		zy = PK_ADD(PK_GATHER(ref + 1, m), y);
+		zz = PK_ADD(PK_GATHER(ref + 2, m), z);
+		zw = PK_ADD(PK_GATHER(ref + 3, m), w);
+		mag = PK_ADD(PK_ADD(PK_ADD(PK_MUL(zx, zx), PK_MUL(zy, zy)), PK_MUL(zz, zz)), PK_MUL(zw, zw));
+		escaped = PK_OR(escaped, PK_GT(mag, esc));
+		if (PK_BITS(escaped) == PK_ALL)
+			break;
+
+		// Glitched, or past the end of the reference: rebase onto Z_0
+		dmag = PK_ADD(PK_ADD(PK_ADD(PK_MUL(x, x), PK_MUL(y, y)), PK_MUL(z, z)), PK_MUL(w, w));
+		rebase = PK_OR(PK_IEQ(m, end), PK_GT(dmag, mag));
+		if (PK_BITS(rebase))
+		{
+			x = PK_BLEND(rebase, x, PK_SUB(zx, PK_SET1(ref[0])));
+			y = PK_BLEND(rebase, y, PK_SUB(zy, PK_SET1(ref[1])));
+			z = PK_BLEND(rebase, z, PK_SUB(zz, PK_SET1(ref[2])));
+			w = PK_BLEND(rebase, w, PK_SUB(zw, PK_SET1(ref[3])));
+			m = PK_IBLEND(rebase, m, PK_ISET1(0));
+		}
+	}
+	for (int l = 0; l < PK_WIDTH; l++)
+		out[l] = ((PK_BITS(escaped) >> l) & 1) ? 0.0f : 1.0f;
+}
+
+#undef PK_CAT2
+#undef PK_CAT
+#undef PK_FN
+#undef PK_ALL
@@ -1,6 +1,15 @@
 #pragma once
 
 # include <lib_complex.h>
+# include <stdint.h>
+
+// Most nested shells one escape-time build extracts
+# define MAX_ISO_SHELLS 8
+
+// Size limits of a compiled custom formula
+# define FORMULA_MAX_OPS 64
+# define FORMULA_MAX_REGS 16
+# define FORMULA_MAX_SOURCE 256
 
 typedef struct 				s_matrix
 {
@@ -28,6 +37,13 @@ typedef struct 				s_gl
 
 	GLuint 					vbo;
 	GLuint 					vao;
+	GLuint					ebo;				// Index buffer of indexed meshes
+	GLuint					back_vao;			// Back buffers a background rebuild uploads into
+	GLuint					back_vbo;
+	GLuint					back_ebo;
+
+	uint					*indices;			// Triangle vertex indices, NULL for soups
+	uint					num_indices;
 
 	float					*tris;
 	uint 					num_pts;
@@ -61,8 +77,61 @@ typedef struct 				s_julia
 	float 					threshold;
 	float 					w;
 	cl_quat 				c;
+	size_t					*cycle_skips;	// Adds up the iterations periodicity checking saved (NULL: not counted)
 }							t_julia;
 
+/*
+** A custom quaternion formula, compiled once by compile_formula() into
+** register code for srcs/formula_vm.c. Ops [0, setup_len) depend on no
+** lane and no iteration and run once per batch, the rest once per
+** iteration. Every register holds one quaternion per lane.
+*/
+typedef struct				s_formula_op
+{
+	unsigned char			op;					// FOP_*
+	unsigned char			dst;
+	unsigned char			a;
+	unsigned char			b;					// Second operand, or FOP_POW's exponent
+	float					k;					// FOP_SCALE's factor
+}							t_formula_op;
+
+typedef struct				s_formula_program
+{
+	t_formula_op			code[FORMULA_MAX_OPS];
+	uint					setup_len;
+	uint					len;
+	uint					result;				// Register holding the next z
+	uint					const_mask;			// Registers preloaded from consts
+	cl_quat					consts[FORMULA_MAX_REGS];
+	int						uses_p;				// Reads the position after the start
+	int						loaded;
+	char					source[FORMULA_MAX_SOURCE];
+}							t_formula_program;
+
+/*
+** Everything the samplers read, copied out of t_data by init_sampler()
+** as a build starts. Kernels take it by const pointer and never write to
+** it, so any number of workers can sample at once while the live
+** parameters change under them.
+*/
+typedef struct				s_sampler
+{
+	t_julia					julia;				// This build's Julia parameters, by value
+	double					zoom_level;
+	int						fractal_type;
+	int						formula;			// quaternion_formula
+	int						field_kind;			// FIELD_* actually sampled
+	int						deep_zoom;			// DEEP_ZOOM_* precision of the Julia set
+	int						supersampling;		// Sub-samples per axis
+	float					step_size;			// Lattice spacing the sub-samples spread over
+	int						simd_level;			// Instruction set of the batched path (SIMD_*)
+	int						batch_kind;			// BATCH_* family of the batched path
+	const cl_quat			*reference;			// Perturbation reference orbit Z_0 .. Z_reference_len
+	uint					reference_len;
+	const t_formula_program	*program;			// FORMULA_CUSTOM's code, fixed from start-up
+	float					(*point_kernel)(const struct s_sampler *s, float3 pos); // Specialised sampler
+}							t_sampler;
+
 typedef struct 				s_grid
 {
 	float 					*x;
@@ -90,29 +159,129 @@ typedef struct				s_fract
 	t_voxel 				voxel[8];
 }							t_fract;
 
+typedef struct 				s_tribuf
+{
+	float3					*tris;				// 3 vertices per triangle, x,y,z interleaved
+	uint					count;				// Number of triangles stored
+	uint					capacity;			// Capacity in triangles
+}							t_tribuf;
+
+typedef struct 				s_mesh
+{
+	float3					*verts;				// Shared vertices, one per crossed lattice edge
+	uint					num_verts;
+	uint					vert_capacity;
+	uint					*indices;			// 3 vertex indices per triangle
+	uint					num_indices;
+	uint					index_capacity;
+}							t_mesh;
+
+/*
+** Vertex index of every crossed lattice edge of one cell layer, so the
+** cells that share an edge reuse its vertex. x/y edges live on the two
+** bounding planes ([0] = plane z, [1] = plane z + 1); z edges span the
+** layer. Slots hold MESH_NO_VERTEX until the edge's vertex is created.
+*/
+typedef struct 				s_edge_cache
+{
+	uint					*x_edges[2];		// Edge (x, y) -> (x + 1, y) of each plane
+	uint					*y_edges[2];		// Edge (x, y) -> (x, y + 1) of each plane
+	uint					*z_edges;			// Edge (x, y, z) -> (x, y, z + 1)
+	uint					dim;
+}							t_edge_cache;
+
+/*
+** Everything an orbit depends on besides max_iter: cached orbits are only
+** resumed while it is unchanged.
+*/
+typedef struct 				s_orbit_key
+{
+	cl_quat					c;
+	float					w;
+	int						fractal_type;
+	int						formula;
+	double					zoom_level;
+	float3					p0;
+	float					step_size;
+	uint					dim;
+}							t_orbit_key;
+
+typedef struct 				s_orbit_cache
+{
+	cl_quat					*z;					// Orbit value after the steps in state
+	uint					*state;				// Steps taken, or ORBIT_ESCAPED | escape step
+	size_t					points;
+	t_orbit_key				key;
+	int						valid;				// z/state belong to key
+}							t_orbit_cache;
+
+/*
+** A lattice build's symmetry (lattice_symmetry.c): which points are
+** iterated and which are copied from the canonical point of their orbit.
+*/
+typedef struct 				s_lattice_symmetry
+{
+	struct s_data			*data;
+	uint					dim;
+	uint					words;				// OCCUPANCY_WORDS(dim)
+	uint					maps;				// SYM_* of the sampled set
+	int						k[3];				// Mirror sums K of x, y and z
+	size_t					sampled;
+}							t_lattice_symmetry;
+
+typedef struct s_regen		t_regen;			// Background regeneration (regeneration.c)
+
 typedef struct 				s_data
 {
 	t_gl					*gl;
 	t_fract 				*fract;
 	float3 					*vertexpos;
 	float					*vertexval;
-	float3					**triangles;
 
 	uint2 					len;
 	
-	// Memory optimization: pre-allocated triangle storage
-	float3					*triangle_pool;		// Pre-allocated triangle vertex pool
-	uint					triangle_pool_size;	// Size of pre-allocated pool
-	uint					triangle_pool_used;	// Current usage in pool
+	// Shared-corner lattice: every lattice point sampled exactly once
+	float					*lattice;			// Scalar values, lattice_dim^3 points
+	uint					lattice_dim;		// Lattice points per axis (cells + 1)
+	float					*lattice_coords;	// Lattice point coordinates: x[dim], y[dim], z[dim]
+	uint64_t				*occupancy;			// Bit-packed binary lattice, OCCUPANCY_WORDS(dim) per row
+	int						pack_lattice;		// Store binary lattices as bit-planes
+	int						packed_lattice;		// Lattice lives in occupancy (set per build)
+	int						shared_lattice;		// Use lattice instead of 8 samples per cube
+	int						streaming_build;	// Lattice holds only 2 planes (set per build)
+	int						force_streaming;	// Stream even when the full lattice would fit
+	int						binary_field;		// Lattice values are strictly 0/1 (set per build)
+	int						field_mode;			// Quantity the samplers return (FIELD_*)
+	int						field_kind;			// field_mode this build could honour (set per build)
+	float					inside_level;		// Corners above this value are inside (set per shell)
+	float					surface_level;		// Field value the surface passes through (set per shell)
+	
+	// Nested iso-surfaces of escape-time fields
+	float					iso_levels[MAX_ISO_SHELLS];	// Normalised iteration counts, one shell each
+	uint					num_iso_levels;
+	uint					num_shells;			// Shells the last build emitted (set per build)
+	uint					shell_start[MAX_ISO_SHELLS + 1];	// First triangle of each shell
+	
+	// Orbit state kept between builds
+	t_orbit_cache			orbits;				// Per lattice point z and step count
+	int						orbit_cache;		// Resume orbits when only max_iter changed
+	int						orbit_cache_active;	// Pass 1 goes through data->orbits (set per build)
+	cl_quat					*reference_orbit;	// Perturbation reference orbit of the last build
+	uint					reference_capacity;	// Points reference_orbit has room for
 	
 	// Cache-friendly triangle storage
-	float3					*flat_triangles;	// Flat array of triangle vertices
-	uint					flat_triangle_count;// Number of triangles in flat array
-	uint					flat_triangle_capacity; // Capacity of flat array
+	t_tribuf				flat;				// Flat array of triangle vertices
+	t_mesh					mesh;				// Indexed output of lattice builds
+	int						indexed_mesh;		// Emit data->mesh instead of data->flat
+	int						indexed_build;		// Last build filled data->mesh (set per build)
 	
-	// Marching cubes optimization: pre-allocated vertex list
-	float3					*mc_vertlist;		// Pre-allocated vertex list (12 vertices max)
-	uint					mc_vertlist_size;	// Size of vertex list (always 12)
+	// Parallel build
+	uint					num_threads;		// Worker threads for build_fractal_lattice()
+	int						simd_level;			// Instruction set for batched sampling (SIMD_*)
+	t_sampler				sampler;			// What the build samples with (set per build)
+	size_t					cycle_skips;		// Iterations periodicity checking saved this build
+	volatile int			*cancel;			// Build aborts once *cancel is set (NULL: never)
+	t_regen					*regen;				// Background regeneration, NULL if synchronous
 	
 	// Interactive parameter control
 	float					param_step_size;	// Step size for parameter adjustments
@@ -123,15 +292,18 @@ typedef struct 				s_data
 	double					zoom_level;			// Current zoom level (for precision scaling)
 	int						adaptive_grid;		// Enable adaptive grid refinement
 	int						max_grid_depth;		// Maximum refinement depth
-	float					detail_threshold;	// Threshold for detail detection
 	int						use_double_precision; // Use double precision for deep zoom
+	int						perturbation;		// Deep zoom as float offsets from one reference orbit
 	
 	// Alternative fractal support
 	int						fractal_type;		// 0=Julia, 1=Mandelbrot, 2=Hybrid
 	int						quaternion_formula;	// Different quaternion iteration formulas
+	t_formula_program		custom_formula;		// Loaded with -f or -F, as FORMULA_CUSTOM
 	
 	// Advanced sampling
 	int						supersampling;		// Anti-aliasing level (1=off, 2-4=samples)
-	int						adaptive_sampling;	// Enable complexity-based sampling
+	int						adaptive_sampling;	// Classify under a low cap, full depth near the surface
+	int						use_symmetry;		// Iterate one lattice point per symmetry orbit
+	int						use_culling;		// Skip boxes interval arithmetic proves exterior
 	int						progressive_refinement; // Enable progressive detail enhancement
 }							t_data;
@@ -9,6 +9,21 @@ void 						clean_calcs(t_data *data)
 		data->vertexval = NULL;
 		data->vertexpos = NULL;
 	}
+	if (data->lattice)
+	{
+		free(data->lattice);
+		data->lattice = NULL;
+	}
+	if (data->occupancy)
+	{
+		free(data->occupancy);
+		data->occupancy = NULL;
+	}
+	if (data->lattice_coords)
+	{
+		free(data->lattice_coords);
+		data->lattice_coords = NULL;
+	}
 }
 
 void 						clean_fract(t_fract *fract)
@@ -32,6 +47,8 @@ void						clean_gl(t_gl *gl)
 		free(gl->matrix);
 	if (gl->tris)
 		free(gl->tris);
+	if (gl->indices)
+		free(gl->indices);
 	free(gl);
 }
 
@@ -54,18 +71,18 @@ void 						clean_up(t_data *data)
 			free(data->vertexpos);
 		if (data->vertexval)
 			free(data->vertexval);
-		if (data->triangles)
-			clean_trigs(data->triangles, data->len.x);
+		if (data->lattice)
+			free(data->lattice);
+		if (data->lattice_coords)
+			free(data->lattice_coords);
+		if (data->occupancy)
+			free(data->occupancy);
 		
 		// Clean up memory optimization structures
-		clean_triangle_pool(data);
 		clean_flat_triangles(data);
-		
-		// Clean up marching cubes vertex list
-		if (data->mc_vertlist) {
-			free(data->mc_vertlist);
-			data->mc_vertlist = NULL;
-		}
+		clean_mesh(data);
+		free_orbit_cache(&data->orbits);
+		free(data->reference_orbit);
 		
 		free(data);
 	}
@@ -70,6 +70,7 @@ void						cleanup_enhanced_shaders(t_gl *gl)
  * 
  * Computes per-vertex normals by averaging face normals of adjacent triangles.
  * This enables proper lighting calculations in the enhanced shaders.
+ * Indexed meshes share vertices between faces, so their normals are smooth.
  */
 void						calculate_vertex_normals(t_data *data)
 {
@@ -94,9 +95,16 @@ void						calculate_vertex_normals(t_data *data)
 	// Calculate face normals and accumulate to vertex normals
 	for (uint i = 0; i < gl->num_tris; i++) {
 		// Get the three vertices of the triangle
-		float3 v0 = data->triangles[i][0];
-		float3 v1 = data->triangles[i][1];
-		float3 v2 = data->triangles[i][2];
+		uint idx[3] = {i * 3 + 0, i * 3 + 1, i * 3 + 2};
+		if (data->indexed_build) {
+			idx[0] = data->mesh.indices[i * 3 + 0];
+			idx[1] = data->mesh.indices[i * 3 + 1];
+			idx[2] = data->mesh.indices[i * 3 + 2];
+		}
+		float3 *verts = data->indexed_build ? data->mesh.verts : data->flat.tris;
+		float3 v0 = verts[idx[0]];
+		float3 v1 = verts[idx[1]];
+		float3 v2 = verts[idx[2]];
 		
 		// Calculate edge vectors
 		float3 edge1 = {v1.x - v0.x, v1.y - v0.y, v1.z - v0.z};
@@ -119,22 +127,11 @@ void						calculate_vertex_normals(t_data *data)
 		}
 		
 		// Add this face normal to each vertex of the triangle
-		uint base_index = i * 9; // 3 vertices * 3 components each
-		
-		// Vertex 0
-		gl->vertex_normals[base_index + 0] += face_normal.x;
-		gl->vertex_normals[base_index + 1] += face_normal.y;
-		gl->vertex_normals[base_index + 2] += face_normal.z;
-		
-		// Vertex 1
-		gl->vertex_normals[base_index + 3] += face_normal.x;
-		gl->vertex_normals[base_index + 4] += face_normal.y;
-		gl->vertex_normals[base_index + 5] += face_normal.z;
-		
-		// Vertex 2
-		gl->vertex_normals[base_index + 6] += face_normal.x;
-		gl->vertex_normals[base_index + 7] += face_normal.y;
-		gl->vertex_normals[base_index + 8] += face_normal.z;
+		for (int v = 0; v < 3; v++) {
+			gl->vertex_normals[idx[v] * 3 + 0] += face_normal.x;
+			gl->vertex_normals[idx[v] * 3 + 1] += face_normal.y;
+			gl->vertex_normals[idx[v] * 3 + 2] += face_normal.z;
+		}
 	}
 	
 	// Normalize all accumulated vertex normals
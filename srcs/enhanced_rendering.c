@@ -123,18 +123,40 @@ void						print_parameter_info(t_data *data)
 	printf("  Auto Rotation: %s\n", data->gl->auto_rotate ? "ON" : "OFF");
 	printf("  Zoom Factor: %.2fx\n", data->gl->zoom_factor);
 	printf("  Triangles: %d\n", data->gl->num_tris);
+	printf("  Indexed Mesh: %s\n", data->indexed_mesh ? "ON" : "OFF");
+	if (data->indexed_build)
+		printf("  Shared Vertices: %d\n", data->mesh.num_verts);
 	
 	printf("\x1b[35m[%s]\x1b[0m Mathematical Enhancements:\n", __FILE__);
 	const char *fractal_types[] = {"Julia Set", "Mandelbrot Set", "Hybrid"};
-	const char *formula_names[] = {"Standard z²+c", "Cubic z³+c", "z²+z+c", "|z|²-z²+c"};
 	printf("  Fractal Type: %s\n", fractal_types[data->fractal_type]);
-	printf("  Quaternion Formula: %s\n", formula_names[data->quaternion_formula]);
+	printf("  Quaternion Formula: %s\n", quaternion_formula_name(data->quaternion_formula));
+	if (data->custom_formula.loaded)
+		printf("  Custom Formula: %s\n", data->custom_formula.source);
 	printf("  Deep Zoom Level: %.1fx\n", data->zoom_level);
 	printf("  Double Precision: %s\n", data->use_double_precision ? "ON" : "OFF");
+	printf("  Perturbation: %s\n", data->perturbation ? "ON" : "OFF");
+	const char *precision_names[] = {"float", "double", "double-double", "perturbation"};
+	printf("  Sampling Precision: %s\n", precision_names[deep_zoom_precision(data)]);
 	printf("  Supersampling: %dx\n", data->supersampling);
+	const char *field_names[] = {"Membership", "Distance Estimate", "Escape Time"};
+	printf("  Field: %s\n", field_names[data->field_mode]);
+	if (data->field_mode == FIELD_ESCAPE_TIME)
+	{
+		for (uint s = 0; s < data->num_iso_levels; s++)
+			printf("  Shell %u: level %.2f (%.1f iterations)\n", s, data->iso_levels[s],
+				   data->iso_levels[s] * data->fract->julia->max_iter);
+		if (data->num_shells > 1)
+			for (uint s = 0; s < data->num_shells; s++)
+				printf("  Shell %u Triangles: %u\n", s, data->shell_start[s + 1] - data->shell_start[s]);
+	}
+	printf("  Orbit Cache: %s\n", data->orbit_cache ? "ON" : "OFF");
+	printf("  Two-Level Iteration Budget: %s\n", data->adaptive_sampling ? "ON" : "OFF");
+	printf("  Symmetric Build: %s\n", data->use_symmetry ? "ON" : "OFF");
+	printf("  Interval Culling: %s\n", data->use_culling ? "ON" : "OFF");
 	printf("  Adaptive Grid: %s\n", data->adaptive_grid ? "ON" : "OFF");
 	if (data->adaptive_grid)
-		printf("  Detail Threshold: %.2f\n", data->detail_threshold);
+		printf("  Grid Depth: %d (%u on this grid)\n", data->max_grid_depth, coarse_to_fine_depth(data));
 	
 	printf("\x1b[33m[%s]\x1b[0m Controls:\n", __FILE__);
 	printf("  Arrow Keys: Adjust Julia C.x/C.y\n");
@@ -146,12 +168,20 @@ void						print_parameter_info(t_data *data)
 	printf("  I: Toggle this info display\n");
 	printf("  F: Force regeneration\n");
 	printf("  T: Toggle fractal type\n");
-	printf("  M: Toggle quaternion formula\n");
+	printf("  M: Cycle quaternion formula (fixed, z^2+c to z^8+c, then custom)\n");
 	printf("  P: Toggle double precision\n");
+	printf("  U: Toggle perturbation deep zoom\n");
 	printf("  O: Toggle supersampling\n");
 	printf("  G/H: Deep zoom in/out\n");
 	printf("  J: Toggle adaptive grid\n");
-	printf("  K: Adjust detail threshold\n");
+	printf("  K: Cycle adaptive grid depth\n");
+	printf("  N: Toggle indexed mesh output\n");
+	printf("  D: Cycle sampled field (membership/distance/escape time)\n");
+	printf("  L: Cycle number of escape-time shells\n");
+	printf("  C: Toggle orbit cache\n");
+	printf("  B: Toggle two-level iteration budget\n");
+	printf("  Y: Toggle symmetric build\n");
+	printf("  E: Toggle interval culling\n");
 	printf("  ESC: Exit, S: Save\n");
 	printf("\x1b[32m[%s]\x1b[0m ==========================================\n", __FILE__);
 }
@@ -170,9 +200,8 @@ void						regenerate_fractal(t_data *data)
 	// Clean up existing calculation data
 	clean_calcs(data);
 	
-	// Reset triangle pool for reuse
-	reset_triangle_pool(data);
-	data->flat_triangle_count = 0;
+	// Reset triangle storage for reuse
+	data->flat.count = 0;
 	
 	// Recalculate point cloud with new parameters
 	calculate_point_cloud(data);
@@ -187,6 +216,17 @@ void						regenerate_fractal(t_data *data)
 		glBufferData(GL_ARRAY_BUFFER, data->gl->num_pts * sizeof(float), 
 					 (GLfloat *)data->gl->tris, GL_STATIC_DRAW);
 		
+		// Index buffer of indexed meshes, recorded in the bound VAO
+		if (data->gl->num_indices > 0)
+		{
+			glBindVertexArray(data->gl->vao);
+			if (data->gl->ebo == 0)
+				glGenBuffers(1, &data->gl->ebo);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data->gl->ebo);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, data->gl->num_indices * sizeof(GLuint), 
+						 data->gl->indices, GL_STATIC_DRAW);
+		}
+		
 		// Recalculate vertex normals for enhanced colored rendering
 		calculate_vertex_normals(data);
 		
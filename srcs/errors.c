@@ -54,6 +54,8 @@ void 						error(int errno, t_data *data)
 		printf("%s%s", NO_ARG, USAGE);
 	else if (errno == BAD_FILE_ERR)
 		printf(BAD_FILE);
+	else if (errno == FORMULA_ERR)
+		printf(FORMULA);
 	clean_up(data);
 	exit(1);
 }
@@ -0,0 +1,518 @@
+#include "morphosis.h"
+
+/*
+** Custom formula compiler.
+**
+** A formula is one quaternion expression giving the next z from the
+** current one, loaded with -f "z^3 + c" or from a file with -F. It reads
+**
+**     z            the orbit's current value
+**     p            the sample's position (x, y, z, w), where z starts
+**     c            the Julia constant
+**     i j k        the imaginary units
+**     2.5          real numbers
+**     a + b  a - b  -a
+**     a * b        the quaternion product, a on the left
+**     a ^ n        an integer power from 1 to FORMULA_MAX_EXPONENT
+**     conj(a)      the conjugate
+**     norm(a)      |a|^2, as a real
+**
+** with the usual precedence, ^ binding tightest. Orbits escape past
+** |z|^2 > 16, like the fixed alternative formulas.
+**
+** Parsing is recursive descent straight to register code; there is no
+** tree. Constant subexpressions are folded, products with a real
+** constant become one FOP_SCALE and a * a one FOP_SQR. Anything that
+** only depends on c and constants is hoisted into the setup ops, run
+** once per batch rather than once per iteration, and keeps its register;
+** other temporaries are released as soon as they are read, so registers
+** only run out for deeply nested formulas. The compiled program is run
+** by srcs/formula_vm.c.
+*/
+
+typedef struct				s_fval
+{
+	int						reg;				// -1 for a folded constant
+	int						invariant;			// Same for every lane and iteration
+	cl_quat					q;					// The constant, when reg < 0
+}							t_fval;
+
+typedef struct				s_fparser
+{
+	const char				*src;
+	const char				*pos;
+	const char				*error;
+	const char				*error_at;
+	t_formula_op			setup[FORMULA_MAX_OPS];
+	t_formula_op			body[FORMULA_MAX_OPS];
+	uint					setup_len;
+	uint					body_len;
+	uint					busy;				// Registers in use, one bit each
+	uint					pinned;				// Invariant registers, never released
+	uint					body_regs;			// Registers the loop body ever writes
+	t_formula_program		*prog;
+}							t_fparser;
+
+static t_fval				parse_sum(t_fparser *ps);
+
+static void					fail(t_fparser *ps, const char *message)
+{
+	if (!ps->error)
+	{
+		ps->error = message;
+		ps->error_at = ps->pos;
+	}
+}
+
+static void					skip_space(t_fparser *ps)
+{
+	while (*ps->pos == ' ' || *ps->pos == '\t' || *ps->pos == '\n' || *ps->pos == '\r')
+		ps->pos++;
+}
+
+/* Consume c if it comes next */
+static int					accept(t_fparser *ps, char c)
+{
+	skip_space(ps);
+	if (*ps->pos != c)
+		return 0;
+	ps->pos++;
+	return 1;
+}
+
+static t_fval				constant(float x, float y, float z, float w)
+{
+	return (t_fval){-1, 1, (cl_quat){x, y, z, w}};
+}
+
+static t_fval				reg_value(int reg, int invariant)
+{
+	return (t_fval){reg, invariant, (cl_quat){0.0f, 0.0f, 0.0f, 0.0f}};
+}
+
+static int					is_real(t_fval v, float *k)
+{
+	if (v.reg >= 0 || v.q.y != 0.0f || v.q.z != 0.0f || v.q.w != 0.0f)
+		return 0;
+	*k = v.q.x;
+	return 1;
+}
+
+/*
+** A free register. Invariant values are written before the body first
+** runs and must survive it, so they never take one the body writes.
+*/
+static int					alloc_reg(t_fparser *ps, int invariant)
+{
+	uint					taken;
+
+	taken = ps->busy | (invariant ? ps->body_regs : 0u);
+	for (int r = FREG_FIRST; r < FORMULA_MAX_REGS; r++)
+	{
+		if (!(taken & (1u << r)))
+		{
+			ps->busy |= 1u << r;
+			if (invariant)
+				ps->pinned |= 1u << r;
+			else
+				ps->body_regs |= 1u << r;
+			return r;
+		}
+	}
+	fail(ps, "formula needs too many registers");
+	return FREG_FIRST;
+}
+
+/* A temporary that has been read, unless something else still holds it */
+static void					release(t_fparser *ps, t_fval v)
+{
+	if (v.reg >= FREG_FIRST && !(ps->pinned & (1u << v.reg)))
+		ps->busy &= ~(1u << v.reg);
+}
+
+/* The register holding v, loading constants into one, shared between equal constants */
+static int					operand(t_fparser *ps, t_fval v)
+{
+	t_formula_program		*prog;
+	int						r;
+
+	if (v.reg >= 0)
+		return v.reg;
+	prog = ps->prog;
+	for (r = FREG_FIRST; r < FORMULA_MAX_REGS; r++)
+	{
+		if ((prog->const_mask & (1u << r)) && !memcmp(&prog->consts[r], &v.q, sizeof(cl_quat)))
+			return r;
+	}
+	r = alloc_reg(ps, 1);
+	prog->const_mask |= 1u << r;
+	prog->consts[r] = v.q;
+	return r;
+}
+
+/*
+** Emit op on a and b, into the setup ops if both are invariant, and
+** return the result's register. One-operand ops pass a twice; FOP_POW
+** passes its exponent as arg instead of b, other ops -1.
+*/
+static t_fval				emit(t_fparser *ps, int op, t_fval a, t_fval b, int arg, float k)
+{
+	t_formula_op			*code;
+	uint					*len;
+	int						invariant;
+	int						ra;
+	int						rb;
+	int						dst;
+
+	invariant = a.invariant && b.invariant;
+	ra = operand(ps, a);
+	rb = arg >= 0 ? arg : operand(ps, b);
+	release(ps, a);
+	release(ps, b);
+	dst = alloc_reg(ps, invariant);
+	code = invariant ? ps->setup : ps->body;
+	len = invariant ? &ps->setup_len : &ps->body_len;
+	if (*len == FORMULA_MAX_OPS)
+	{
+		fail(ps, "formula is too long");
+		return reg_value(dst, invariant);
+	}
+	code[(*len)++] = (t_formula_op){(unsigned char)op, (unsigned char)dst,
+		(unsigned char)ra, (unsigned char)rb, k};
+	return reg_value(dst, invariant);
+}
+
+/* Constant folding, in the interpreter's product order */
+static cl_quat				fold_mul(cl_quat a, cl_quat b)
+{
+	return (cl_quat){
+		(a.x * b.x) - (a.y * b.y) - (a.z * b.z) - (a.w * b.w),
+		(a.x * b.y) + (a.y * b.x) + (a.z * b.w) - (a.w * b.z),
+		(a.x * b.z) - (a.y * b.w) + (a.z * b.x) + (a.w * b.y),
+		(a.x * b.w) + (a.y * b.z) - (a.z * b.y) + (a.w * b.x)};
+}
+
+static t_fval				make_add(t_fparser *ps, t_fval a, t_fval b, int subtract)
+{
+	float					k;
+
+	if (a.reg < 0 && b.reg < 0)
+	{
+		if (subtract)
+			return constant(a.q.x - b.q.x, a.q.y - b.q.y, a.q.z - b.q.z, a.q.w - b.q.w);
+		return constant(a.q.x + b.q.x, a.q.y + b.q.y, a.q.z + b.q.z, a.q.w + b.q.w);
+	}
+	if (is_real(b, &k) && k == 0.0f)
+		return a;
+	if (!subtract && is_real(a, &k) && k == 0.0f)
+		return b;
+	return emit(ps, subtract ? FOP_SUB : FOP_ADD, a, b, -1, 0.0f);
+}
+
+static t_fval				make_mul(t_fparser *ps, t_fval a, t_fval b)
+{
+	float					k;
+
+	if (a.reg < 0 && b.reg < 0)
+	{
+		b.q = fold_mul(a.q, b.q);
+		return b;
+	}
+	if (is_real(a, &k) || is_real(b, &k))
+	{
+		if (a.reg < 0)
+			a = b;
+		if (k == 1.0f)
+			return a;
+		return emit(ps, FOP_SCALE, a, a, -1, k);
+	}
+	if (a.reg == b.reg)
+		return emit(ps, FOP_SQR, a, a, -1, 0.0f);
+	return emit(ps, FOP_MUL, a, b, -1, 0.0f);
+}
+
+static t_fval				make_pow(t_fparser *ps, t_fval a, int n)
+{
+	t_fval					r;
+
+	if (n == 1)
+		return a;
+	if (a.reg < 0)
+	{
+		r = a;
+		for (int i = 1; i < n; i++)
+			r.q = fold_mul(r.q, a.q);
+		return r;
+	}
+	return emit(ps, FOP_POW, a, a, n, 0.0f);
+}
+
+static t_fval				make_neg(t_fparser *ps, t_fval a)
+{
+	if (a.reg < 0)
+		return constant(-a.q.x, -a.q.y, -a.q.z, -a.q.w);
+	return emit(ps, FOP_NEG, a, a, -1, 0.0f);
+}
+
+static t_fval				make_call(t_fparser *ps, int op, t_fval a)
+{
+	if (a.reg < 0 && op == FOP_CONJ)
+		return constant(a.q.x, -a.q.y, -a.q.z, -a.q.w);
+	if (a.reg < 0)
+		return constant((((a.q.x * a.q.x) + (a.q.y * a.q.y)) + (a.q.z * a.q.z)) + (a.q.w * a.q.w),
+			0.0f, 0.0f, 0.0f);
+	return emit(ps, op, a, a, -1, 0.0f);
+}
+
+/* An identifier, spelled exactly name and not the start of a longer one */
+static int					keyword(t_fparser *ps, const char *name)
+{
+	size_t					len;
+
+	skip_space(ps);
+	len = strlen(name);
+	if (strncmp(ps->pos, name, len) || isalnum((unsigned char)ps->pos[len]) || ps->pos[len] == '_')
+		return 0;
+	ps->pos += len;
+	return 1;
+}
+
+/* The parenthesised argument of a function, then the function on it */
+static t_fval				parse_call(t_fparser *ps, int op)
+{
+	t_fval					v;
+
+	if (!accept(ps, '('))
+		fail(ps, "expected '(' after the function name");
+	v = parse_sum(ps);
+	if (!accept(ps, ')'))
+		fail(ps, "expected ')'");
+	return make_call(ps, op, v);
+}
+
+static t_fval				parse_atom(t_fparser *ps)
+{
+	static const char		*names[] = {"z", "p", "c"};
+	char					*end;
+	float					x;
+	t_fval					v;
+
+	skip_space(ps);
+	if (isdigit((unsigned char)*ps->pos) || *ps->pos == '.')
+	{
+		x = strtof(ps->pos, &end);
+		if (end == ps->pos)
+			fail(ps, "malformed number");
+		ps->pos = end;
+		return constant(x, 0.0f, 0.0f, 0.0f);
+	}
+	for (int r = 0; r < 3; r++)
+	{
+		if (keyword(ps, names[r]))
+			return reg_value(r, r == FREG_C);
+	}
+	if (keyword(ps, "i"))
+		return constant(0.0f, 1.0f, 0.0f, 0.0f);
+	if (keyword(ps, "j"))
+		return constant(0.0f, 0.0f, 1.0f, 0.0f);
+	if (keyword(ps, "k"))
+		return constant(0.0f, 0.0f, 0.0f, 1.0f);
+	if (keyword(ps, "conj"))
+		return parse_call(ps, FOP_CONJ);
+	if (keyword(ps, "norm"))
+		return parse_call(ps, FOP_NORM);
+	if (accept(ps, '('))
+	{
+		v = parse_sum(ps);
+		if (!accept(ps, ')'))
+			fail(ps, "expected ')'");
+		return v;
+	}
+	fail(ps, *ps->pos ? "expected z, p, c, i, j, k, a number or '('" : "unexpected end of formula");
+	return constant(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+static t_fval				parse_power(t_fparser *ps)
+{
+	t_fval					v;
+	char					*end;
+	long					n;
+
+	v = parse_atom(ps);
+	while (!ps->error && accept(ps, '^'))
+	{
+		skip_space(ps);
+		n = strtol(ps->pos, &end, 10);
+		if (end == ps->pos || n < 1 || n > FORMULA_MAX_EXPONENT || *end == '.')
+		{
+			fail(ps, "exponent must be an integer from 1 to 16");
+			break;
+		}
+		ps->pos = end;
+		v = make_pow(ps, v, (int)n);
+	}
+	return v;
+}
+
+static t_fval				parse_unary(t_fparser *ps)
+{
+	if (accept(ps, '-'))
+		return make_neg(ps, parse_unary(ps));
+	accept(ps, '+');
+	return parse_power(ps);
+}
+
+static t_fval				parse_product(t_fparser *ps)
+{
+	t_fval					v;
+
+	v = parse_unary(ps);
+	while (!ps->error && accept(ps, '*'))
+		v = make_mul(ps, v, parse_unary(ps));
+	return v;
+}
+
+static t_fval				parse_sum(t_fparser *ps)
+{
+	t_fval					v;
+
+	v = parse_product(ps);
+	while (!ps->error)
+	{
+		if (accept(ps, '+'))
+			v = make_add(ps, v, parse_product(ps), 0);
+		else if (accept(ps, '-'))
+			v = make_add(ps, v, parse_product(ps), 1);
+		else
+			break;
+	}
+	return v;
+}
+
+/* Whether any op from code[from] on reads reg */
+static int					reads(const t_formula_program *prog, uint from, uint reg)
+{
+	for (uint i = from; i < prog->len; i++)
+	{
+		if (prog->code[i].a == reg || (prog->code[i].b == reg && prog->code[i].op != FOP_POW))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Compile source into prog
+ *
+ * On error prints the message with a caret under the offending spot and
+ * returns 0, leaving prog unusable.
+ *
+ * @return 1 once prog is ready for run_formula()
+ */
+int							compile_formula(const char *source, t_formula_program *prog)
+{
+	t_fparser				ps;
+	t_fval					v;
+	t_formula_op			*last;
+
+	memset(prog, 0, sizeof(t_formula_program));
+	memset(&ps, 0, sizeof(ps));
+	ps.src = source;
+	ps.pos = source;
+	ps.prog = prog;
+	ps.busy = (1u << FREG_FIRST) - 1u;
+	if (strlen(source) >= FORMULA_MAX_SOURCE)
+		fail(&ps, "formula is too long");
+	v = parse_sum(&ps);
+	skip_space(&ps);
+	if (*ps.pos && !ps.error)
+		fail(&ps, "unexpected character");
+	if (!ps.error)
+		v.reg = operand(&ps, v);
+	if (ps.error)
+	{
+		printf("\x1b[31m[%s]\x1b[0m %s\n  %s\n  %*s^\n", __FILE__, ps.error, source,
+			(int)(ps.error_at - source), "");
+		return 0;
+	}
+
+	// Setup ops, then the loop body
+	memcpy(prog->code, ps.setup, ps.setup_len * sizeof(t_formula_op));
+	memcpy(prog->code + ps.setup_len, ps.body, ps.body_len * sizeof(t_formula_op));
+	prog->setup_len = ps.setup_len;
+	prog->len = ps.setup_len + ps.body_len;
+	prog->result = v.reg;
+
+	// The last op can write z itself, saving the copy after each iteration
+	if (ps.body_len)
+	{
+		last = &prog->code[prog->len - 1];
+		if (last->dst == v.reg)
+		{
+			last->dst = FREG_Z;
+			prog->result = FREG_Z;
+		}
+	}
+	prog->uses_p = prog->result == FREG_P || reads(prog, prog->setup_len, FREG_P);
+	snprintf(prog->source, FORMULA_MAX_SOURCE, "%s", source);
+	prog->loaded = 1;
+	return 1;
+}
+
+/**
+ * @brief Compile source as data's custom formula and select it
+ *
+ * Exits through error() if it does not compile.
+ */
+void						load_formula(t_data *data, const char *source)
+{
+	if (!compile_formula(source, &data->custom_formula))
+		error(FORMULA_ERR, data);
+	data->quaternion_formula = FORMULA_CUSTOM;
+	printf("\x1b[36m[%s]\x1b[0m Custom formula: %s (%u ops, %u per iteration)\n", __FILE__,
+		data->custom_formula.source, data->custom_formula.len,
+		data->custom_formula.len - data->custom_formula.setup_len);
+}
+
+/**
+ * @brief load_formula() from the file at path
+ *
+ * Lines join with spaces and '#' starts a comment to the end of its line.
+ */
+void						load_formula_file(t_data *data, const char *path)
+{
+	char					source[FORMULA_MAX_SOURCE];
+	FILE					*file;
+	size_t					len;
+	int						comment;
+	int						c;
+
+	if (!(file = fopen(path, "r")))
+		error(OPEN_FILE_ERR, data);
+	len = 0;
+	comment = 0;
+	while ((c = fgetc(file)) != EOF)
+	{
+		if (c == '\n' || c == '\r')
+			comment = 0;
+		if (c == '#')
+			comment = 1;
+		if (comment)
+			continue;
+		if (c == '\n' || c == '\r' || c == '\t')
+			c = ' ';
+		if (c == ' ' && (!len || source[len - 1] == ' '))
+			continue;
+		if (len == FORMULA_MAX_SOURCE - 1)
+		{
+			fclose(file);
+			printf("\x1b[31m[%s]\x1b[0m formula is too long\n", __FILE__);
+			error(FORMULA_ERR, data);
+		}
+		source[len++] = (char)c;
+	}
+	fclose(file);
+	while (len && source[len - 1] == ' ')
+		len--;
+	source[len] = '\0';
+	load_formula(data, source);
+}
@@ -0,0 +1,117 @@
+#include "morphosis.h"
+
+/*
+** Custom formula interpreter.
+**
+** Runs a t_formula_program from srcs/formula_compiler.c. Decoding an op
+** costs the same whether it then works on one point or many, so each op
+** runs across a whole batch of FORMULA_LANES points before the next is
+** decoded, and the dispatch that makes a scalar interpreter several
+** times slower than compiled code is paid once per batch. The lane loops
+** are written with GCC vector extensions in includes/formula_kernels.h
+** and compiled for 4-lane baseline vectors (SSE2 on x86), and again for
+** 8-lane AVX2 and 16-lane AVX-512.
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+# define FK_X86 1
+#else
+# define FK_X86 0
+#endif
+
+/* Keep every level rounding exactly like the scalar formulas */
+#if defined(__GNUC__) && !defined(__clang__)
+# define FK_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+# define FK_NO_CONTRACT
+#endif
+
+/* Vector types may alias the floats of the registers they are loaded from */
+typedef float				t_fk_vec4 __attribute__((vector_size(16), may_alias));
+typedef int					t_fk_mask4 __attribute__((vector_size(16), may_alias));
+typedef float				t_fk_vec8 __attribute__((vector_size(32), may_alias));
+typedef int					t_fk_mask8 __attribute__((vector_size(32), may_alias));
+typedef float				t_fk_vec16 __attribute__((vector_size(64), may_alias));
+typedef int					t_fk_mask16 __attribute__((vector_size(64), may_alias));
+
+typedef void				(*t_formula_kernel)(const t_formula_program *prog, const t_julia *julia,
+								const float *x, const float *y, const float *z, float *out, uint n);
+
+/* Baseline: 4 lanes */
+#define FK_SUFFIX			_generic
+#define FK_TARGET			FK_NO_CONTRACT
+#define FK_WIDTH			4
+#define fk_vec				t_fk_vec4
+#define fk_mask				t_fk_mask4
+#include "formula_kernels.h"
+#undef FK_SUFFIX
+#undef FK_TARGET
+#undef FK_WIDTH
+#undef fk_vec
+#undef fk_mask
+
+#if FK_X86
+
+/* AVX2: 8 lanes */
+# define FK_SUFFIX			_avx2
+# define FK_TARGET			__attribute__((target("avx2"))) FK_NO_CONTRACT
+# define FK_WIDTH			8
+# define fk_vec				t_fk_vec8
+# define fk_mask			t_fk_mask8
+# include "formula_kernels.h"
+# undef FK_SUFFIX
+# undef FK_TARGET
+# undef FK_WIDTH
+# undef fk_vec
+# undef fk_mask
+
+/* AVX-512: 16 lanes */
+# define FK_SUFFIX			_avx512
+# define FK_TARGET			__attribute__((target("avx512f"))) FK_NO_CONTRACT
+# define FK_WIDTH			16
+# define fk_vec				t_fk_vec16
+# define fk_mask			t_fk_mask16
+# include "formula_kernels.h"
+# undef FK_SUFFIX
+# undef FK_TARGET
+# undef FK_WIDTH
+# undef fk_vec
+# undef fk_mask
+
+#endif
+
+/**
+ * @brief Interpreter build for level
+ */
+static t_formula_kernel		formula_kernel(int level)
+{
+#if FK_X86
+	if (level >= SIMD_AVX512)
+		return formula_batch_avx512;
+	if (level == SIMD_AVX2)
+		return formula_batch_avx2;
+#endif
+	(void)level;
+	return formula_batch_generic;
+}
+
+/**
+ * @brief Classify n points, given zoomed as SoA coordinates, by prog
+ *
+ * Orbits start at (x, y, z, julia->w) and run z = prog(z) for up to
+ * julia->max_iter steps, escaping past |z|^2 > 16. Every level gives
+ * the same result for each point, alone or in a batch.
+ */
+void						run_formula(int level, const t_formula_program *prog, const t_julia *julia,
+								const float *x, const float *y, const float *z, float *out, uint n)
+{
+	t_formula_kernel		k;
+	uint					count;
+
+	k = formula_kernel(level);
+	for (uint i = 0; i < n; i += FORMULA_LANES)
+	{
+		count = (n - i < FORMULA_LANES) ? n - i : FORMULA_LANES;
+		k(prog, julia, x + i, y + i, z + i, out + i, count);
+	}
+}
@@ -13,6 +13,59 @@ void						createVAO(t_gl *gl)
 	glBindVertexArray(gl->vao);
 }
 
+/**
+ * @brief Create the index buffer of an indexed mesh
+ * 
+ * Must be called with gl->vao bound: the VAO records the element buffer
+ * binding, so later glDrawElements calls pick it up automatically.
+ */
+void						createEBO(t_gl *gl, GLsizeiptr size, GLuint *indices)
+{
+	glGenBuffers(1, &gl->ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_DYNAMIC_DRAW);
+}
+
+/**
+ * @brief Upload gl->tris (and gl->indices) into the back buffers, then flip
+ * 
+ * The frame being drawn keeps its own VAO/VBO, so a finished background
+ * rebuild never has to wait on, or overwrite, a buffer still in use. The
+ * back set is created on first use with the same "pos" layout.
+ */
+void						swap_in_back_buffers(t_gl *gl)
+{
+	GLuint					tmp;
+
+	if (gl->back_vao == 0)
+		glGenVertexArrays(1, &gl->back_vao);
+	if (gl->back_vbo == 0)
+		glGenBuffers(1, &gl->back_vbo);
+	glBindVertexArray(gl->back_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, gl->back_vbo);
+	glBufferData(GL_ARRAY_BUFFER, gl->num_pts * sizeof(float), (GLfloat *)gl->tris, GL_STATIC_DRAW);
+	gl_set_attrib_ptr(gl, "pos", 3, 3, 0);
+	if (gl->num_indices > 0)
+	{
+		if (gl->back_ebo == 0)
+			glGenBuffers(1, &gl->back_ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->back_ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, gl->num_indices * sizeof(GLuint), gl->indices, GL_STATIC_DRAW);
+	}
+	
+	// Flip: the freshly filled set becomes the front one
+	tmp = gl->vao;
+	gl->vao = gl->back_vao;
+	gl->back_vao = tmp;
+	tmp = gl->vbo;
+	gl->vbo = gl->back_vbo;
+	gl->back_vbo = tmp;
+	tmp = gl->ebo;
+	gl->ebo = gl->back_ebo;
+	gl->back_ebo = tmp;
+	glBindVertexArray(gl->vao);
+}
+
 /**
  * @brief Optimized VBO creation with better buffer usage hints
  * 
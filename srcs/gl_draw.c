@@ -1,5 +1,18 @@
 #include "morphosis.h"
 
+/**
+ * @brief Draw the current mesh, indexed or as a plain triangle soup
+ * 
+ * num_pts counts floats, so a soup holds num_pts / 3 vertices.
+ */
+static void					gl_draw_mesh(t_gl *gl)
+{
+	if (gl->num_indices > 0)
+		glDrawElements(GL_TRIANGLES, gl->num_indices, GL_UNSIGNED_INT, (void *)0);
+	else if (gl->num_pts > 0)
+		glDrawArrays(GL_TRIANGLES, 0, gl->num_pts / 3);
+}
+
 void 						run_graphics(t_gl *gl, float3 max, float3 min)
 {
 	gl_scale_tris(gl, max, min);
@@ -7,6 +20,8 @@ void 						run_graphics(t_gl *gl, float3 max, float3 min)
 	init_gl(gl);
 	createVAO(gl);
 	createVBO(gl, gl->num_pts * sizeof(float), (GLfloat *)gl->tris);
+	if (gl->num_indices > 0)
+		createEBO(gl, gl->num_indices * sizeof(GLuint), gl->indices);
 
 	makeShaderProgram(gl);
 	gl_set_attrib_ptr(gl, "pos", 3,3, 0);
@@ -44,7 +59,7 @@ void							gl_render(t_gl *gl)
 		glm_rotate(gl->matrix->view_mat, (0.25f * delta * glm_rad(180.0f)), gl->matrix->up);
 		glUniformMatrix4fv(gl->matrix->view, 1, GL_FALSE, (float *)gl->matrix->view_mat);
 
-		glDrawArrays(GL_TRIANGLES, 0, gl->num_pts);
+		gl_draw_mesh(gl);
 
 		glfwSwapBuffers(gl->window);
 		glfwPollEvents();
@@ -67,6 +82,8 @@ void 						run_graphics_enhanced(t_data *data, float3 max, float3 min)
 	init_gl(gl);
 	createVAO(gl);
 	createVBO(gl, gl->num_pts * sizeof(float), (GLfloat *)gl->tris);
+	if (gl->num_indices > 0)
+		createEBO(gl, gl->num_indices * sizeof(GLuint), gl->indices);
 
 	makeShaderProgram(gl);
 	gl_set_attrib_ptr(gl, "pos", 3,3, 0);
@@ -89,7 +106,10 @@ void 						run_graphics_enhanced(t_data *data, float3 max, float3 min)
 	if (data->show_info)
 		print_parameter_info(data);
 	
+	// Parameter changes rebuild on a background thread from here on
+	start_regeneration(data);
 	gl_render_enhanced(data);
+	stop_regeneration(data);
 
 	terminate_gl(gl);
 }
@@ -121,9 +141,14 @@ void						gl_render_enhanced(t_data *data)
 		// Handle fractal regeneration if parameters changed
 		if (gl->needs_regeneration)
 		{
-			regenerate_fractal(data);
-			// Note: VBO is updated inside regenerate_fractal()
+			if (data->regen)
+				request_regeneration(data);
+			else
+				regenerate_fractal(data);
+			// Note: VBO is updated inside regenerate_fractal() / poll_regeneration()
+			gl->needs_regeneration = 0;
 		}
+		poll_regeneration(data);
 
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -161,8 +186,7 @@ void						gl_render_enhanced(t_data *data)
 		glUniform1i(render_mode_loc, gl->render_mode);
 
 		// Render triangles
-		if (gl->num_pts > 0)
-			glDrawArrays(GL_TRIANGLES, 0, gl->num_pts);
+		gl_draw_mesh(gl);
 
 		glfwSwapBuffers(gl->window);
 		glfwPollEvents();
@@ -39,8 +39,14 @@ t_gl						*init_gl_struct(void)
 	gl->fragmentShader = 0;
 	gl->vbo = 0;
 	gl->vao = 0;
+	gl->ebo = 0;
+	gl->back_vao = 0;
+	gl->back_vbo = 0;
+	gl->back_ebo = 0;
 	gl->tris = NULL;
 	gl->num_pts = 0;
+	gl->indices = NULL;
+	gl->num_indices = 0;
 	gl->matrix = initGlMatrices();
 	
 	// Initialize enhanced rendering features
@@ -2,25 +2,31 @@
 
 void						gl_retrieve_tris(t_data *data)
 {
-	uint					i;
-	uint 					j;
+	t_gl					*gl;
 
-	i = 0;
-	j = 0;
-	if (!(data->gl->tris = (float *)malloc(data->gl->num_pts * sizeof(float))))
+	gl = data->gl;
+	if (gl->tris)
+		free(gl->tris);
+	if (gl->indices)
+		free(gl->indices);
+	gl->indices = NULL;
+	gl->num_indices = 0;
+	if (!(gl->tris = (float *)malloc(gl->num_pts * sizeof(float))))
 		error(MALLOC_FAIL_ERR, data);
 
-	bzero(data->gl->tris, data->gl->num_pts);
-	while (j < data->gl->num_pts)
+	if (data->indexed_build)
 	{
-		for (int c = 0; c < 3; c++)
-		{
-			data->gl->tris[j++] = data->triangles[i][c].x;
-			data->gl->tris[j++] = data->triangles[i][c].y;
-			data->gl->tris[j++] = data->triangles[i][c].z;
-		}
-		i++;
+		// Shared vertices plus the index buffer that stitches them together
+		gl->num_indices = data->mesh.num_indices;
+		if (!(gl->indices = (uint *)malloc(gl->num_indices * sizeof(uint))))
+			error(MALLOC_FAIL_ERR, data);
+		memcpy(gl->tris, data->mesh.verts, gl->num_pts * sizeof(float));
+		memcpy(gl->indices, data->mesh.indices, gl->num_indices * sizeof(uint));
+		return;
 	}
+
+	// flat_triangles is already x,y,z interleaved: one contiguous copy
+	memcpy(gl->tris, data->flat.tris, gl->num_pts * sizeof(float));
 }
 
 void						gl_set_attrib_ptr(t_gl *gl, char *attrib_name, GLint num_vals, int stride, int offset)
@@ -20,6 +20,19 @@ void 						processInput(GLFWwindow *window, t_gl *gl)
 	}
 }
 
+/**
+ * @brief Pull the zoom back to what the current fractal can be sampled at
+ */
+static void					clamp_zoom(t_data *data)
+{
+	if (data->zoom_level <= max_zoom_level(data))
+		return;
+	data->zoom_level = max_zoom_level(data);
+	if (data->zoom_level < DEEP_ZOOM_MAX)
+		printf("\x1b[33m[%s]\x1b[0m Zoom limited to %.1fx: deep zoom only iterates z^2 + c Julia sets\n",
+			__FILE__, data->zoom_level);
+}
+
 /**
  * @brief Enhanced input processing with dynamic parameter control
  * 
@@ -179,6 +192,8 @@ void 						processInput_enhanced(GLFWwindow *window, t_gl *gl, t_data *data)
 	// Mathematical enhancement controls
 	static int t_pressed = 0, m_pressed = 0, p_pressed = 0, o_pressed = 0;
 	static int g_pressed = 0, h_pressed = 0, j_pressed = 0, k_pressed = 0;
+	static int n_pressed = 0, d_pressed = 0, l_pressed = 0, c_pressed = 0;
+	static int b_pressed = 0, y_pressed = 0, u_pressed = 0, e_pressed = 0;
 	
 	// Toggle fractal type (T key)
 	if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && !t_pressed)
@@ -186,18 +201,19 @@ void 						processInput_enhanced(GLFWwindow *window, t_gl *gl, t_data *data)
 		data->fractal_type = (data->fractal_type + 1) % 3;
 		const char *type_names[] = {"Julia Set", "Mandelbrot Set", "Hybrid"};
 		printf("\x1b[35m[%s]\x1b[0m Fractal Type: %s\n", __FILE__, type_names[data->fractal_type]);
+		clamp_zoom(data);
 		gl->needs_regeneration = 1;
 		t_pressed = 1;
 		last_key_time = current_time;
 	}
 	if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE) t_pressed = 0;
 	
-	// Toggle quaternion formula (M key)
+	// Toggle quaternion formula (M key), through the custom one once loaded
 	if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !m_pressed)
 	{
-		data->quaternion_formula = (data->quaternion_formula + 1) % 4;
-		const char *formula_names[] = {"Standard z²+c", "Cubic z³+c", "z²+z+c", "|z|²-z²+c"};
-		printf("\x1b[35m[%s]\x1b[0m Quaternion Formula: %s\n", __FILE__, formula_names[data->quaternion_formula]);
+		data->quaternion_formula = (data->quaternion_formula + 1) % (FORMULA_COUNT + data->custom_formula.loaded);
+		printf("\x1b[35m[%s]\x1b[0m Quaternion Formula: %s\n", __FILE__, quaternion_formula_name(data->quaternion_formula));
+		clamp_zoom(data);
 		gl->needs_regeneration = 1;
 		m_pressed = 1;
 		last_key_time = current_time;
@@ -216,6 +232,18 @@ void 						processInput_enhanced(GLFWwindow *window, t_gl *gl, t_data *data)
 	}
 	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE) p_pressed = 0;
 	
+	// Toggle perturbation deep zoom (U key)
+	if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS && !u_pressed)
+	{
+		data->perturbation = !data->perturbation;
+		printf("\x1b[35m[%s]\x1b[0m Perturbation: %s\n", __FILE__, data->perturbation ? "ON" : "OFF");
+		if (data->zoom_level > DEEP_ZOOM_DOUBLE_MIN)
+			gl->needs_regeneration = 1;
+		u_pressed = 1;
+		last_key_time = current_time;
+	}
+	if (glfwGetKey(window, GLFW_KEY_U) == GLFW_RELEASE) u_pressed = 0;
+	
 	// Toggle supersampling (O key)
 	if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !o_pressed)
 	{
@@ -234,9 +262,14 @@ void 						processInput_enhanced(GLFWwindow *window, t_gl *gl, t_data *data)
 	if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !g_pressed)
 	{
 		data->zoom_level *= 2.0;
-		if (data->zoom_level > 1000000.0) data->zoom_level = 1000000.0;
+		clamp_zoom(data);
 		printf("\x1b[35m[%s]\x1b[0m Zoom Level: %.1fx\n", __FILE__, data->zoom_level);
-		if (data->zoom_level > 1000.0)
+		if (deep_zoom_precision(data) == DEEP_ZOOM_PERTURBATION)
+			printf("\x1b[33m[%s]\x1b[0m Perturbation deep zoom active\n", __FILE__);
+		else if (deep_zoom_precision(data) == DEEP_ZOOM_DOUBLE_DOUBLE)
+			printf("\x1b[33m[%s]\x1b[0m Double-double precision active\n", __FILE__);
+		else if (data->zoom_level > DEEP_ZOOM_DOUBLE_MIN && !data->use_double_precision
+			&& max_zoom_level(data) == DEEP_ZOOM_MAX)
 			printf("\x1b[33m[%s]\x1b[0m Deep zoom active - consider enabling double precision (P)\n", __FILE__);
 		gl->needs_regeneration = 1;
 		g_pressed = 1;
@@ -262,7 +295,7 @@ void 						processInput_enhanced(GLFWwindow *window, t_gl *gl, t_data *data)
 		printf("\x1b[35m[%s]\x1b[0m Adaptive Grid: %s\n", __FILE__, 
 			   data->adaptive_grid ? "ON" : "OFF");
 		if (data->adaptive_grid)
-			printf("\x1b[33m[%s]\x1b[0m Note: Adaptive grid is experimental and may slow generation\n", __FILE__);
+			printf("\x1b[33m[%s]\x1b[0m Note: Uniform bricks are filled without sampling; details smaller than a brick may be lost\n", __FILE__);
 		gl->needs_regeneration = 1;
 		j_pressed = 1;
 		last_key_time = current_time;
@@ -271,15 +304,102 @@ void 						processInput_enhanced(GLFWwindow *window, t_gl *gl, t_data *data)
 	
 	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && !k_pressed)
 	{
-		data->detail_threshold += 0.05f;
-		if (data->detail_threshold > 0.5f) data->detail_threshold = 0.05f;
-		printf("\x1b[35m[%s]\x1b[0m Detail Threshold: %.2f\n", __FILE__, data->detail_threshold);
+		data->max_grid_depth = (data->max_grid_depth + 1) % (LATTICE_MS_MAX_DEPTH + 1);
+		printf("\x1b[35m[%s]\x1b[0m Grid Depth: %d (%u on this grid)\n", __FILE__,
+			   data->max_grid_depth, coarse_to_fine_depth(data));
 		if (data->adaptive_grid)
 			gl->needs_regeneration = 1;
 		k_pressed = 1;
 		last_key_time = current_time;
 	}
 	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_RELEASE) k_pressed = 0;
+	
+	// Indexed mesh output (N key)
+	if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS && !n_pressed)
+	{
+		data->indexed_mesh = !data->indexed_mesh;
+		printf("\x1b[35m[%s]\x1b[0m Indexed Mesh: %s\n", __FILE__, 
+			   data->indexed_mesh ? "ON" : "OFF");
+		gl->needs_regeneration = 1;
+		n_pressed = 1;
+		last_key_time = current_time;
+	}
+	if (glfwGetKey(window, GLFW_KEY_N) == GLFW_RELEASE) n_pressed = 0;
+	
+	// Sampled field: membership / distance estimate / escape time (D key)
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS && !d_pressed)
+	{
+		const char *field_names[] = {"Membership", "Distance Estimate", "Escape Time"};
+		data->field_mode = (data->field_mode + 1) % FIELD_MODES;
+		printf("\x1b[35m[%s]\x1b[0m Field: %s\n", __FILE__, field_names[data->field_mode]);
+		if (data->field_mode == FIELD_DISTANCE)
+			printf("\x1b[33m[%s]\x1b[0m Note: Vertices now sit on the surface, so a coarser step size looks as smooth\n", __FILE__);
+		gl->needs_regeneration = 1;
+		d_pressed = 1;
+		last_key_time = current_time;
+	}
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_RELEASE) d_pressed = 0;
+	
+	// Nested escape-time shells, evenly spaced in iterations (L key)
+	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !l_pressed)
+	{
+		uint shells = data->num_iso_levels % 4 + 1;
+		for (uint s = 0; s < shells; s++)
+			data->iso_levels[s] = (float)(shells - s) / (float)shells;
+		data->num_iso_levels = shells;
+		printf("\x1b[35m[%s]\x1b[0m Iso Shells: %u\n", __FILE__, shells);
+		if (data->field_mode == FIELD_ESCAPE_TIME)
+			gl->needs_regeneration = 1;
+		l_pressed = 1;
+		last_key_time = current_time;
+	}
+	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE) l_pressed = 0;
+	
+	// Orbit cache: +/- then only advance or reclassify stored orbits (C key)
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !c_pressed)
+	{
+		data->orbit_cache = !data->orbit_cache;
+		printf("\x1b[35m[%s]\x1b[0m Orbit Cache: %s\n", __FILE__, data->orbit_cache ? "ON" : "OFF");
+		if (data->orbit_cache)
+			printf("\x1b[33m[%s]\x1b[0m Note: Costs 20 bytes per lattice point; the next build fills it\n", __FILE__);
+		c_pressed = 1;
+		last_key_time = current_time;
+	}
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE) c_pressed = 0;
+	
+	// Two-level iteration budget (B key)
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !b_pressed)
+	{
+		data->adaptive_sampling = !data->adaptive_sampling;
+		printf("\x1b[35m[%s]\x1b[0m Two-Level Iteration Budget: %s\n", __FILE__,
+			   data->adaptive_sampling ? "ON" : "OFF");
+		if (data->adaptive_sampling)
+			printf("\x1b[33m[%s]\x1b[0m Note: Exterior pockets sealed off from the surface at the low cap may be filled in\n", __FILE__);
+		gl->needs_regeneration = 1;
+		b_pressed = 1;
+		last_key_time = current_time;
+	}
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE) b_pressed = 0;
+	
+	// Symmetric lattice sampling (Y key)
+	if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS && !y_pressed)
+	{
+		data->use_symmetry = !data->use_symmetry;
+		printf("\x1b[35m[%s]\x1b[0m Symmetric Build: %s\n", __FILE__, data->use_symmetry ? "ON" : "OFF");
+		y_pressed = 1;
+		last_key_time = current_time;
+	}
+	if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_RELEASE) y_pressed = 0;
+	
+	// Interval culling of exterior boxes (E key)
+	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS && !e_pressed)
+	{
+		data->use_culling = !data->use_culling;
+		printf("\x1b[35m[%s]\x1b[0m Interval Culling: %s\n", __FILE__, data->use_culling ? "ON" : "OFF");
+		e_pressed = 1;
+		last_key_time = current_time;
+	}
+	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_RELEASE) e_pressed = 0;
 }
 
 void 						init_gl(t_gl *gl)
@@ -315,6 +435,14 @@ void 						terminate_gl(t_gl *gl)
 	// Clean up basic OpenGL resources
 	glDeleteVertexArrays(1, &gl->vao);
 	glDeleteBuffers(1, &gl->vbo);
+	if (gl->ebo != 0)
+		glDeleteBuffers(1, &gl->ebo);
+	if (gl->back_vao != 0)
+		glDeleteVertexArrays(1, &gl->back_vao);
+	if (gl->back_vbo != 0)
+		glDeleteBuffers(1, &gl->back_vbo);
+	if (gl->back_ebo != 0)
+		glDeleteBuffers(1, &gl->back_ebo);
 	glDeleteProgram(gl->shaderProgram);
 	glfwTerminate();
 }
@@ -38,6 +38,7 @@ t_julia 					*init_julia(void)
 	julia->max_iter = 6;
 	julia->threshold = 2.0f;
 	julia->w = 0.0f;
+	julia->cycle_skips = NULL;
 
 	julia->c.x = -0.2f;
 	julia->c.y = 0.8f;
@@ -57,21 +58,52 @@ t_data						*init_data(void)
 	data->fract = init_fract();
 	data->vertexpos = NULL;
 	data->vertexval = NULL;
-	data->triangles = NULL;
 	
-	// Initialize memory optimization fields
-	data->triangle_pool = NULL;
-	data->triangle_pool_size = 0;
-	data->triangle_pool_used = 0;
+	// Initialize shared-corner lattice (default build path)
+	data->lattice = NULL;
+	data->lattice_dim = 0;
+	data->lattice_coords = NULL;
+	data->occupancy = NULL;
+	data->pack_lattice = 1;
+	data->packed_lattice = 0;
+	data->shared_lattice = 1;
+	data->streaming_build = 0;
+	data->force_streaming = 0;
+	data->binary_field = 1;
+	data->field_mode = FIELD_MEMBERSHIP;
+	data->field_kind = FIELD_MEMBERSHIP;
+	data->inside_level = 0.0f;
+	data->surface_level = 1.0f;
+	data->iso_levels[0] = 1.0f;		// The membership surface
+	data->num_iso_levels = 1;
+	data->num_shells = 1;
+	memset(data->shell_start, 0, sizeof(data->shell_start));
+	memset(&data->orbits, 0, sizeof(t_orbit_cache));
+	data->orbit_cache = 0;
+	data->orbit_cache_active = 0;
+	data->reference_orbit = NULL;
+	data->reference_capacity = 0;
 	
 	// Initialize cache-friendly triangle storage
-	data->flat_triangles = NULL;
-	data->flat_triangle_count = 0;
-	data->flat_triangle_capacity = 0;
+	data->flat.tris = NULL;
+	data->flat.count = 0;
+	data->flat.capacity = 0;
+	data->mesh.verts = NULL;
+	data->mesh.num_verts = 0;
+	data->mesh.vert_capacity = 0;
+	data->mesh.indices = NULL;
+	data->mesh.num_indices = 0;
+	data->mesh.index_capacity = 0;
+	data->indexed_mesh = 0;
+	data->indexed_build = 0;
 	
-	// Initialize marching cubes optimization
-	data->mc_vertlist = NULL;
-	data->mc_vertlist_size = 12; // Always 12 vertices for cube edges
+	// Initialize parallel build
+	data->num_threads = default_thread_count();
+	data->simd_level = detect_simd_level();
+	data->cancel = NULL;
+	data->regen = NULL;
+	printf("\x1b[36m[%s]\x1b[0m Sampling with %s kernels on %u threads\n", 
+		   __FILE__, simd_level_name(data->simd_level), data->num_threads);
 	
 	// Initialize interactive parameter control
 	data->param_step_size = 0.01f;	// Default parameter adjustment step
@@ -82,18 +114,25 @@ t_data						*init_data(void)
 	data->zoom_level = 1.0;			// Start at 1x zoom
 	data->adaptive_grid = 0;		// Disabled by default
 	data->max_grid_depth = 3;		// Maximum 3 levels of refinement
-	data->detail_threshold = 0.1f;	// Threshold for detail detection
 	data->use_double_precision = 0;	// Use float by default
+	data->perturbation = 0;			// Opt-in, like double precision
 	
 	// Initialize alternative fractal support
 	data->fractal_type = 0;			// Julia set by default
 	data->quaternion_formula = 0;	// Standard formula
+	data->custom_formula.loaded = 0;	// Until -f or -F loads one
 	
 	// Initialize advanced sampling
 	data->supersampling = 1;		// No anti-aliasing by default
 	data->adaptive_sampling = 0;	// Disabled by default
+	data->use_symmetry = 1;			// Enabled by default
+	data->use_culling = 1;			// Enabled by default
 	data->progressive_refinement = 0; // Disabled by default
 	
+	// Sampler for these defaults; every build snapshots its own
+	data->cycle_skips = 0;
+	init_sampler(data);
+	
 	return data;
 }
 
@@ -108,11 +147,73 @@ void						init_vertex(t_data *data)
 		error(MALLOC_FAIL_ERR, data);
 }
 
+/**
+ * @brief Allocate the shared-corner scalar lattice
+ * 
+ * One value per lattice point, (cells + 1)^3 in total, instead of the
+ * 8 values per cube that init_vertex() reserves. Positions are derived
+ * from lattice indices and never stored. A streaming build only keeps
+ * two planes resident, 2 * (cells + 1)^2 values.
+ */
+void						init_lattice(t_data *data)
+{
+	size_t 					size;
+
+	// Buffers of an earlier build that was not cleaned up
+	if (data->lattice)
+		free(data->lattice);
+	if (data->occupancy)
+		free(data->occupancy);
+	if (data->lattice_coords)
+		free(data->lattice_coords);
+	data->lattice = NULL;
+	data->occupancy = NULL;
+	data->lattice_coords = NULL;
+	data->lattice_dim = lattice_cells(data->fract) + 1;
+	size = (size_t)data->lattice_dim;
+	size *= data->streaming_build ? 2 : data->lattice_dim;
+	if (data->packed_lattice)
+	{
+		// One bit per point, rows padded to whole words (padding stays 0)
+		size *= OCCUPANCY_WORDS(data->lattice_dim);
+		printf("\x1b[36m[%s]\x1b[0m Allocating bit-packed lattice: %u^%s points (%.2f MB)\n", 
+			   __FILE__, data->lattice_dim, data->streaming_build ? "2 x 2" : "3",
+			   (float)(size * sizeof(uint64_t)) / (1024.0f * 1024.0f));
+		if (!(data->occupancy = (uint64_t *)calloc(size, sizeof(uint64_t))))
+			error(MALLOC_FAIL_ERR, data);
+	}
+	else
+	{
+		size *= data->lattice_dim;
+		printf("\x1b[36m[%s]\x1b[0m Allocating shared lattice: %u^%s points (%.2f MB)\n", 
+			   __FILE__, data->lattice_dim, data->streaming_build ? "2 x 2" : "3",
+			   (float)(size * sizeof(float)) / (1024.0f * 1024.0f));
+		if (!(data->lattice = (float *)malloc(size * sizeof(float))))
+			error(MALLOC_FAIL_ERR, data);
+	}
+	
+	// Per-axis coordinates, so meshers can look positions up by index
+	if (!(data->lattice_coords = (float *)malloc(3 * (size_t)data->lattice_dim * sizeof(float))))
+		error(MALLOC_FAIL_ERR, data);
+	for (uint i = 0; i < data->lattice_dim; i++)
+	{
+		float3 p = lattice_point_pos(data->fract, i, i, i);
+		data->lattice_coords[i] = p.x;
+		data->lattice_coords[data->lattice_dim + i] = p.y;
+		data->lattice_coords[2 * data->lattice_dim + i] = p.z;
+	}
+}
+
 void						init_grid(t_data *data)
 {
 	t_fract 				*f;
 
 	f = data->fract;
+	
+	// Regeneration re-enters here: release the previous grid first
+	free(f->grid.x);
+	free(f->grid.y);
+	free(f->grid.z);
 	if (!(f->grid.x = (float *)malloc(((size_t)f->grid_size + 1) * sizeof(float))))
 		error(MALLOC_FAIL_ERR, data);
 	if (!(f->grid.y = (float *)malloc(((size_t)f->grid_size + 1) * sizeof(float))))
@@ -0,0 +1,403 @@
+#include "morphosis.h"
+
+/*
+** Interval culling.
+**
+** A box of lattice points is iterated as one quaternion of intervals:
+** each component is a range [lo, hi] holding that component for every
+** point of the box. Float rounding is monotone, so evaluating the
+** kernel's operations, in the kernel's order, on the range endpoints
+** encloses the values the kernel computes for each point; products take
+** the extremes of their four endpoint products, and squares of a range
+** spanning 0 start at 0. Once the lower bound of |z|^2 passes the escape
+** radius, every point of the box has escaped and the box is filled as
+** exterior without iterating a single point. Escapes are final, so a
+** proof under two-level sampling's low cap holds at the full one.
+**
+** Boxes start as cubes of CULL_TILE points. Those not proven split along
+** their longest axis, down to CULL_MIN_SIDE points a side, whose points
+** are then sampled through the batched kernels as usual. A failed test
+** costs about as much as a vector of samples, so smaller boxes are not
+** worth testing. Ranges slightly wider than the kernel's
+** values cost nothing but the odd proof; each step pads them by
+** CULL_SLACK so a kernel whose compiler fused a multiply-add stays
+** enclosed.
+**
+** Each task is a tile of CULL_TILE x CULL_TILE rows, cube after cube
+** along x, and owns those lattice rows, packed or not. Packed bits are
+** still OR-ed in atomically, as lattice_symmetry.c does, so the words
+** stay safe to share however tiles come to be cut.
+**
+** Under a lattice symmetry only the points lattice_symmetry_row()
+** picks are sampled, and boxes holding none of them are skipped; the
+** rest are copied once every tile is done. A culled box clears points
+** the copy then overwrites with the same value, as their canonical
+** points have escaped too.
+*/
+
+# define CULL_TILE 16				// Rows per side of a task's tile
+# define CULL_MIN_SIDE 8			// Boxes this small are sampled point by point
+# define CULL_SLACK 0x1p-18f		// Padding per step, relative to max(1, |range|)
+# define CULL_ESCAPE (4.0f + 0x1p-16f)	// Escape radius squared, padded likewise
+# define CULL_GIVE_UP 16.0f			// Widest range worth iterating further
+
+typedef struct				s_interval
+{
+	float					lo;
+	float					hi;
+}							t_interval;
+
+typedef struct				s_culling
+{
+	t_data					*data;
+	const t_sampler			*s;
+	uint					dim;
+	uint					words;			// OCCUPANCY_WORDS(dim)
+	uint					tiles;			// Tiles per side
+	const t_lattice_symmetry	*sym;		// Points sampled, NULL for all
+	size_t					culled;
+}							t_culling;
+
+typedef struct				s_cull_batch
+{
+	float					xs[SAMPLE_BATCH_CHUNK];
+	float					ys[SAMPLE_BATCH_CHUNK];
+	float					zs[SAMPLE_BATCH_CHUNK];
+	float					vals[SAMPLE_BATCH_CHUNK];
+	uint					idx[SAMPLE_BATCH_CHUNK][3];
+	uint					count;
+}							t_cull_batch;
+
+static inline t_interval	iv_point(float v)
+{
+	return (t_interval){v, v};
+}
+
+static inline t_interval	iv_add(t_interval a, t_interval b)
+{
+	return (t_interval){a.lo + b.lo, a.hi + b.hi};
+}
+
+static inline t_interval	iv_sub(t_interval a, t_interval b)
+{
+	return (t_interval){a.lo - b.hi, a.hi - b.lo};
+}
+
+static inline t_interval	iv_twice(t_interval a)
+{
+	return (t_interval){2.0f * a.lo, 2.0f * a.hi};
+}
+
+static inline t_interval	iv_sq(t_interval a)
+{
+	if (a.lo >= 0.0f)
+		return (t_interval){a.lo * a.lo, a.hi * a.hi};
+	if (a.hi <= 0.0f)
+		return (t_interval){a.hi * a.hi, a.lo * a.lo};
+	return (t_interval){0.0f, fmaxf(a.lo * a.lo, a.hi * a.hi)};
+}
+
+static inline t_interval	iv_mul(t_interval a, t_interval b)
+{
+	float					p[4];
+
+	p[0] = a.lo * b.lo;
+	p[1] = a.lo * b.hi;
+	p[2] = a.hi * b.lo;
+	p[3] = a.hi * b.hi;
+	return (t_interval){fminf(fminf(p[0], p[1]), fminf(p[2], p[3])),
+		fmaxf(fmaxf(p[0], p[1]), fmaxf(p[2], p[3]))};
+}
+
+static inline t_interval	iv_pad(t_interval a)
+{
+	float					pad;
+
+	pad = CULL_SLACK * fmaxf(1.0f, fmaxf(fabsf(a.lo), fabsf(a.hi)));
+	return (t_interval){a.lo - pad, a.hi + pad};
+}
+
+/**
+ * @brief Whether z^2 + c escapes within max_iter for every z and c in the ranges
+ *
+ * Mirrors BK_STEP_SQUARE and the escape test of the batched kernels. NaN
+ * ranges fail the width test and give up like overly wide ones.
+ */
+static int					orbit_escapes(t_interval *z, const t_interval *c, uint max_iter)
+{
+	t_interval				sq[4];
+	t_interval				n[4];
+	float					mag_lo;
+
+	for (uint iter = 0; iter < max_iter; iter++)
+	{
+		for (int i = 0; i < 4; i++)
+			sq[i] = iv_sq(z[i]);
+		n[0] = iv_add(iv_sub(iv_sub(iv_sub(sq[0], sq[1]), sq[2]), sq[3]), c[0]);
+		n[1] = iv_add(iv_twice(iv_mul(z[0], z[1])), c[1]);
+		n[2] = iv_add(iv_twice(iv_mul(z[0], z[2])), c[2]);
+		n[3] = iv_add(iv_twice(iv_mul(z[0], z[3])), c[3]);
+		for (int i = 0; i < 4; i++)
+			z[i] = iv_pad(n[i]);
+		mag_lo = 0.0f;
+		for (int i = 0; i < 4; i++)
+			mag_lo += iv_sq(z[i]).lo;
+		if (mag_lo > CULL_ESCAPE)
+			return 1;
+		for (int i = 0; i < 4; i++)
+			if (!(z[i].hi - z[i].lo <= CULL_GIVE_UP))
+				return 0;
+	}
+	return 0;
+}
+
+/**
+ * @brief Range of the kernels' input along each axis over lattice points lo..hi
+ *
+ * lattice_point_pos() grows with the index, and so does the division by
+ * the zoom level sample_fractal_batch() applies.
+ */
+static void					box_ranges(t_culling *c, const uint *lo, const uint *hi, t_interval *r)
+{
+	float3					a;
+	float3					b;
+	float					zoom;
+
+	a = lattice_point_pos(c->data->fract, lo[0], lo[1], lo[2]);
+	b = lattice_point_pos(c->data->fract, hi[0], hi[1], hi[2]);
+	if (c->s->zoom_level > 1.0)
+	{
+		zoom = (float)c->s->zoom_level;
+		a = (float3){a.x / zoom, a.y / zoom, a.z / zoom};
+		b = (float3){b.x / zoom, b.y / zoom, b.z / zoom};
+	}
+	r[0] = (t_interval){a.x, b.x};
+	r[1] = (t_interval){a.y, b.y};
+	r[2] = (t_interval){a.z, b.z};
+	r[3] = iv_point(c->s->julia.w);
+}
+
+/**
+ * @brief Whether every point of the box lo..hi is proven exterior
+ *
+ * The hybrid type needs both its sets to have escaped.
+ */
+static int					box_escapes(t_culling *c, const uint *lo, const uint *hi)
+{
+	const t_julia			*j;
+	t_interval				pos[4];
+	t_interval				q[4];
+	t_interval				k[4];
+
+	j = &c->s->julia;
+	box_ranges(c, lo, hi, pos);
+	if (c->s->fractal_type != 1)
+	{
+		memcpy(q, pos, sizeof(q));
+		k[0] = iv_point(j->c.x);
+		k[1] = iv_point(j->c.y);
+		k[2] = iv_point(j->c.z);
+		k[3] = iv_point(j->c.w);
+		if (!orbit_escapes(q, k, j->max_iter))
+			return 0;
+	}
+	if (c->s->fractal_type != 0)
+	{
+		q[0] = iv_point(j->c.x * 0.1f);
+		q[1] = iv_point(j->c.y * 0.1f);
+		q[2] = iv_point(j->c.z * 0.1f);
+		q[3] = iv_point(j->c.w * 0.1f);
+		if (!orbit_escapes(q, pos, j->max_iter))
+			return 0;
+	}
+	return 1;
+}
+
+static void					flush_batch(t_culling *c, t_cull_batch *b)
+{
+	uint					*p;
+
+	if (!b->count)
+		return;
+	sample_fractal_batch(c->s, b->xs, b->ys, b->zs, b->vals, b->count);
+	for (uint i = 0; i < b->count; i++)
+	{
+		p = b->idx[i];
+		if (c->data->packed_lattice)
+			__atomic_fetch_or(&c->data->occupancy[((size_t)p[2] * c->dim + p[1]) * c->words + (p[0] >> 6)],
+				(uint64_t)(b->vals[i] != 0.0f) << (p[0] & 63), __ATOMIC_RELAXED);
+		else
+			c->data->lattice[LATTICE_INDEX(p[0], p[1], p[2], c->dim)] = b->vals[i];
+	}
+	b->count = 0;
+}
+
+static void					sample_box(t_culling *c, t_cull_batch *b, const uint *lo, const uint *hi)
+{
+	float3					p;
+	uint64_t				row;
+
+	row = ~(uint64_t)0;
+	for (uint z = lo[2]; z <= hi[2]; z++)
+		for (uint y = lo[1]; y <= hi[1]; y++)
+		{
+			if (c->sym)
+				row = lattice_symmetry_row(c->sym, y, z, lo[0], hi[0]);
+			for (uint x = lo[0]; x <= hi[0]; x++)
+			{
+				if (!((row >> (x - lo[0])) & 1))
+					continue;
+				p = lattice_point_pos(c->data->fract, x, y, z);
+				b->xs[b->count] = p.x;
+				b->ys[b->count] = p.y;
+				b->zs[b->count] = p.z;
+				b->idx[b->count][0] = x;
+				b->idx[b->count][1] = y;
+				b->idx[b->count++][2] = z;
+				if (b->count == SAMPLE_BATCH_CHUNK)
+					flush_batch(c, b);
+			}
+		}
+}
+
+/**
+ * @brief Whether the symmetry leaves any point of the box lo..hi to sample
+ */
+static int					box_sampled(t_culling *c, const uint *lo, const uint *hi)
+{
+	if (!c->sym)
+		return 1;
+	for (uint z = lo[2]; z <= hi[2]; z++)
+		for (uint y = lo[1]; y <= hi[1]; y++)
+			if (lattice_symmetry_row(c->sym, y, z, lo[0], hi[0]))
+				return 1;
+	return 0;
+}
+
+/**
+ * @brief Fill the box lo..hi, culling what can be proven exterior
+ *
+ * @return Points culled
+ */
+static size_t				cull_box(t_culling *c, t_cull_batch *b, const uint *lo, const uint *hi)
+{
+	uint					mid[2][3];
+	int						axis;
+
+	if (!box_sampled(c, lo, hi))
+		return 0;
+	if (box_escapes(c, lo, hi))
+	{
+		// Packed rows start cleared
+		if (!c->data->packed_lattice)
+			for (uint z = lo[2]; z <= hi[2]; z++)
+				for (uint y = lo[1]; y <= hi[1]; y++)
+					memset(&c->data->lattice[LATTICE_INDEX(lo[0], y, z, c->dim)], 0,
+						(hi[0] - lo[0] + 1) * sizeof(float));
+		return (size_t)(hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+	}
+	axis = 0;
+	for (int i = 1; i < 3; i++)
+		if (hi[i] - lo[i] > hi[axis] - lo[axis])
+			axis = i;
+	if (hi[axis] - lo[axis] + 1 <= CULL_MIN_SIDE)
+	{
+		sample_box(c, b, lo, hi);
+		return 0;
+	}
+	memcpy(mid[0], hi, sizeof(mid[0]));
+	memcpy(mid[1], lo, sizeof(mid[1]));
+	mid[0][axis] = lo[axis] + (hi[axis] - lo[axis]) / 2;
+	mid[1][axis] = mid[0][axis] + 1;
+	return cull_box(c, b, lo, mid[0]) + cull_box(c, b, mid[1], hi);
+}
+
+/**
+ * @brief Fill the rows of tile t, every x of them
+ */
+static void					cull_tile(void *ctx, uint t, uint worker)
+{
+	t_culling				*c;
+	t_cull_batch			b;
+	uint					lo[3];
+	uint					hi[3];
+	size_t					culled;
+
+	(void)worker;
+	c = (t_culling *)ctx;
+	if (BUILD_CANCELLED(c->data))
+		return;
+	lo[1] = (t % c->tiles) * CULL_TILE;
+	lo[2] = (t / c->tiles) * CULL_TILE;
+	hi[1] = (lo[1] + CULL_TILE < c->dim ? lo[1] + CULL_TILE : c->dim) - 1;
+	hi[2] = (lo[2] + CULL_TILE < c->dim ? lo[2] + CULL_TILE : c->dim) - 1;
+	if (c->data->packed_lattice)
+		for (uint z = lo[2]; z <= hi[2]; z++)
+			memset(&c->data->occupancy[((size_t)z * c->dim + lo[1]) * c->words], 0,
+				(size_t)(hi[1] - lo[1] + 1) * c->words * sizeof(uint64_t));
+	b.count = 0;
+	culled = 0;
+	for (uint x = 0; x < c->dim; x += CULL_TILE)
+	{
+		lo[0] = x;
+		hi[0] = (x + CULL_TILE < c->dim ? x + CULL_TILE : c->dim) - 1;
+		culled += cull_box(c, &b, lo, hi);
+	}
+	flush_batch(c, &b);
+	__sync_add_and_fetch(&c->culled, culled);
+}
+
+/**
+ * @brief Whether this build's pass 1 can cull by interval arithmetic
+ *
+ * Only the squaring formula's membership, Julia, Mandelbrot or both,
+ * sampled at single points in float on a full lattice.
+ */
+int							lattice_culling(t_data *data)
+{
+	const t_sampler			*s;
+
+	s = &data->sampler;
+	if (!data->use_culling || !data->shared_lattice || data->streaming_build
+		|| data->orbit_cache_active || s->supersampling > 1 || s->deep_zoom != DEEP_ZOOM_OFF
+		|| s->field_kind != FIELD_MEMBERSHIP)
+		return 0;
+	return (s->fractal_type == 0 && s->formula == 0) || s->fractal_type == 1 || s->fractal_type == 2;
+}
+
+/**
+ * @brief Pass 1 of a lattice build, skipping boxes proven to escape
+ *
+ * @param maps SYM_* maps to sample under (from lattice_symmetry()), 0 for none
+ */
+void						sample_lattice_culled(t_data *data, uint maps)
+{
+	t_culling				c;
+	t_lattice_symmetry		sym;
+	uint					workers;
+	size_t					total;
+
+	memset(&c, 0, sizeof(c));
+	if (maps)
+	{
+		init_lattice_symmetry(data, maps, &sym);
+		c.sym = &sym;
+	}
+	c.data = data;
+	c.s = &data->sampler;
+	c.dim = data->lattice_dim;
+	c.words = OCCUPANCY_WORDS(c.dim);
+	c.tiles = (c.dim + CULL_TILE - 1) / CULL_TILE;
+	workers = data->num_threads ? data->num_threads : 1;
+	run_tasks_stealing(c.tiles * c.tiles, workers, cull_tile, &c);
+	if (BUILD_CANCELLED(data))
+		return;
+	if (maps)
+		copy_lattice_symmetric(&sym);
+
+	total = (size_t)c.dim * c.dim * c.dim;
+	printf("\x1b[36m[%s]\x1b[0m Interval culling: proved %zu of %zu points exterior (%.1f%%)%s%s%s%s%s\n", __FILE__,
+		   c.culled, total, 100.0 * (double)c.culled / (double)total, maps ? ", symmetry:" : "",
+		   (maps & SYM_MIRROR_Y) ? " mirror y" : "", (maps & SYM_MIRROR_Z) ? " mirror z" : "",
+		   (maps & SYM_SWAP_YZ) ? " swap y/z" : "", (maps & SYM_CENTRAL) ? " central" : "");
+}
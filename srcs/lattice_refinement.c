@@ -0,0 +1,286 @@
+#include "morphosis.h"
+
+/*
+** Two-level iteration budget.
+**
+** With adaptive_sampling on, pass 1 of build_fractal_lattice() classifies
+** the lattice with a low iteration cap. A point that escapes under the
+** cap escapes at the same step under max_iter, so only the survivors can
+** be wrong, and of those only the ones the surface can reach matter: the
+** survivors next to an escaped point are iterated again at full depth.
+** Each survivor that then escapes exposes its own neighbours, so the
+** front keeps moving inward until every survivor it touches holds at
+** max_iter. Deep interior points, where the iteration time goes, are
+** never iterated past the cap.
+**
+** Like the coarse-to-fine pass this assumes connected detail: a pocket of
+** exterior enclosed by points that hold at max_iter, and not touching any
+** point that escaped under the cap, is filled in.
+**
+** The state is read and written as bits in the occupancy layout. A packed
+** lattice is used in place; an unpacked one is mirrored into a bitmap and
+** every correction is written through to data->lattice.
+*/
+
+typedef struct				s_refine
+{
+	t_data					*data;
+	uint					dim;
+	uint					words;			// OCCUPANCY_WORDS(dim)
+	uint64_t				*bits;			// 1 where the point holds so far
+	uint64_t				*verified;		// 1 where it was iterated at full depth
+	uint64_t				*near;			// One row of escaped-neighbour bits
+	size_t					*front;			// Points to iterate this round
+	size_t					count;
+	size_t					*next;			// Points exposed by this round
+	size_t					next_count;
+	size_t					capacity;		// Of both front and next
+	float					*vals;
+	size_t					iterated;
+}							t_refine;
+
+static inline size_t		bit_word(t_refine *r, uint x, uint y, uint z)
+{
+	return ((size_t)z * r->dim + y) * r->words + (x >> 6);
+}
+
+static void					push_next(t_refine *r, size_t index)
+{
+	size_t					*grown;
+
+	if (r->next_count == r->capacity)
+	{
+		r->capacity *= 2;
+		if (!(grown = (size_t *)realloc(r->front, r->capacity * sizeof(size_t))))
+			error(MALLOC_FAIL_ERR, r->data);
+		r->front = grown;
+		if (!(grown = (size_t *)realloc(r->next, r->capacity * sizeof(size_t))))
+			error(MALLOC_FAIL_ERR, r->data);
+		r->next = grown;
+	}
+	r->next[r->next_count++] = index;
+}
+
+/**
+ * @brief Queue the survivors of row (y, z) that have an escaped neighbour
+ *
+ * Works a word at a time: the escaped points of the up to nine rows
+ * around the row are OR-ed together and dilated by one in x, which gives
+ * every point with an escaped point among its 26 neighbours.
+ */
+static void					seed_row(t_refine *r, uint y, uint z)
+{
+	uint64_t				*near;
+	uint64_t				valid;
+	uint64_t				around;
+	uint64_t				cand;
+	size_t					row;
+
+	near = r->near;
+	memset(near, 0, r->words * sizeof(uint64_t));
+	for (uint nz = z ? z - 1 : 0; nz <= z + 1 && nz < r->dim; nz++)
+	{
+		for (uint ny = y ? y - 1 : 0; ny <= y + 1 && ny < r->dim; ny++)
+		{
+			row = bit_word(r, 0, ny, nz);
+			for (uint w = 0; w < r->words; w++)
+			{
+				valid = (w == r->words - 1 && (r->dim & 63)) ? ((uint64_t)1 << (r->dim & 63)) - 1 : ~(uint64_t)0;
+				near[w] |= ~r->bits[row + w] & valid;
+			}
+		}
+	}
+	row = bit_word(r, 0, y, z);
+	for (uint w = 0; w < r->words; w++)
+	{
+		around = near[w] | (near[w] << 1) | (near[w] >> 1);
+		if (w > 0)
+			around |= near[w - 1] >> 63;
+		if (w + 1 < r->words)
+			around |= near[w + 1] << 63;
+		cand = r->bits[row + w] & around;
+		r->verified[row + w] |= cand;
+		while (cand)
+		{
+			push_next(r, LATTICE_INDEX(w * 64 + __builtin_ctzll(cand), y, z, r->dim));
+			cand &= cand - 1;
+		}
+	}
+}
+
+/**
+ * @brief Iterate one chunk of the front at full depth
+ */
+static void					iterate_front(void *ctx, uint task, uint worker)
+{
+	t_refine				*r;
+	float					xs[SAMPLE_BATCH_CHUNK];
+	float					ys[SAMPLE_BATCH_CHUNK];
+	float					zs[SAMPLE_BATCH_CHUNK];
+	float3					p;
+	size_t					first;
+	size_t					end;
+	size_t					i;
+	uint					n;
+
+	(void)worker;
+	r = (t_refine *)ctx;
+	first = (size_t)task * REFINE_TASK_POINTS;
+	end = first + REFINE_TASK_POINTS < r->count ? first + REFINE_TASK_POINTS : r->count;
+	for (size_t k = first; k < end && !BUILD_CANCELLED(r->data); k += SAMPLE_BATCH_CHUNK)
+	{
+		n = end - k < SAMPLE_BATCH_CHUNK ? (uint)(end - k) : SAMPLE_BATCH_CHUNK;
+		for (uint j = 0; j < n; j++)
+		{
+			i = r->front[k + j];
+			p = lattice_point_pos(r->data->fract, i % r->dim, (i / r->dim) % r->dim, i / ((size_t)r->dim * r->dim));
+			xs[j] = p.x;
+			ys[j] = p.y;
+			zs[j] = p.z;
+		}
+		sample_fractal_batch(&r->data->sampler, xs, ys, zs, &r->vals[k], n);
+	}
+}
+
+/**
+ * @brief Queue the unverified survivors among points lo..hi of row (y, z)
+ */
+static void					expose_run(t_refine *r, uint lo, uint hi, uint y, uint z)
+{
+	uint64_t				span;
+	uint64_t				cand;
+	size_t					row;
+	uint					a;
+	uint					b;
+
+	row = bit_word(r, 0, y, z);
+	for (uint w = lo >> 6; w <= hi >> 6; w++)
+	{
+		a = (lo > w * 64 ? lo : w * 64) & 63;
+		b = (hi < w * 64 + 63 ? hi : w * 64 + 63) & 63;
+		span = (~(uint64_t)0 >> (63 - b)) & (~(uint64_t)0 << a);
+		cand = r->bits[row + w] & ~r->verified[row + w] & span;
+		r->verified[row + w] |= cand;
+		while (cand)
+		{
+			push_next(r, LATTICE_INDEX(w * 64 + __builtin_ctzll(cand), y, z, r->dim));
+			cand &= cand - 1;
+		}
+	}
+}
+
+/**
+ * @brief Clear the front points that escaped and queue the survivors they expose
+ */
+static void					advance_front(t_refine *r)
+{
+	size_t					i;
+	uint					x;
+	uint					y;
+	uint					z;
+
+	r->next_count = 0;
+	for (size_t k = 0; k < r->count; k++)
+	{
+		if (r->vals[k] != 0.0f)
+			continue;
+		i = r->front[k];
+		x = i % r->dim;
+		y = (i / r->dim) % r->dim;
+		z = i / ((size_t)r->dim * r->dim);
+		r->bits[bit_word(r, x, y, z)] &= ~((uint64_t)1 << (x & 63));
+		if (!r->data->packed_lattice)
+			r->data->lattice[i] = 0.0f;
+		for (uint nz = z ? z - 1 : 0; nz <= z + 1 && nz < r->dim; nz++)
+			for (uint ny = y ? y - 1 : 0; ny <= y + 1 && ny < r->dim; ny++)
+				expose_run(r, x ? x - 1 : 0, x + 1 < r->dim ? x + 1 : x, ny, nz);
+	}
+}
+
+/**
+ * @brief Cap for the classification pass, or 0 to sample at full depth
+ *
+ * Two levels only pay off for binary fields on a full lattice, and when
+ * max_iter is deep enough for the cap to save iterations.
+ */
+uint						two_level_low_iter(t_data *data)
+{
+	uint					low;
+
+	if (!data->adaptive_sampling || !data->binary_field || data->streaming_build
+		|| data->orbit_cache_active)
+		return 0;
+	low = data->sampler.julia.max_iter / TWO_LEVEL_ITER_DIVISOR;
+	if (low < TWO_LEVEL_MIN_ITER)
+		low = TWO_LEVEL_MIN_ITER;
+	return low < data->sampler.julia.max_iter ? low : 0;
+}
+
+/**
+ * @brief Bring a lattice classified at low_iter to max_iter near the surface
+ */
+void						refine_lattice_boundary(t_data *data, uint low_iter)
+{
+	t_refine				r;
+	size_t					words;
+	size_t					*swap;
+	size_t					total;
+	uint					rounds;
+
+	memset(&r, 0, sizeof(r));
+	r.data = data;
+	r.dim = data->lattice_dim;
+	r.words = OCCUPANCY_WORDS(r.dim);
+	words = (size_t)r.words * r.dim * r.dim;
+	r.capacity = (size_t)r.dim * r.dim;
+	r.front = (size_t *)malloc(r.capacity * sizeof(size_t));
+	r.next = (size_t *)malloc(r.capacity * sizeof(size_t));
+	r.verified = (uint64_t *)calloc(words, sizeof(uint64_t));
+	r.near = (uint64_t *)malloc(r.words * sizeof(uint64_t));
+	r.bits = data->packed_lattice ? data->occupancy : (uint64_t *)calloc(words, sizeof(uint64_t));
+	if (!r.front || !r.next || !r.verified || !r.near || !r.bits)
+		error(MALLOC_FAIL_ERR, data);
+	if (!data->packed_lattice)
+	{
+		for (size_t row = 0; row < (size_t)r.dim * r.dim; row++)
+		{
+			for (uint x = 0; x < r.dim; x++)
+			{
+				if (data->lattice[row * r.dim + x] != 0.0f)
+					r.bits[row * r.words + (x >> 6)] |= (uint64_t)1 << (x & 63);
+			}
+		}
+	}
+
+	for (uint z = 0; z < r.dim; z++)
+		for (uint y = 0; y < r.dim; y++)
+			seed_row(&r, y, z);
+	for (rounds = 0; r.next_count && !BUILD_CANCELLED(data); rounds++)
+	{
+		swap = r.front;
+		r.front = r.next;
+		r.next = swap;
+		r.count = r.next_count;
+		free(r.vals);
+		if (!(r.vals = (float *)malloc(r.count * sizeof(float))))
+			error(MALLOC_FAIL_ERR, data);
+		run_tasks_stealing((uint)((r.count + REFINE_TASK_POINTS - 1) / REFINE_TASK_POINTS),
+			data->num_threads ? data->num_threads : 1, iterate_front, &r);
+		if (BUILD_CANCELLED(data))
+			break;
+		r.iterated += r.count;
+		advance_front(&r);
+	}
+
+	total = (size_t)r.dim * r.dim * r.dim;
+	printf("\x1b[36m[%s]\x1b[0m Two-level budget: %u iterations everywhere, %u on %zu of %zu points (%.1f%%, %u rounds)\n",
+		   __FILE__, low_iter, data->sampler.julia.max_iter, r.iterated, total,
+		   100.0 * (double)r.iterated / (double)total, rounds);
+	if (!data->packed_lattice)
+		free(r.bits);
+	free(r.verified);
+	free(r.near);
+	free(r.front);
+	free(r.next);
+	free(r.vals);
+}
@@ -0,0 +1,359 @@
+#include "morphosis.h"
+
+/*
+** Coarse-to-fine lattice sampling (Mariani-Silver in 3D).
+**
+** The lattice is cut into top-level bricks of LATTICE_MS_MIN_CELLS <<
+** max_grid_depth cells, shrunk until at least LATTICE_MS_MIN_BRICKS of
+** them span the lattice: a brick as large as the lattice would have
+** every face outside the set and pass as empty. A brick first samples
+** the lattice points on its six faces; if they all agree, the interior
+** is assumed to agree too and is filled without iterating. Otherwise the
+** brick splits in eight and each child repeats the test on its own faces
+** (shared split planes are only sampled once), down to bricks of
+** LATTICE_MS_MIN_CELLS cells which are sampled in full. Only bricks the
+** surface passes through reach full depth, so sampling cost follows the
+** surface area rather than the volume.
+**
+** Each task is one z-slab of top-level bricks and owns the lattice rows
+** of that slab, so slabs can be filled concurrently, packed or not.
+*/
+
+# define MS_UNKNOWN 2
+
+typedef struct				s_ms_slab
+{
+	t_data					*data;
+	uint					dim;
+	uint					cells;
+	uint					brick;			// Top-level brick size in cells
+	uint					side;			// Lattice points per local axis (brick + 1)
+	size_t					sampled;		// Points iterated, for the summary
+	uint					slabs_done;
+}							t_ms_slab;
+
+typedef struct				s_ms_brick
+{
+	t_ms_slab				*slab;
+	uint					ox;				// Lattice origin of the brick
+	uint					oy;
+	uint					oz;
+	unsigned char			*state;			// Local 0 / 1 / MS_UNKNOWN per point
+	uint					pending;		// Queued points in the batch below
+	uint					idx[SAMPLE_BATCH_CHUNK];
+	float					xs[SAMPLE_BATCH_CHUNK];
+	float					ys[SAMPLE_BATCH_CHUNK];
+	float					zs[SAMPLE_BATCH_CHUNK];
+	size_t					sampled;
+}							t_ms_brick;
+
+static inline uint			local_index(t_ms_brick *b, uint x, uint y, uint z)
+{
+	return ((z * b->slab->side) + y) * b->slab->side + x;
+}
+
+/**
+ * @brief Sample every queued point through the batched kernels
+ */
+static void					flush_batch(t_ms_brick *b)
+{
+	float					vals[SAMPLE_BATCH_CHUNK];
+
+	if (!b->pending)
+		return;
+	sample_fractal_batch(&b->slab->data->sampler, b->xs, b->ys, b->zs, vals, b->pending);
+	for (uint k = 0; k < b->pending; k++)
+		b->state[b->idx[k]] = vals[k] != 0.0f;
+	b->sampled += b->pending;
+	b->pending = 0;
+}
+
+static void					queue_point(t_ms_brick *b, uint x, uint y, uint z)
+{
+	float3					p;
+	uint					i;
+
+	i = local_index(b, x, y, z);
+	if (b->state[i] != MS_UNKNOWN)
+		return;
+	p = lattice_point_pos(b->slab->data->fract, b->ox + x, b->oy + y, b->oz + z);
+	b->state[i] = 0; // Claimed: queued once even if revisited before the flush
+	b->idx[b->pending] = i;
+	b->xs[b->pending] = p.x;
+	b->ys[b->pending] = p.y;
+	b->zs[b->pending] = p.z;
+	if (++b->pending == SAMPLE_BATCH_CHUNK)
+		flush_batch(b);
+}
+
+/**
+ * @brief Sample the points of local box [lo, hi] (inclusive), or only its faces
+ */
+static void					sample_box(t_ms_brick *b, uint3 lo, uint3 hi, int faces_only)
+{
+	for (uint z = lo.z; z <= hi.z; z++)
+	{
+		for (uint y = lo.y; y <= hi.y; y++)
+		{
+			int on_face = z == lo.z || z == hi.z || y == lo.y || y == hi.y;
+			if (faces_only && !on_face)
+			{
+				// Only the two x faces of an interior row
+				queue_point(b, lo.x, y, z);
+				queue_point(b, hi.x, y, z);
+				continue;
+			}
+			for (uint x = lo.x; x <= hi.x; x++)
+				queue_point(b, x, y, z);
+		}
+	}
+	flush_batch(b);
+}
+
+/**
+ * @brief Value shared by every face point of a box, or -1 if they differ
+ */
+static int					uniform_faces(t_ms_brick *b, uint3 lo, uint3 hi)
+{
+	int						v;
+
+	v = b->state[local_index(b, lo.x, lo.y, lo.z)];
+	for (uint z = lo.z; z <= hi.z; z++)
+	{
+		for (uint y = lo.y; y <= hi.y; y++)
+		{
+			// Interior rows only touch the box at its two x faces
+			uint step = (z == lo.z || z == hi.z || y == lo.y || y == hi.y) ? 1 : hi.x - lo.x;
+			for (uint x = lo.x; x <= hi.x; x += step)
+			{
+				if (b->state[local_index(b, x, y, z)] != v)
+					return -1;
+			}
+		}
+	}
+	return v;
+}
+
+static void					fill_box(t_ms_brick *b, uint3 lo, uint3 hi, int v)
+{
+	for (uint z = lo.z; z <= hi.z; z++)
+	{
+		for (uint y = lo.y; y <= hi.y; y++)
+		{
+			for (uint x = lo.x; x <= hi.x; x++)
+			{
+				if (b->state[local_index(b, x, y, z)] == MS_UNKNOWN)
+					b->state[local_index(b, x, y, z)] = (unsigned char)v;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Resolve every point of local box [lo, hi], subdividing mixed boxes
+ */
+static void					resolve_box(t_ms_brick *b, uint3 lo, uint3 hi)
+{
+	uint3					mid;
+	uint3					clo;
+	uint3					chi;
+	int						v;
+
+	sample_box(b, lo, hi, 1);
+	if ((v = uniform_faces(b, lo, hi)) >= 0)
+	{
+		fill_box(b, lo, hi, v);
+		return;
+	}
+	if (hi.x - lo.x <= LATTICE_MS_MIN_CELLS && hi.y - lo.y <= LATTICE_MS_MIN_CELLS
+		&& hi.z - lo.z <= LATTICE_MS_MIN_CELLS)
+	{
+		sample_box(b, lo, hi, 0);
+		return;
+	}
+
+	// Split every axis that still has interior points; children share the split planes
+	mid.x = (hi.x - lo.x >= 2) ? (lo.x + hi.x) / 2 : hi.x;
+	mid.y = (hi.y - lo.y >= 2) ? (lo.y + hi.y) / 2 : hi.y;
+	mid.z = (hi.z - lo.z >= 2) ? (lo.z + hi.z) / 2 : hi.z;
+	for (int c = 0; c < 8; c++)
+	{
+		clo.x = (c & 1) ? mid.x : lo.x;
+		chi.x = (c & 1) ? hi.x : mid.x;
+		clo.y = (c & 2) ? mid.y : lo.y;
+		chi.y = (c & 2) ? hi.y : mid.y;
+		clo.z = (c & 4) ? mid.z : lo.z;
+		chi.z = (c & 4) ? hi.z : mid.z;
+		if (clo.x == chi.x || clo.y == chi.y || clo.z == chi.z)
+			continue; // Axis not split: only one child along it
+		resolve_box(b, clo, chi);
+	}
+}
+
+/**
+ * @brief Last local z plane a brick writes to the shared lattice
+ *
+ * The upper z face belongs to the next slab, possibly being filled by
+ * another worker at the same time, unless it is the end of the lattice.
+ */
+static uint					owned_z(t_ms_brick *b, uint3 hi)
+{
+	return (b->oz + hi.z == b->slab->cells) ? hi.z : hi.z - 1;
+}
+
+/**
+ * @brief Shared lattice access by global lattice index
+ */
+static void					store_point(t_data *data, uint x, uint y, uint z, unsigned char v)
+{
+	uint64_t				*word;
+
+	if (!data->packed_lattice)
+	{
+		data->lattice[LATTICE_INDEX(x, y, z, data->lattice_dim)] = v;
+		return;
+	}
+	word = &data->occupancy[((size_t)z * data->lattice_dim + y) * OCCUPANCY_WORDS(data->lattice_dim) + (x >> 6)];
+	*word = (*word & ~((uint64_t)1 << (x & 63))) | ((uint64_t)v << (x & 63));
+}
+
+static unsigned char		load_point(t_data *data, uint x, uint y, uint z)
+{
+	if (!data->packed_lattice)
+		return data->lattice[LATTICE_INDEX(x, y, z, data->lattice_dim)] != 0.0f;
+	return (data->occupancy[((size_t)z * data->lattice_dim + y) * OCCUPANCY_WORDS(data->lattice_dim)
+		+ (x >> 6)] >> (x & 63)) & 1;
+}
+
+/**
+ * @brief Copy a brick's points of its slab into the shared lattice
+ */
+static void					store_brick(t_ms_brick *b, uint3 hi)
+{
+	for (uint z = 0; z <= owned_z(b, hi); z++)
+	{
+		for (uint y = 0; y <= hi.y; y++)
+		{
+			for (uint x = 0; x <= hi.x; x++)
+				store_point(b->slab->data, b->ox + x, b->oy + y, b->oz + z,
+					b->state[local_index(b, x, y, z)]);
+		}
+	}
+}
+
+/**
+ * @brief Seed a brick with the faces its x and y predecessors already resolved
+ *
+ * Bricks of a slab run in order on one worker, so the lower x and y faces
+ * were stored by the previous bricks and need not be sampled again.
+ */
+static void					load_brick_faces(t_ms_brick *b, uint3 hi)
+{
+	t_data					*data;
+
+	data = b->slab->data;
+	for (uint z = 0; z <= owned_z(b, hi); z++)
+	{
+		for (uint y = 0; y <= hi.y; y++)
+		{
+			if (y == 0 && b->oy > 0)
+			{
+				for (uint x = 0; x <= hi.x; x++)
+					b->state[local_index(b, x, y, z)] = load_point(data, b->ox + x, b->oy, b->oz + z);
+			}
+			else if (b->ox > 0)
+				b->state[local_index(b, 0, y, z)] = load_point(data, b->ox, b->oy + y, b->oz + z);
+		}
+	}
+}
+
+static void					resolve_slab(void *ctx, uint slab_z, uint worker)
+{
+	t_ms_slab				*s;
+	t_ms_brick				b;
+	uint3					lo;
+	uint3					hi;
+	size_t					points;
+
+	(void)worker;
+	s = (t_ms_slab *)ctx;
+	points = (size_t)s->side * s->side * s->side;
+	if (!(b.state = (unsigned char *)malloc(points)))
+		error(MALLOC_FAIL_ERR, s->data);
+	b.slab = s;
+	b.pending = 0;
+	b.sampled = 0;
+	b.oz = slab_z * s->brick;
+	lo.x = 0;
+	lo.y = 0;
+	lo.z = 0;
+	for (b.oy = 0; b.oy < s->cells; b.oy += s->brick)
+	{
+		for (b.ox = 0; b.ox < s->cells && !BUILD_CANCELLED(s->data); b.ox += s->brick)
+		{
+			hi.x = (s->cells - b.ox < s->brick) ? s->cells - b.ox : s->brick;
+			hi.y = (s->cells - b.oy < s->brick) ? s->cells - b.oy : s->brick;
+			hi.z = (s->cells - b.oz < s->brick) ? s->cells - b.oz : s->brick;
+			memset(b.state, MS_UNKNOWN, points);
+			load_brick_faces(&b, hi);
+			resolve_box(&b, lo, hi);
+			store_brick(&b, hi);
+		}
+	}
+	free(b.state);
+	__sync_add_and_fetch(&s->sampled, b.sampled);
+	printf("%u/%u\n", __sync_add_and_fetch(&s->slabs_done, 1),
+		(s->cells + s->brick - 1) / s->brick);
+}
+
+/**
+ * @brief Subdivision depth coarse-to-fine sampling runs at on data's grid
+ *
+ * max_grid_depth, at most LATTICE_MS_MAX_DEPTH, lowered until at least
+ * LATTICE_MS_MIN_BRICKS top-level bricks span the lattice.
+ */
+uint						coarse_to_fine_depth(t_data *data)
+{
+	uint					depth;
+	uint					cells;
+
+	depth = data->max_grid_depth < 0 ? 0 : (uint)data->max_grid_depth;
+	if (depth > LATTICE_MS_MAX_DEPTH)
+		depth = LATTICE_MS_MAX_DEPTH;
+	cells = lattice_cells(data->fract);
+	while (depth > 0 && ((uint)LATTICE_MS_MIN_CELLS << depth) * LATTICE_MS_MIN_BRICKS > cells)
+		depth--;
+	return depth;
+}
+
+/**
+ * @brief Fill data->lattice (or data->occupancy) coarse to fine
+ *
+ * Replaces the exhaustive sampling pass of build_fractal_lattice() for
+ * binary fields when adaptive_grid is on. Like every Mariani-Silver
+ * scheme it assumes a brick with a uniform boundary holds no detail, so
+ * features smaller than a brick that do not touch its faces are lost;
+ * max_grid_depth trades that risk against speed.
+ */
+void						sample_lattice_coarse_to_fine(t_data *data)
+{
+	t_ms_slab				s;
+	uint					slabs;
+	uint					depth;
+
+	depth = coarse_to_fine_depth(data);
+	s.data = data;
+	s.dim = data->lattice_dim;
+	s.cells = s.dim - 1;
+	s.brick = LATTICE_MS_MIN_CELLS << depth;
+	s.side = s.brick + 1;
+	s.sampled = 0;
+	s.slabs_done = 0;
+	if (data->packed_lattice)
+		memset(data->occupancy, 0, (size_t)OCCUPANCY_WORDS(s.dim) * s.dim * s.dim * sizeof(uint64_t));
+	slabs = (s.cells + s.brick - 1) / s.brick;
+	run_tasks_stealing(slabs, data->num_threads ? data->num_threads : 1, resolve_slab, &s);
+	printf("\x1b[36m[%s]\x1b[0m Coarse-to-fine at depth %u (%d set): iterated %zu of %zu lattice points (%.1f%%)\n",
+		   __FILE__, depth, data->max_grid_depth, s.sampled, (size_t)s.dim * s.dim * s.dim,
+		   100.0 * (double)s.sampled / ((double)s.dim * s.dim * s.dim));
+}
@@ -0,0 +1,228 @@
+#include "morphosis.h"
+
+/*
+** Boundary supersampling.
+**
+** A supersampled lattice build samples its points once, plainly, and
+** only box-filters the corners of the cells the surface crosses: every
+** other corner's box lies in a run of cells that are all inside or all
+** outside, and filtering it would give back the plain sample. The
+** sub-samples form one lattice, step / samples apart, on which the boxes
+** of neighbouring corners tile without overlap, so each sub-sample is
+** taken once and every cell sharing a corner shares its value. With an
+** odd count the middle sub-sample is the corner itself, which pass 1
+** already sampled.
+**
+** Like the coarse-to-fine pass this assumes connected detail: a box that
+** holds detail but touches no crossing cell keeps its plain sample.
+*/
+
+typedef struct				s_supersample
+{
+	t_data					*data;
+	uint					dim;
+	uint					words;			// OCCUPANCY_WORDS(dim)
+	uint					samples;		// Sub-samples per axis
+	uint64_t				*need;			// 1 where the corner gets filtered
+	float					*sums;			// One row of box sums per worker
+}							t_supersample;
+
+typedef struct				s_subs
+{
+	float					xs[SAMPLE_BATCH_CHUNK];
+	float					ys[SAMPLE_BATCH_CHUNK];
+	float					zs[SAMPLE_BATCH_CHUNK];
+	float					vals[SAMPLE_BATCH_CHUNK];
+	uint					owner[SAMPLE_BATCH_CHUNK];	// x of the corner each one filters
+	uint					count;
+}							t_subs;
+
+static inline uint64_t		word_at(uint64_t *row, uint w, uint words)
+{
+	return w < words ? row[w] : 0;
+}
+
+/**
+ * @brief Mark the corners of the crossing cells of row (y, z) in need
+ *
+ * A cell crosses when its eight corners are not all on one side; the
+ * four corner rows are combined a word at a time and shifted by one in x
+ * to pair every corner with its neighbour.
+ */
+static void					mark_row(t_supersample *ss, uint64_t *inside, uint y, uint z)
+{
+	uint64_t				*rows[4];
+	uint64_t				all[2];
+	uint64_t				any[2];
+	uint64_t				cross;
+	uint64_t				valid;
+	size_t					at;
+	uint					cells;
+
+	cells = ss->dim - 1;
+	rows[0] = &inside[((size_t)z * ss->dim + y) * ss->words];
+	rows[1] = rows[0] + ss->words;
+	rows[2] = rows[0] + (size_t)ss->dim * ss->words;
+	rows[3] = rows[2] + ss->words;
+	for (uint w = 0; w < ss->words; w++)
+	{
+		for (uint k = 0; k < 2; k++)
+		{
+			all[k] = word_at(rows[0], w + k, ss->words) & word_at(rows[1], w + k, ss->words)
+				& word_at(rows[2], w + k, ss->words) & word_at(rows[3], w + k, ss->words);
+			any[k] = word_at(rows[0], w + k, ss->words) | word_at(rows[1], w + k, ss->words)
+				| word_at(rows[2], w + k, ss->words) | word_at(rows[3], w + k, ss->words);
+		}
+
+		// Bit x: cell x, between corners x and x + 1
+		valid = (w * 64 + 64 <= cells) ? ~(uint64_t)0 :
+			(w * 64 < cells ? ((uint64_t)1 << (cells - w * 64)) - 1 : 0);
+		cross = ((any[0] | (any[0] >> 1) | (any[1] << 63))
+			& ~(all[0] & ((all[0] >> 1) | (all[1] << 63)))) & valid;
+		if (!cross)
+			continue;
+		for (uint k = 0; k < 4; k++)
+		{
+			at = (size_t)(rows[k] - inside) + w;
+			ss->need[at] |= cross | (cross << 1);
+			if (cross >> 63)
+				ss->need[at + 1] |= 1;
+		}
+	}
+}
+
+/**
+ * @brief Sample the pending sub-samples and add them to their corners' sums
+ */
+static void					flush_subs(t_supersample *ss, t_subs *b, float *sums)
+{
+	if (!b->count)
+		return;
+	sample_fractal_batch(&ss->data->sampler, b->xs, b->ys, b->zs, b->vals, b->count);
+	for (uint i = 0; i < b->count; i++)
+		sums[b->owner[i]] += b->vals[i];
+	b->count = 0;
+}
+
+/**
+ * @brief Queue the sub-samples of corner x, in sample_with_supersampling() order
+ */
+static void					queue_corner(t_supersample *ss, t_subs *b, float *sums, float3 p, uint x)
+{
+	float					step;
+	uint					n;
+	int						center;
+
+	step = ss->data->fract->step_size;
+	n = ss->samples;
+	center = (n % 2) ? (int)(n / 2) : -1;
+	for (uint i = 0; i < n; i++)
+	{
+		for (uint j = 0; j < n; j++)
+		{
+			for (uint k = 0; k < n; k++)
+			{
+				if ((int)i == center && (int)j == center && (int)k == center)
+					continue;
+				if (b->count == SAMPLE_BATCH_CHUNK)
+					flush_subs(ss, b, sums);
+				b->xs[b->count] = p.x + supersample_offset(i, n, step);
+				b->ys[b->count] = p.y + supersample_offset(j, n, step);
+				b->zs[b->count] = p.z + supersample_offset(k, n, step);
+				b->owner[b->count++] = x;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Filter the marked corners of lattice plane z
+ */
+static void					filter_plane(void *ctx, uint z, uint worker)
+{
+	t_supersample			*ss;
+	t_subs					b;
+	float					*sums;
+	float					*row;
+	uint64_t				*need;
+	uint64_t				bits;
+	uint					x;
+	float					volume;
+
+	ss = (t_supersample *)ctx;
+	sums = &ss->sums[(size_t)worker * ss->dim];
+	volume = (float)(ss->samples * ss->samples * ss->samples);
+	b.count = 0;
+	for (uint y = 0; y < ss->dim && !BUILD_CANCELLED(ss->data); y++)
+	{
+		row = &ss->data->lattice[LATTICE_INDEX(0, y, z, ss->dim)];
+		need = &ss->need[((size_t)z * ss->dim + y) * ss->words];
+		for (uint w = 0; w < ss->words; w++)
+		{
+			for (bits = need[w]; bits; bits &= bits - 1)
+			{
+				x = w * 64 + __builtin_ctzll(bits);
+				sums[x] = (ss->samples % 2) ? row[x] : 0.0f;
+				queue_corner(ss, &b, sums, lattice_point_pos(ss->data->fract, x, y, z), x);
+			}
+		}
+		flush_subs(ss, &b, sums);
+		for (uint w = 0; w < ss->words; w++)
+		{
+			for (bits = need[w]; bits; bits &= bits - 1)
+			{
+				x = w * 64 + __builtin_ctzll(bits);
+				row[x] = sums[x] / volume;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Box-filter the corners of the crossing cells of a plainly sampled lattice
+ *
+ * Expects data->sampler to sample single points; the filtered values
+ * match sample_with_supersampling() at samples per axis.
+ */
+void						supersample_lattice_boundary(t_data *data, uint samples)
+{
+	t_supersample			ss;
+	uint64_t				*inside;
+	size_t					words;
+	size_t					marked;
+	uint					workers;
+
+	memset(&ss, 0, sizeof(ss));
+	ss.data = data;
+	ss.dim = data->lattice_dim;
+	ss.words = OCCUPANCY_WORDS(ss.dim);
+	ss.samples = samples;
+	workers = data->num_threads ? data->num_threads : 1;
+	words = (size_t)ss.words * ss.dim * ss.dim;
+	inside = (uint64_t *)calloc(words, sizeof(uint64_t));
+	ss.need = (uint64_t *)calloc(words, sizeof(uint64_t));
+	ss.sums = (float *)malloc((size_t)workers * ss.dim * sizeof(float));
+	if (!inside || !ss.need || !ss.sums)
+		error(MALLOC_FAIL_ERR, data);
+	for (size_t row = 0; row < (size_t)ss.dim * ss.dim; row++)
+	{
+		for (uint x = 0; x < ss.dim; x++)
+		{
+			if (data->lattice[row * ss.dim + x] > data->inside_level)
+				inside[row * ss.words + (x >> 6)] |= (uint64_t)1 << (x & 63);
+		}
+	}
+	for (uint z = 0; z + 1 < ss.dim; z++)
+		for (uint y = 0; y + 1 < ss.dim; y++)
+			mark_row(&ss, inside, y, z);
+	marked = 0;
+	for (size_t w = 0; w < words; w++)
+		marked += __builtin_popcountll(ss.need[w]);
+
+	run_tasks_stealing(ss.dim, workers, filter_plane, &ss);
+	printf("\x1b[36m[%s]\x1b[0m Supersampled %zu of %zu points at %ux%ux%u\n",
+		   __FILE__, marked, (size_t)ss.dim * ss.dim * ss.dim, samples, samples, samples);
+	free(inside);
+	free(ss.need);
+	free(ss.sums);
+}
@@ -0,0 +1,350 @@
+#include "morphosis.h"
+
+/*
+** Symmetric lattice sampling.
+**
+** Under z^2 + c, rotating or reflecting the (y, z, w) part of a
+** quaternion commutes with the iteration whenever it fixes the (y, z, w)
+** part of c, and |z| does not change. The sampled slice keeps w fixed, so
+** the usable maps act on (y, z): the mirror z -> -z when c.z is 0, y -> -y
+** when c.y is 0, and with both the slice is a solid of revolution about
+** x, of which the lattice sees the eight maps of the square. The Julia
+** sets also have z -> -z on the whole quaternion, which the slice keeps
+** when w is 0. The Mandelbrot set's orbits start at c / 10 and share the
+** (y, z) conditions.
+**
+** Lattice point k sits at p0 + (k - 0.5) * step, so the mirror of point
+** k is point K - k where K = 1 - 2 * p0 / step, when that is a whole
+** number. Points whose image falls outside the lattice are sampled
+** directly. Every other point is copied from the canonical point of its
+** orbit, so only about one point per orbit is iterated. The maps are
+** resolved a row at a time: a row maps onto one canonical row, with x
+** kept, reversed, or reversed below the mirror plane only. Interval
+** culling samples the same points, see lattice_culling.c.
+*/
+
+# define SYM_ROW_SAME 0
+# define SYM_ROW_REVERSED 1
+# define SYM_ROW_HALF 2
+
+typedef struct				s_sym_batch
+{
+	float					xs[SAMPLE_BATCH_CHUNK];
+	float					ys[SAMPLE_BATCH_CHUNK];
+	float					zs[SAMPLE_BATCH_CHUNK];
+	float					vals[SAMPLE_BATCH_CHUNK];
+	uint					x[SAMPLE_BATCH_CHUNK];
+	uint					y[SAMPLE_BATCH_CHUNK];
+	uint					count;
+}							t_sym_batch;
+
+/**
+ * @brief Whether the lattice along an axis is symmetric about 0
+ *
+ * @param k Set to the mirror sum K: point i mirrors to point K - i
+ */
+static int					mirror_sum(float p0, float step, int *k)
+{
+	double					t;
+
+	t = 1.0 - 2.0 * (double)p0 / (double)step;
+	*k = (int)lround(t);
+	return fabs(t - (double)*k) < 1e-3;
+}
+
+/**
+ * @brief Canonical row of the orbit of row (y, z) under s->maps
+ *
+ * Works on u = 2i - K, the doubled offset from the mirror plane, where
+ * every map is a sign flip or a swap. Only the central symmetry moves x:
+ * mode (SYM_ROW_*) says how, see rep_x().
+ *
+ * @return Whether the canonical row lies on the lattice
+ */
+static int					row_map(const t_lattice_symmetry *s, uint y, uint z, uint *ry, uint *rz, int *mode)
+{
+	int						u[2];
+	int						t;
+
+	u[0] = 2 * (int)y - s->k[1];
+	u[1] = 2 * (int)z - s->k[2];
+	if ((s->maps & SYM_MIRROR_Y) && u[0] < 0)
+		u[0] = -u[0];
+	if ((s->maps & SYM_MIRROR_Z) && u[1] < 0)
+		u[1] = -u[1];
+	if ((s->maps & SYM_SWAP_YZ) && u[0] > u[1])
+	{
+		t = u[0];
+		u[0] = u[1];
+		u[1] = t;
+	}
+	*mode = SYM_ROW_SAME;
+	if (s->maps & SYM_CENTRAL)
+	{
+		// Negate x and the components no mirror settled when the first
+		// nonzero of those (z, then y) is negative; with none, x decides
+		t = !(s->maps & SYM_MIRROR_Z) ? u[1] : 0;
+		if (!t && !(s->maps & SYM_MIRROR_Y))
+			t = u[0];
+		if (!t)
+			*mode = SYM_ROW_HALF;
+		else if (t < 0)
+		{
+			*mode = SYM_ROW_REVERSED;
+			if (!(s->maps & SYM_MIRROR_Y))
+				u[0] = -u[0];
+			if (!(s->maps & SYM_MIRROR_Z))
+				u[1] = -u[1];
+		}
+	}
+	t = (u[0] + s->k[1]) / 2;
+	*ry = (uint)t;
+	if (t < 0 || t >= (int)s->dim)
+		return 0;
+	t = (u[1] + s->k[2]) / 2;
+	*rz = (uint)t;
+	return t >= 0 && t < (int)s->dim;
+}
+
+/**
+ * @brief x of the canonical point of x under mode, -1 off the lattice
+ */
+static inline int			rep_x(const t_lattice_symmetry *s, int mode, uint x)
+{
+	int						r;
+
+	if (mode == SYM_ROW_SAME || (mode == SYM_ROW_HALF && 2 * (int)x >= s->k[0]))
+		return (int)x;
+	r = s->k[0] - (int)x;
+	return r >= 0 && r < (int)s->dim ? r : -1;
+}
+
+/**
+ * @brief Store v at point (x, y, z)
+ *
+ * Packed words are OR-ed atomically: while planes are copied, a word of a
+ * canonical row may be read by the worker of another plane.
+ */
+static void					store_value(t_lattice_symmetry *s, uint x, uint y, uint z, float v)
+{
+	if (s->data->packed_lattice)
+		__atomic_fetch_or(&s->data->occupancy[((size_t)z * s->dim + y) * s->words + (x >> 6)],
+			(uint64_t)(v != 0.0f) << (x & 63), __ATOMIC_RELAXED);
+	else
+		s->data->lattice[LATTICE_INDEX(x, y, z, s->dim)] = v;
+}
+
+static void					flush_batch(t_lattice_symmetry *s, t_sym_batch *b, uint z)
+{
+	if (!b->count)
+		return;
+	sample_fractal_batch(&s->data->sampler, b->xs, b->ys, b->zs, b->vals, b->count);
+	for (uint i = 0; i < b->count; i++)
+		store_value(s, b->x[i], b->y[i], z, b->vals[i]);
+	__sync_add_and_fetch(&s->sampled, b->count);
+	b->count = 0;
+}
+
+/**
+ * @brief Sample the points of plane z that no other point stands in for
+ */
+static void					sample_plane(void *ctx, uint z, uint worker)
+{
+	t_lattice_symmetry		*s;
+	t_sym_batch				b;
+	uint					ry;
+	uint					rz;
+	int						mode;
+	int						all;
+	int						own;
+	int						r;
+	float3					p;
+
+	(void)worker;
+	s = (t_lattice_symmetry *)ctx;
+	b.count = 0;
+	if (s->data->packed_lattice)
+		memset(&s->data->occupancy[(size_t)z * s->dim * s->words], 0,
+			(size_t)s->dim * s->words * sizeof(uint64_t));
+	for (uint y = 0; y < s->dim && !BUILD_CANCELLED(s->data); y++)
+	{
+		all = !row_map(s, y, z, &ry, &rz, &mode);
+		own = ry == y && rz == z;
+		if (!all && mode == SYM_ROW_SAME && !own)
+			continue;
+		for (uint x = 0; x < s->dim; x++)
+		{
+			r = rep_x(s, mode, x);
+			if (!all && r >= 0 && !(own && r == (int)x))
+				continue;
+			p = lattice_point_pos(s->data->fract, x, y, z);
+			b.xs[b.count] = p.x;
+			b.ys[b.count] = p.y;
+			b.zs[b.count] = p.z;
+			b.x[b.count] = x;
+			b.y[b.count++] = y;
+			if (b.count == SAMPLE_BATCH_CHUNK)
+				flush_batch(s, &b, z);
+		}
+	}
+	flush_batch(s, &b, z);
+}
+
+/**
+ * @brief Copy every other point of plane z from its canonical point
+ *
+ * Canonical points are all sampled by sample_plane(), so planes can be
+ * copied in any order. A reversed row's canonical row may be one whose
+ * other points the worker of its plane is filling, so its bits are
+ * loaded atomically; rows copied whole are canonical throughout and
+ * never written here.
+ */
+static void					copy_plane(void *ctx, uint z, uint worker)
+{
+	t_lattice_symmetry		*s;
+	uint64_t				*occ;
+	uint					ry;
+	uint					rz;
+	int						mode;
+	int						r;
+	float					v;
+
+	(void)worker;
+	s = (t_lattice_symmetry *)ctx;
+	occ = s->data->occupancy;
+	for (uint y = 0; y < s->dim && !BUILD_CANCELLED(s->data); y++)
+	{
+		if (!row_map(s, y, z, &ry, &rz, &mode) || (mode == SYM_ROW_SAME && ry == y && rz == z))
+			continue;
+		if (mode == SYM_ROW_SAME && s->data->packed_lattice)
+			memcpy(&occ[((size_t)z * s->dim + y) * s->words],
+				&occ[((size_t)rz * s->dim + ry) * s->words], s->words * sizeof(uint64_t));
+		else if (mode == SYM_ROW_SAME)
+			memcpy(&s->data->lattice[LATTICE_INDEX(0, y, z, s->dim)],
+				&s->data->lattice[LATTICE_INDEX(0, ry, rz, s->dim)], s->dim * sizeof(float));
+		else
+		{
+			for (uint x = 0; x < s->dim; x++)
+			{
+				if ((r = rep_x(s, mode, x)) < 0 || (r == (int)x && ry == y && rz == z))
+					continue;
+				if (s->data->packed_lattice)
+					v = (float)((__atomic_load_n(&occ[((size_t)rz * s->dim + ry) * s->words + (r >> 6)],
+						__ATOMIC_RELAXED) >> (r & 63)) & 1);
+				else
+					v = s->data->lattice[LATTICE_INDEX(r, ry, rz, s->dim)];
+				store_value(s, x, y, z, v);
+			}
+		}
+	}
+}
+
+/**
+ * @brief SYM_* maps this build's lattice can be sampled under, 0 for none
+ *
+ * Only the squaring formula, sampled at single points on a full lattice.
+ */
+uint						lattice_symmetry(t_data *data)
+{
+	const t_sampler			*s;
+	t_fract					*f;
+	uint					maps;
+	int						k[3];
+
+	s = &data->sampler;
+	f = data->fract;
+	if (!data->use_symmetry || !data->shared_lattice || data->streaming_build
+		|| data->orbit_cache_active || s->supersampling > 1)
+		return 0;
+	if (!(s->fractal_type == 0 && s->formula == 0) && s->fractal_type != 1)
+		return 0;
+	if (!mirror_sum(f->p0.y, f->step_size, &k[1]) || !mirror_sum(f->p0.z, f->step_size, &k[2]))
+		return 0;
+	maps = 0;
+	if (s->julia.c.y == 0.0f)
+		maps |= SYM_MIRROR_Y;
+	if (s->julia.c.z == 0.0f)
+		maps |= SYM_MIRROR_Z;
+	if ((maps & SYM_MIRROR_Y) && (maps & SYM_MIRROR_Z) && k[1] == k[2])
+		maps |= SYM_SWAP_YZ;
+	if (s->fractal_type == 0 && s->julia.w == 0.0f && mirror_sum(f->p0.x, f->step_size, &k[0]))
+		maps |= SYM_CENTRAL;
+	return maps;
+}
+
+/**
+ * @brief Set s up for data's lattice under maps (from lattice_symmetry())
+ */
+void						init_lattice_symmetry(t_data *data, uint maps, t_lattice_symmetry *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->data = data;
+	s->dim = data->lattice_dim;
+	s->words = OCCUPANCY_WORDS(s->dim);
+	s->maps = maps;
+	mirror_sum(data->fract->p0.x, data->fract->step_size, &s->k[0]);
+	mirror_sum(data->fract->p0.y, data->fract->step_size, &s->k[1]);
+	mirror_sum(data->fract->p0.z, data->fract->step_size, &s->k[2]);
+}
+
+/**
+ * @brief Points x0..x1 of row (y, z) that are iterated, as bits
+ *
+ * Bit i stands for point x0 + i, with x1 - x0 < 64. The others are
+ * filled by copy_lattice_symmetric().
+ */
+uint64_t					lattice_symmetry_row(const t_lattice_symmetry *s, uint y, uint z, uint x0, uint x1)
+{
+	uint64_t				all;
+	uint64_t				bits;
+	uint					ry;
+	uint					rz;
+	int						mode;
+	int						own;
+	int						r;
+
+	all = x1 - x0 == 63 ? ~(uint64_t)0 : ((uint64_t)1 << (x1 - x0 + 1)) - 1;
+	if (!row_map(s, y, z, &ry, &rz, &mode))
+		return all;
+	own = ry == y && rz == z;
+	if (mode == SYM_ROW_SAME)
+		return own ? all : 0;
+	bits = 0;
+	for (uint x = x0; x <= x1; x++)
+	{
+		r = rep_x(s, mode, x);
+		if (r < 0 || (own && r == (int)x))
+			bits |= (uint64_t)1 << (x - x0);
+	}
+	return bits;
+}
+
+/**
+ * @brief Fill every point not iterated from its canonical point, once
+ * all of those are sampled
+ */
+void						copy_lattice_symmetric(t_lattice_symmetry *s)
+{
+	run_tasks_stealing(s->dim, s->data->num_threads ? s->data->num_threads : 1, copy_plane, s);
+}
+
+/**
+ * @brief Pass 1 of a lattice build, iterating one point per orbit of maps
+ */
+void						sample_lattice_symmetric(t_data *data, uint maps)
+{
+	t_lattice_symmetry		s;
+	size_t					total;
+
+	init_lattice_symmetry(data, maps, &s);
+	run_tasks_stealing(s.dim, data->num_threads ? data->num_threads : 1, sample_plane, &s);
+	if (BUILD_CANCELLED(data))
+		return;
+	copy_lattice_symmetric(&s);
+
+	total = (size_t)s.dim * s.dim * s.dim;
+	printf("\x1b[36m[%s]\x1b[0m Symmetry:%s%s%s%s, sampled %zu of %zu points (%.1f%%)\n", __FILE__,
+		   (maps & SYM_MIRROR_Y) ? " mirror y" : "", (maps & SYM_MIRROR_Z) ? " mirror z" : "",
+		   (maps & SYM_SWAP_YZ) ? " swap y/z" : "", (maps & SYM_CENTRAL) ? " central" : "",
+		   s.sampled, total, 100.0 * (double)s.sampled / (double)total);
+}
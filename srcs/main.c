@@ -36,6 +36,18 @@ static t_data 						*get_args(int argv, char **argc)
 			data->fract->julia->max_iter = mat.iter;
 			return data;
 		}
+        else if (argv == 3 && !(strcmp(argc[1], "-f")))
+		{
+			data = init_data();
+			load_formula(data, argc[2]);
+			return data;
+		}
+        else if (argv == 3 && !(strcmp(argc[1], "-F")))
+		{
+			data = init_data();
+			load_formula_file(data, argc[2]);
+			return data;
+		}
 		error(ARGS_ERR, NULL);
 	}
 	if ((s_size = (float)strtod(argc[1], NULL)) < 0.00001 || s_size > 1)
@@ -1,4 +1,5 @@
 #include "morphosis.h"
+#include <float.h>
 
 /**
  * @brief Double precision quaternion operations for deep zoom
@@ -33,14 +34,16 @@ cl_quat_d cl_quat_sum_d(cl_quat_d q1, cl_quat_d q2)
  * @brief Deep zoom Julia set sampling with double precision
  * 
  * Uses double precision arithmetic for extreme zoom levels where
- * single precision floating point loses accuracy.
+ * single precision floating point loses accuracy. Interior orbits stop
+ * as soon as Brent's check sees them cycle, as in sample_4D_Julia_optimized().
  */
-float sample_4D_Julia_deep_zoom(t_julia *julia, double3 pos, double zoom_level)
+float sample_4D_Julia_deep_zoom(const t_julia *julia, double3 pos, double zoom_level)
 {
-    cl_quat_d z, c;
-    uint iter;
-    double mag_sq;
+    cl_quat_d z, c, saved;
+    uint iter, period, lam;
+    double mag_sq, dist_sq;
     const double escape_threshold_sq = 4.0;
+    const double cycle_tol_sq = PERIODICITY_TOL_D * PERIODICITY_TOL_D;
     
     // Initialize with high precision
     z.x = pos.x / zoom_level;
@@ -53,6 +56,9 @@ float sample_4D_Julia_deep_zoom(t_julia *julia, double3 pos, double zoom_level)
     c.y = (double)julia->c.y;
     c.z = (double)julia->c.z;
     c.w = (double)julia->c.w;
+    saved = z;
+    period = 1;
+    lam = 0;
     
     for (iter = 0; iter < julia->max_iter; iter++)
     {
@@ -74,6 +80,25 @@ float sample_4D_Julia_deep_zoom(t_julia *julia, double3 pos, double zoom_level)
         mag_sq = (z.x * z.x) + (z.y * z.y) + (z.z * z.z) + (z.w * z.w);
         if (mag_sq > escape_threshold_sq)
             return 0.0f;
+        
+        // Back at the saved point: caught in a cycle, so inside
+        if (fabs(z.x - saved.x) < PERIODICITY_TOL_D)
+        {
+            dist_sq = ((z.x - saved.x) * (z.x - saved.x)) + ((z.y - saved.y) * (z.y - saved.y))
+                + ((z.z - saved.z) * (z.z - saved.z)) + ((z.w - saved.w) * (z.w - saved.w));
+            if (dist_sq < cycle_tol_sq)
+            {
+                if (julia->cycle_skips)
+                    __sync_add_and_fetch(julia->cycle_skips, julia->max_iter - iter - 1);
+                return 1.0f;
+            }
+        }
+        if (++lam == period)
+        {
+            saved = z;
+            period <<= 1;
+            lam = 0;
+        }
     }
     
     return 1.0f;
@@ -85,7 +110,7 @@ float sample_4D_Julia_deep_zoom(t_julia *julia, double3 pos, double zoom_level)
  * Implements 4D Mandelbrot set: z_{n+1} = z_n^2 + c
  * where c is the current position and z starts at origin.
  */
-float sample_4D_Mandelbrot(t_julia *julia, float3 pos)
+float sample_4D_Mandelbrot(const t_julia *julia, float3 pos)
 {
     cl_quat z, c;
     uint iter;
@@ -129,6 +154,122 @@ float sample_4D_Mandelbrot(t_julia *julia, float3 pos)
     return 1.0f;
 }
 
+/**
+ * @brief Hybrid type value at pos from its Julia and Mandelbrot memberships
+ *
+ * Where both sets agree the blend is that value, so the sine weight is
+ * only evaluated on the band where they differ.
+ */
+float hybrid_mix(float julia_val, float mandel_val, float3 pos)
+{
+    float blend;
+
+    if (julia_val == mandel_val)
+        return julia_val;
+    blend = 0.5f + 0.5f * sinf(pos.x + pos.y + pos.z);
+    return julia_val * blend + mandel_val * (1.0f - blend);
+}
+
+/**
+ * @brief z = z^2 + c, as sample_4D_Julia_optimized() and sample_4D_Mandelbrot() step
+ *
+ * @return |z|^2 of the new point
+ */
+static inline float hybrid_step(cl_quat *z, const cl_quat *c)
+{
+    float zx = z->x, zy = z->y, zz = z->z, zw = z->w;
+
+    z->x = (zx * zx) - (zy * zy) - (zz * zz) - (zw * zw);
+    z->y = 2.0f * (zx * zy);
+    z->z = 2.0f * (zx * zz);
+    z->w = 2.0f * (zx * zw);
+    z->x += c->x;
+    z->y += c->y;
+    z->z += c->z;
+    z->w += c->w;
+    return (z->x * z->x) + (z->y * z->y) + (z->z * z->z) + (z->w * z->w);
+}
+
+/**
+ * @brief sample_4D_Julia_optimized()'s cycle check on the Julia orbit
+ *
+ * @return Whether the orbit is caught in a cycle
+ */
+static inline int hybrid_cycled(const t_julia *julia, cl_quat z, uint iter,
+    cl_quat *saved, uint *period, uint *lam)
+{
+    float dist_sq;
+
+    if (fabsf(z.x - saved->x) < PERIODICITY_TOL_F)
+    {
+        dist_sq = ((z.x - saved->x) * (z.x - saved->x)) + ((z.y - saved->y) * (z.y - saved->y))
+            + ((z.z - saved->z) * (z.z - saved->z)) + ((z.w - saved->w) * (z.w - saved->w));
+        if (dist_sq < PERIODICITY_TOL_F * PERIODICITY_TOL_F)
+        {
+            if (julia->cycle_skips)
+                __sync_add_and_fetch(julia->cycle_skips, julia->max_iter - iter - 1);
+            return 1;
+        }
+    }
+    if (++*lam == *period)
+    {
+        *saved = z;
+        *period <<= 1;
+        *lam = 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Julia and Mandelbrot sets blended, both orbits in one loop
+ *
+ * Classifies pos exactly as sample_4D_Julia_optimized() and
+ * sample_4D_Mandelbrot() would. Both orbits advance together until one
+ * is decided, then the other runs on alone.
+ */
+float sample_4D_hybrid(const t_julia *julia, float3 pos)
+{
+    cl_quat j, m, cm, saved;
+    uint iter, period, lam;
+    float julia_val, mandel_val;
+    const float escape_threshold_sq = 4.0f;
+
+    j = (cl_quat){pos.x, pos.y, pos.z, julia->w};
+    orbit_start(julia, pos, 1, 0, &m, &cm);
+    saved = j;
+    period = 1;
+    lam = 0;
+    julia_val = -1.0f;      // -1 until the orbit is decided
+    mandel_val = -1.0f;
+    for (iter = 0; iter < julia->max_iter && julia_val < 0.0f && mandel_val < 0.0f; iter++)
+    {
+        if (hybrid_step(&m, &cm) > escape_threshold_sq)
+            mandel_val = 0.0f;
+        if (hybrid_step(&j, &julia->c) > escape_threshold_sq)
+            julia_val = 0.0f;
+        else if (hybrid_cycled(julia, j, iter, &saved, &period, &lam))
+            julia_val = 1.0f;
+    }
+    for (; iter < julia->max_iter && julia_val < 0.0f; iter++)
+    {
+        if (hybrid_step(&j, &julia->c) > escape_threshold_sq)
+            julia_val = 0.0f;
+        else if (hybrid_cycled(julia, j, iter, &saved, &period, &lam))
+            julia_val = 1.0f;
+    }
+    for (; iter < julia->max_iter && mandel_val < 0.0f; iter++)
+    {
+        if (hybrid_step(&m, &cm) > escape_threshold_sq)
+            mandel_val = 0.0f;
+    }
+    // Still running at max_iter: inside
+    if (julia_val < 0.0f)
+        julia_val = 1.0f;
+    if (mandel_val < 0.0f)
+        mandel_val = 1.0f;
+    return hybrid_mix(julia_val, mandel_val, pos);
+}
+
 /**
  * @brief Alternative quaternion formulas for variety
  * 
@@ -137,8 +278,9 @@ float sample_4D_Mandelbrot(t_julia *julia, float3 pos)
  * 1: z^3 + c (cubic)
  * 2: z^2 + z + c (quadratic with linear term)
  * 3: |z|^2 - z^2 + c (magnitude-based)
+ * FORMULA_POWER on: z^n + c (power family, see quaternion_power())
  */
-float sample_4D_Julia_alternative_formula(t_julia *julia, float3 pos, int formula)
+float sample_4D_Julia_alternative_formula(const t_julia *julia, float3 pos, int formula)
 {
     cl_quat z, c;
     uint iter;
@@ -205,11 +347,8 @@ float sample_4D_Julia_alternative_formula(t_julia *julia, float3 pos, int formul
                 break;
                 
             default:
-                // Fallback to standard formula
-                z_new.x = (zx * zx) - (zy * zy) - (zz * zz) - (zw * zw);
-                z_new.y = 2.0f * (zx * zy);
-                z_new.z = 2.0f * (zx * zz);
-                z_new.w = 2.0f * (zx * zw);
+                // Power family, or fallback to standard formula
+                z_new = formula_step(z, formula);
                 break;
         }
         
@@ -229,109 +368,315 @@ float sample_4D_Julia_alternative_formula(t_julia *julia, float3 pos, int formul
 }
 
 /**
- * @brief Adaptive grid refinement for areas with high detail
+ * @brief One orbit step without the constant: z^2 (Mandelbrot) or a Julia formula
  * 
- * Analyzes local complexity and subdivides grid cells that show
- * high variation in fractal values.
+ * Same arithmetic as sample_4D_Julia_alternative_formula(), so orbits
+ * escape at exactly the same iteration.
  */
-int should_refine_grid_cell(t_data *data, float3 center, float cell_size, int current_depth)
+cl_quat formula_step(cl_quat z, int formula)
 {
-    if (current_depth >= data->max_grid_depth)
-        return 0;
+    float zx = z.x, zy = z.y, zz = z.z, zw = z.w;
+    cl_quat z_new;
     
-    // Sample corners and center of cell
-    float samples[9];
-    float3 offsets[9] = {
-        {-cell_size/2, -cell_size/2, -cell_size/2}, // corners
-        { cell_size/2, -cell_size/2, -cell_size/2},
-        {-cell_size/2,  cell_size/2, -cell_size/2},
-        { cell_size/2,  cell_size/2, -cell_size/2},
-        {-cell_size/2, -cell_size/2,  cell_size/2},
-        { cell_size/2, -cell_size/2,  cell_size/2},
-        {-cell_size/2,  cell_size/2,  cell_size/2},
-        { cell_size/2,  cell_size/2,  cell_size/2},
-        { 0.0f,         0.0f,         0.0f}         // center
-    };
+    if (formula == 1)
+    {
+        cl_quat z2;
+        z2.x = (zx * zx) - (zy * zy) - (zz * zz) - (zw * zw);
+        z2.y = 2.0f * (zx * zy);
+        z2.z = 2.0f * (zx * zz);
+        z2.w = 2.0f * (zx * zw);
+        z_new.x = (zx * z2.x) - (zy * z2.y) - (zz * z2.z) - (zw * z2.w);
+        z_new.y = (zx * z2.y) + (zy * z2.x) + (zz * z2.w) - (zw * z2.z);
+        z_new.z = (zx * z2.z) - (zy * z2.w) + (zz * z2.x) + (zw * z2.y);
+        z_new.w = (zx * z2.w) + (zy * z2.z) - (zz * z2.y) + (zw * z2.x);
+    }
+    else if (formula == 2)
+    {
+        z_new.x = (zx * zx) - (zy * zy) - (zz * zz) - (zw * zw) + zx;
+        z_new.y = 2.0f * (zx * zy) + zy;
+        z_new.z = 2.0f * (zx * zz) + zz;
+        z_new.w = 2.0f * (zx * zw) + zw;
+    }
+    else if (formula == 3)
+    {
+        float mag_sq_z = (zx * zx) + (zy * zy) + (zz * zz) + (zw * zw);
+        z_new.x = mag_sq_z - ((zx * zx) - (zy * zy) - (zz * zz) - (zw * zw));
+        z_new.y = -2.0f * (zx * zy);
+        z_new.z = -2.0f * (zx * zz);
+        z_new.w = -2.0f * (zx * zw);
+    }
+    else if (formula >= FORMULA_POWER && formula < FORMULA_COUNT)
+        z_new = quaternion_power(z, FORMULA_EXPONENT(formula));
+    else
+    {
+        z_new.x = (zx * zx) - (zy * zy) - (zz * zz) - (zw * zw);
+        z_new.y = 2.0f * (zx * zy);
+        z_new.z = 2.0f * (zx * zz);
+        z_new.w = 2.0f * (zx * zw);
+    }
+    return z_new;
+}
+
+/**
+ * @brief z^n in closed form, for n from 1 to FORMULA_POWER_MAX
+ * 
+ * Write z = a + v with v imaginary. Every power of z stays in the plane
+ * of 1 and v, and z^n = A + S v where A + i S |v| = (a + i |v|)^n. A and
+ * S are polynomials in a and q = |v|^2, so (A, S) follows from the bits
+ * of n by squaring and multiplying by (a, 1):
+ * 
+ *     (A, S)^2      = (A^2 - q S^2, 2 A S)
+ *     (A, S) (a, 1) = (A a - q S, A + a S)
+ * 
+ * z^8 takes three squarings of that pair, where repeated quaternion
+ * products would take seven, and no square root or division.
+ */
+cl_quat quaternion_power(cl_quat z, int n)
+{
+    float q = (z.y * z.y) + (z.z * z.z) + (z.w * z.w);
+    float a = z.x, s = 1.0f, t;
     
-    // Sample fractal at each point
-    for (int i = 0; i < 9; i++)
+    for (int bit = POWER_TOP_BIT(n) - 1; bit >= 0; bit--)
     {
-        float3 sample_pos = {
-            center.x + offsets[i].x,
-            center.y + offsets[i].y,
-            center.z + offsets[i].z
-        };
-        
-        switch (data->fractal_type)
+        t = (a * a) - (q * (s * s));
+        s = 2.0f * (a * s);
+        a = t;
+        if ((n >> bit) & 1)
         {
-            case 0: // Julia set
-                if (data->use_double_precision && data->zoom_level > 1000.0)
-                {
-                    double3 pos_d = {sample_pos.x, sample_pos.y, sample_pos.z};
-                    samples[i] = sample_4D_Julia_deep_zoom(data->fract->julia, pos_d, data->zoom_level);
-                }
-                else if (data->quaternion_formula != 0)
-                {
-                    samples[i] = sample_4D_Julia_alternative_formula(data->fract->julia, sample_pos, data->quaternion_formula);
-                }
-                else
-                {
-                    samples[i] = sample_4D_Julia_optimized(data->fract->julia, sample_pos);
-                }
-                break;
-                
-            case 1: // Mandelbrot set
-                samples[i] = sample_4D_Mandelbrot(data->fract->julia, sample_pos);
-                break;
-                
-            default:
-                samples[i] = sample_4D_Julia_optimized(data->fract->julia, sample_pos);
-                break;
+            t = (a * z.x) - (q * s);
+            s = a + (z.x * s);
+            a = t;
         }
     }
+    return (cl_quat){a, s * z.y, s * z.z, s * z.w};
+}
+
+/**
+ * @brief Degree of a Julia formula's polynomial: how fast escaping orbits grow
+ */
+int formula_degree(int formula)
+{
+    if (formula >= FORMULA_POWER && formula < FORMULA_COUNT)
+        return FORMULA_EXPONENT(formula);
+    return formula == 1 ? 3 : 2;
+}
+
+/**
+ * @brief Display name of a quaternion formula
+ */
+const char *quaternion_formula_name(int formula)
+{
+    static const char *names[FORMULA_COUNT] = {
+        "Standard z²+c", "Cubic z³+c", "z²+z+c", "|z|²-z²+c",
+        "Power z²+c", "Power z³+c", "Power z⁴+c", "Power z⁵+c",
+        "Power z⁶+c", "Power z⁷+c", "Power z⁸+c"
+    };
     
-    // Calculate variation (standard deviation)
-    float mean = 0.0f;
-    for (int i = 0; i < 9; i++)
-        mean += samples[i];
-    mean /= 9.0f;
+    if (formula == FORMULA_CUSTOM)
+        return "Custom";
+    if (formula < 0 || formula >= FORMULA_COUNT)
+        return "unknown";
+    return names[formula];
+}
+
+/**
+ * @brief Starting orbit of the Julia formulas or of the 4D Mandelbrot set
+ * 
+ * Matches sample_4D_Julia_optimized() / sample_4D_Mandelbrot(), and
+ * returns the escape radius of the matching membership sampler.
+ */
+float orbit_start(const t_julia *julia, float3 pos, int mandelbrot, int formula, cl_quat *z, cl_quat *c)
+{
+    if (mandelbrot)
+    {
+        c->x = pos.x;
+        c->y = pos.y;
+        c->z = pos.z;
+        c->w = julia->w;
+        z->x = julia->c.x * 0.1f;
+        z->y = julia->c.y * 0.1f;
+        z->z = julia->c.z * 0.1f;
+        z->w = julia->c.w * 0.1f;
+        return 2.0f;
+    }
+    z->x = pos.x;
+    z->y = pos.y;
+    z->z = pos.z;
+    z->w = julia->w;
+    *c = julia->c;
+    return formula != 0 ? 4.0f : 2.0f;
+}
+
+/**
+ * @brief Signed distance estimate to the surface the membership samplers draw
+ * 
+ * Runs the same orbit as sample_4D_Julia_optimized(), sample_4D_Mandelbrot()
+ * or sample_4D_Julia_alternative_formula() while tracking a bound on the
+ * derivative |dz/dpos|. The rendered set is {pos : |z_k| <= R for every
+ * k <= max_iter}, so its surface is made of the level sets |z_k| = R and
+ * (R - |z_k|) / |dz_k| estimates the distance to each of them:
+ * - escaped at step k: -(|z_k| - R) / |dz_k|, negative outside
+ * - never escaped: the smallest (R - |z_k|) / |dz_k|, positive inside
+ * 
+ * The sign always agrees with the membership samplers, so the surface
+ * topology is unchanged; interpolating at 0 along a cube edge lands the
+ * vertex on the surface itself instead of on a corner of the cube.
+ * 
+ * @param mandelbrot Iterate z^2 + pos (Mandelbrot) instead of a Julia formula
+ * @param formula Julia formula, as for sample_4D_Julia_alternative_formula()
+ * @return Distance estimate in sample space, > 0 inside the set
+ */
+float sample_4D_distance(const t_julia *julia, float3 pos, int mandelbrot, int formula)
+{
+    cl_quat z, c, z_new;
+    uint iter;
+    float mag_sq, mag, dz, d, inside, radius;
     
-    float variance = 0.0f;
-    for (int i = 0; i < 9; i++)
+    radius = orbit_start(julia, pos, mandelbrot, formula, &z, &c);
+    if (mandelbrot)
+        formula = 0;
+    dz = mandelbrot ? 0.0f : 1.0f; // Mandelbrot's z_0 does not depend on pos
+    inside = FLT_MAX;
+    for (iter = 0; iter < julia->max_iter; iter++)
     {
-        float diff = samples[i] - mean;
-        variance += diff * diff;
+        // Chain rule on |z|, bounded for the non-holomorphic formulas
+        mag = sqrtf((z.x * z.x) + (z.y * z.y) + (z.z * z.z) + (z.w * z.w));
+        if (formula == 1)
+            dz = 3.0f * mag * mag * dz;
+        else if (formula == 2)
+            dz = (2.0f * mag + 1.0f) * dz;
+        else if (formula == 3)
+            dz = 4.0f * mag * dz;
+        else if (formula >= FORMULA_POWER)
+            dz = (float)formula_degree(formula) * powf(mag, (float)(formula_degree(formula) - 1)) * dz;
+        else
+            dz = 2.0f * mag * dz + (mandelbrot ? 1.0f : 0.0f);
+        
+        z_new = formula_step(z, formula);
+        z.x = z_new.x + c.x;
+        z.y = z_new.y + c.y;
+        z.z = z_new.z + c.z;
+        z.w = z_new.w + c.w;
+        
+        // Same escape test as the membership samplers, so the sign matches
+        mag_sq = (z.x * z.x) + (z.y * z.y) + (z.z * z.z) + (z.w * z.w);
+        mag = sqrtf(mag_sq);
+        if (mag_sq > radius * radius)
+            return -fmaxf(mag - radius, 0.0f) / fmaxf(dz, FLT_MIN);
+        d = (radius - mag) / fmaxf(dz, FLT_MIN);
+        if (d < inside)
+            inside = d;
     }
-    variance /= 9.0f;
+    return inside;
+}
+
+/**
+ * @brief Smooth escape time, normalised to max_iter
+ * 
+ * An orbit escaping at step k (k = 1 for the first step) scores the
+ * normalised iteration count k - log_p(log|z_k| / log R), where p is the
+ * degree of the formula, divided by max_iter: continuous across escape
+ * steps and in (0, 1] for every escaping point. Points that never escape
+ * score (max_iter + 1) / max_iter, so the shell at level 1 is exactly the
+ * membership surface and lower levels are the sets that survive fewer
+ * iterations.
+ * 
+ * @param mandelbrot Iterate z^2 + pos (Mandelbrot) instead of a Julia formula
+ * @param formula Julia formula, as for sample_4D_Julia_alternative_formula()
+ * @return Normalised escape time, > 1 inside the set
+ */
+float sample_4D_escape_time(const t_julia *julia, float3 pos, int mandelbrot, int formula)
+{
+    cl_quat z, c, z_new;
+    uint iter;
+    float mag_sq, radius;
     
-    float std_dev = sqrtf(variance);
+    radius = orbit_start(julia, pos, mandelbrot, formula, &z, &c);
+    if (mandelbrot)
+        formula = 0;
+    for (iter = 0; iter < julia->max_iter; iter++)
+    {
+        z_new = formula_step(z, formula);
+        z.x = z_new.x + c.x;
+        z.y = z_new.y + c.y;
+        z.z = z_new.z + c.z;
+        z.w = z_new.w + c.w;
+        mag_sq = (z.x * z.x) + (z.y * z.y) + (z.z * z.z) + (z.w * z.w);
+        if (mag_sq > radius * radius)
+            return escape_time_value(iter + 1, mag_sq, radius, formula, julia->max_iter);
+    }
+    return (float)(julia->max_iter + 1) / (float)julia->max_iter;
+}
+
+/**
+ * @brief Normalised escape time of an orbit that escaped at a given step
+ * 
+ * @param step Step the orbit escaped at, 1 for the first
+ * @param mag_sq |z|^2 right after escaping
+ */
+float escape_time_value(uint step, float mag_sq, float radius, int formula, uint max_iter)
+{
+    float fraction;
     
-    // Refine if variation exceeds threshold
-    return std_dev > data->detail_threshold;
+    // How far past the radius the orbit landed: 0 just past it, 1 a full step
+    fraction = logf(logf(mag_sq) / (2.0f * logf(radius))) / logf((float)formula_degree(formula));
+    fraction = fminf(fmaxf(fraction, 0.0f), 1.0f);
+    return ((float)step - fraction) / (float)max_iter;
 }
 
 /**
- * @brief Supersampling for anti-aliasing
+ * @brief Sample the configured fractal at a single point, no supersampling
  * 
- * Takes multiple samples per grid point and averages them
- * to reduce aliasing artifacts.
+ * Goes through the kernel init_sampler() resolved for this build, so
+ * the configuration is not re-examined per sample.
  */
-float sample_with_supersampling(t_data *data, float3 pos)
+static float sample_fractal_point(const t_sampler *s, float3 pos)
 {
-    if (data->supersampling <= 1)
+    // Deep-zoom kernels divide by the zoom level in their own precision
+    if (s->deep_zoom)
+        return s->point_kernel(s, pos);
+    
+    // Apply zoom level to position coordinates for all other sampling methods
+    float3 zoomed_pos = pos;
+    if (s->zoom_level > 1.0)
     {
-        // No supersampling - temporarily disable supersampling and call main function
-        int original_supersampling = data->supersampling;
-        data->supersampling = 1;
-        float result = sample_fractal_enhanced(data, pos);
-        data->supersampling = original_supersampling;
-        return result;
+        zoomed_pos.x = pos.x / (float)s->zoom_level;
+        zoomed_pos.y = pos.y / (float)s->zoom_level;
+        zoomed_pos.z = pos.z / (float)s->zoom_level;
     }
+    return s->point_kernel(s, zoomed_pos);
+}
+
+/**
+ * @brief Offset of sub-sample k of samples along one axis
+ * 
+ * Sub-samples sit at the centres of a samples^3 split of the point's
+ * box, one step wide, so the boxes of neighbouring points tile space
+ * and all their sub-samples fall on one lattice step / samples apart.
+ * With an odd count the middle one is the point itself.
+ */
+float supersample_offset(uint k, uint samples, float step)
+{
+    return (((float)k + 0.5f) / (float)samples - 0.5f) * step;
+}
+
+/**
+ * @brief Supersampling for anti-aliasing
+ * 
+ * Box-filters the point's step-wide box with samples^3 sub-samples into
+ * the fraction of it inside the set. The point itself, when it is one of
+ * them, is added first: supersample_lattice_boundary() sums in this same
+ * order from the lattice value, so both give identical results.
+ */
+float sample_with_supersampling(const t_sampler *s, float3 pos)
+{
+    if (s->supersampling <= 1)
+        return sample_fractal_point(s, pos);
     
     // Supersampling enabled
-    float total = 0.0f;
-    int samples = data->supersampling;
-    float offset = data->fract->step_size / (float)(samples * 2);
+    int samples = s->supersampling;
+    int center = (samples % 2) ? samples / 2 : -1;
+    float total = (center >= 0) ? sample_fractal_point(s, pos) : 0.0f;
     
     for (int x = 0; x < samples; x++)
     {
@@ -339,19 +684,15 @@ float sample_with_supersampling(t_data *data, float3 pos)
         {
             for (int z = 0; z < samples; z++)
             {
+                if (x == center && y == center && z == center)
+                    continue;
                 float3 sample_pos = {
-                    pos.x + (x - samples/2) * offset,
-                    pos.y + (y - samples/2) * offset,
-                    pos.z + (z - samples/2) * offset
+                    pos.x + supersample_offset(x, samples, s->step_size),
+                    pos.y + supersample_offset(y, samples, s->step_size),
+                    pos.z + supersample_offset(z, samples, s->step_size)
                 };
                 
-                // Temporarily disable supersampling and call main function
-                int original_supersampling = data->supersampling;
-                data->supersampling = 1;
-                float sample_value = sample_fractal_enhanced(data, sample_pos);
-                data->supersampling = original_supersampling;
-                
-                total += sample_value;
+                total += sample_fractal_point(s, sample_pos);
             }
         }
     }
@@ -368,55 +709,187 @@ float sample_with_supersampling(t_data *data, float3 pos)
  * - Different quaternion formulas
  * - Supersampling anti-aliasing
  * - Adaptive sampling
+ * 
+ * Only reads s, so build workers may call it concurrently.
  */
-float sample_fractal_enhanced(t_data *data, float3 pos)
+float sample_fractal_enhanced(const t_sampler *s, float3 pos)
 {
     // Use supersampling if enabled
-    if (data->supersampling > 1)
+    if (s->supersampling > 1)
+    {
+        return sample_with_supersampling(s, pos);
+    }
+    return sample_fractal_point(s, pos);
+}
+
+/**
+ * @brief Whether sample_fractal_enhanced() only ever returns 0.0f or 1.0f
+ * 
+ * Supersampling averages sub-samples, the hybrid type blends two sets and
+ * distance and escape-time fields are continuous; every other path is a
+ * membership test.
+ */
+int field_is_binary(t_data *data)
+{
+    return data->supersampling <= 1 && data->fractal_type != 2 &&
+        sampled_field_kind(data) == FIELD_MEMBERSHIP;
+}
+
+/**
+ * @brief The FIELD_* the samplers will actually return for data->field_mode
+ * 
+ * The hybrid blend has no single orbit to differentiate or time, the
+ * float orbit is meaningless at deep zoom, and a custom formula has no
+ * known derivative or degree; all keep sampling membership whatever
+ * field_mode asks for.
+ */
+int sampled_field_kind(t_data *data)
+{
+    if (data->fractal_type == 2 || deep_zoom_precision(data) != DEEP_ZOOM_OFF
+        || (data->fractal_type == 0 && data->quaternion_formula == FORMULA_CUSTOM))
+        return FIELD_MEMBERSHIP;
+    return data->field_mode;
+}
+
+/**
+ * @brief Precision the Julia set is sampled in at data's zoom level (DEEP_ZOOM_*)
+ * 
+ * Perturbation past DEEP_ZOOM_DOUBLE_MIN while it is on. Otherwise
+ * double when double precision is on past DEEP_ZOOM_DOUBLE_MIN, and
+ * double-double past DEEP_ZOOM_DD_MIN whatever the setting, since no
+ * narrower type tells neighbouring points apart there. The deep-zoom
+ * kernels only iterate z^2 + c, so every other formula stays in float.
+ */
+int deep_zoom_precision(t_data *data)
+{
+    if (data->fractal_type != 0 || data->quaternion_formula != 0)
+        return DEEP_ZOOM_OFF;
+    if (data->perturbation && data->zoom_level > DEEP_ZOOM_DOUBLE_MIN)
+        return DEEP_ZOOM_PERTURBATION;
+    if (data->zoom_level > DEEP_ZOOM_DD_MIN)
+        return DEEP_ZOOM_DOUBLE_DOUBLE;
+    if (data->use_double_precision && data->zoom_level > DEEP_ZOOM_DOUBLE_MIN)
+        return DEEP_ZOOM_DOUBLE;
+    return DEEP_ZOOM_OFF;
+}
+
+/**
+ * @brief Deepest zoom data's fractal can be sampled at
+ * 
+ * DEEP_ZOOM_MAX where deep_zoom_precision() can leave float, the float
+ * limit FLOAT_ZOOM_MAX everywhere else.
+ */
+double max_zoom_level(t_data *data)
+{
+    if (data->fractal_type != 0 || data->quaternion_formula != 0)
+        return FLOAT_ZOOM_MAX;
+    return DEEP_ZOOM_MAX;
+}
+
+/**
+ * @brief Number of surfaces a build extracts from its field
+ * 
+ * One per iso level for escape-time fields on the lattice; the legacy
+ * per-cube build only extracts the first.
+ */
+uint shell_count(t_data *data)
+{
+    if (data->field_kind != FIELD_ESCAPE_TIME || !data->shared_lattice)
+        return 1;
+    if (data->num_iso_levels > MAX_ISO_SHELLS)
+        return MAX_ISO_SHELLS;
+    return data->num_iso_levels ? data->num_iso_levels : 1;
+}
+
+/**
+ * @brief Point the meshers at one surface of the field
+ * 
+ * Membership fields keep their historical convention (inside is != 0,
+ * vertices at 1) unless supersampled into coverage, which crosses at one
+ * half; distance fields cross at 0 and escape-time shells at their iso
+ * level.
+ */
+void select_shell(t_data *data, uint shell)
+{
+    if (data->field_kind == FIELD_ESCAPE_TIME)
     {
-        return sample_with_supersampling(data, pos);
+        data->inside_level = data->num_iso_levels ? data->iso_levels[shell] : 1.0f;
+        data->surface_level = data->inside_level;
     }
+    else if (data->field_kind == FIELD_MEMBERSHIP && data->supersampling > 1)
+    {
+        data->inside_level = 0.5f;
+        data->surface_level = 0.5f;
+    }
+    else
+    {
+        data->inside_level = 0.0f;
+        data->surface_level = data->field_kind == FIELD_DISTANCE ? 0.0f : 1.0f;
+    }
+}
+
+/**
+ * @brief Batched counterpart of sample_fractal_enhanced()
+ * 
+ * Samples n points given as SoA coordinates through the SIMD kernels
+ * of s->batch_kind at s->simd_level, or through s->point_kernel on the
+ * scalar level. Configurations the batch kernels do not cover
+ * (BATCH_NONE: supersampling, double-precision deep zoom, distance and
+ * escape-time fields) fall back to the scalar sampler point by point, so
+ * results always match it. Double-double deep zoom has its own batch
+ * path, fed the unzoomed positions. The custom formula's interpreter
+ * takes whole chunks at every level.
+ */
+void sample_fractal_batch(const t_sampler *s, const float *x, const float *y, const float *z, float *out, uint n)
+{
+    float zx[SAMPLE_BATCH_CHUNK], zy[SAMPLE_BATCH_CHUNK], zz[SAMPLE_BATCH_CHUNK];
+    const t_julia *julia = &s->julia;
     
-    // Apply zoom level to position coordinates for all sampling methods
-    float3 zoomed_pos = pos;
-    if (data->zoom_level > 1.0)
+    if (s->batch_kind == BATCH_NONE)
     {
-        zoomed_pos.x = pos.x / (float)data->zoom_level;
-        zoomed_pos.y = pos.y / (float)data->zoom_level;
-        zoomed_pos.z = pos.z / (float)data->zoom_level;
+        for (uint i = 0; i < n; i++)
+            out[i] = sample_fractal_enhanced(s, (float3){x[i], y[i], z[i]});
+        return;
+    }
+    if (s->batch_kind == BATCH_DOUBLE_DOUBLE)
+    {
+        sample_batch_double_double(s->simd_level, julia, s->zoom_level, x, y, z, out, n);
+        return;
+    }
+    if (s->batch_kind == BATCH_PERTURBATION)
+    {
+        sample_batch_perturbation(s, x, y, z, out, n);
+        return;
     }
     
-    // Direct sampling based on fractal type and precision
-    switch (data->fractal_type)
+    for (uint base = 0; base < n; base += SAMPLE_BATCH_CHUNK)
     {
-        case 0: // Julia set
-            if (data->use_double_precision && data->zoom_level > 1000.0)
-            {
-                double3 pos_d = {zoomed_pos.x, zoomed_pos.y, zoomed_pos.z};
-                return sample_4D_Julia_deep_zoom(data->fract->julia, pos_d, data->zoom_level);
-            }
-            else if (data->quaternion_formula != 0)
-            {
-                return sample_4D_Julia_alternative_formula(data->fract->julia, zoomed_pos, data->quaternion_formula);
-            }
-            else
-            {
-                return sample_4D_Julia_optimized(data->fract->julia, zoomed_pos);
-            }
-            
-        case 1: // Mandelbrot set
-            return sample_4D_Mandelbrot(data->fract->julia, zoomed_pos);
-            
-        case 2: // Hybrid (future enhancement)
-            // Combine Julia and Mandelbrot based on position
+        uint count = (n - base < SAMPLE_BATCH_CHUNK) ? n - base : SAMPLE_BATCH_CHUNK;
+        
+        // Apply zoom level exactly as sample_fractal_point() does
+        for (uint i = 0; i < count; i++)
+        {
+            zx[i] = x[base + i];
+            zy[i] = y[base + i];
+            zz[i] = z[base + i];
+            if (s->zoom_level > 1.0)
             {
-                float julia_val = sample_4D_Julia_optimized(data->fract->julia, zoomed_pos);
-                float mandel_val = sample_4D_Mandelbrot(data->fract->julia, zoomed_pos);
-                float blend = 0.5f + 0.5f * sinf(zoomed_pos.x + zoomed_pos.y + zoomed_pos.z);
-                return julia_val * blend + mandel_val * (1.0f - blend);
+                zx[i] = zx[i] / (float)s->zoom_level;
+                zy[i] = zy[i] / (float)s->zoom_level;
+                zz[i] = zz[i] / (float)s->zoom_level;
             }
-            
-        default:
-            return sample_4D_Julia_optimized(data->fract->julia, zoomed_pos);
+        }
+        
+        if (s->batch_kind == BATCH_CUSTOM)
+            run_formula(s->simd_level, s->program, julia, zx, zy, zz, out + base, count);
+        else if (s->simd_level == SIMD_SCALAR)
+        {
+            for (uint i = 0; i < count; i++)
+                out[base + i] = s->point_kernel(s, (float3){zx[i], zy[i], zz[i]});
+        }
+        else if (s->batch_kind == BATCH_HYBRID)
+            sample_batch_hybrid(s->simd_level, julia, zx, zy, zz, out + base, count);
+        else
+            sample_batch(s->simd_level, s->batch_kind, julia, zx, zy, zz, out + base, count);
     }
 }
@@ -141,28 +141,10 @@ static int					bin_to_dec(char *bin)
 	return(res);
 }
 
-void						fill_matrix(int **matrix, int number, int reset)
+// Stores the index-th number (0 to 35) of a 6x6 block, six per row
+void						fill_matrix(int **matrix, int number, int index)
 {
-	static int				row = 0;
-	static int				col = 0;
-
-	if (row < 6 && col < 6)
-	{
-		matrix[col][row] = number;
-		row++;
-	}
-	else if (row == 6 && col < 6)
-	{
-		row = 0;
-		col++;
-		matrix[col][row] = number;
-		row++;
-	}
-	if (reset == 35)
-	{
-		row = 0;
-		col = 0;
-	}
+	matrix[index / 6][index % 6] = number;
 }
 
 static int					***parse_data(int fd, char *line)
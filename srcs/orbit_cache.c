@@ -0,0 +1,198 @@
+#include "morphosis.h"
+
+/*
+** Orbit state cache.
+**
+** Keeps, for every lattice point, the orbit value z and how many steps
+** it has been advanced (or the step it escaped at). Stepping max_iter up
+** then only advances the orbits still inside, from where they stopped;
+** stepping it down reclassifies every point from its stored escape step
+** without iterating at all. Each point's state is self-consistent on its
+** own, so a build cancelled halfway leaves a cache that is still valid.
+*/
+
+static t_orbit_key			orbit_key(t_data *data)
+{
+	t_orbit_key				key;
+	const t_sampler			*s;
+
+	// Zeroed first so padding compares equal too
+	memset(&key, 0, sizeof(key));
+	s = &data->sampler;
+	key.c = s->julia.c;
+	key.w = s->julia.w;
+	key.fractal_type = s->fractal_type;
+	key.formula = s->fractal_type == 1 ? 0 : s->formula;
+	key.zoom_level = s->zoom_level;
+	key.p0 = data->fract->p0;
+	key.step_size = data->fract->step_size;
+	key.dim = data->lattice_dim;
+	return key;
+}
+
+/**
+ * @brief Whether this build's samples can come from the orbit cache
+ *
+ * Covers the samplers that are a plain function of one orbit: membership
+ * and escape time for Julia and Mandelbrot sets on a full lattice. The
+ * custom formula is left to its interpreter.
+ */
+static int					orbit_cache_usable(t_data *data)
+{
+	const t_sampler			*s;
+	size_t					points;
+
+	s = &data->sampler;
+	if (!data->orbit_cache || !data->shared_lattice || data->streaming_build)
+		return 0;
+	if (s->supersampling > 1 || s->fractal_type == 2 || s->field_kind == FIELD_DISTANCE || s->deep_zoom)
+		return 0;
+	if (s->fractal_type == 0 && s->formula == FORMULA_CUSTOM)
+		return 0;
+	points = (size_t)data->lattice_dim * data->lattice_dim * data->lattice_dim;
+	return points * (sizeof(cl_quat) + sizeof(uint)) <= ORBIT_CACHE_MAX_BYTES;
+}
+
+void						free_orbit_cache(t_orbit_cache *cache)
+{
+	free(cache->z);
+	free(cache->state);
+	memset(cache, 0, sizeof(t_orbit_cache));
+}
+
+/**
+ * @brief Get data->orbits ready for this build
+ *
+ * Orbits computed under other parameters are reset to step 0; the cache
+ * is released when this build cannot use it.
+ *
+ * @return Whether pass 1 should sample through sample_orbit_cache()
+ */
+int							prepare_orbit_cache(t_data *data)
+{
+	t_orbit_cache			*cache;
+	t_orbit_key				key;
+	size_t					points;
+
+	cache = &data->orbits;
+	if (!orbit_cache_usable(data))
+	{
+		free_orbit_cache(cache);
+		return 0;
+	}
+	key = orbit_key(data);
+	if (cache->valid && memcmp(&key, &cache->key, sizeof(key)) == 0)
+	{
+		printf("\x1b[36m[%s]\x1b[0m Resuming cached orbits\n", __FILE__);
+		return 1;
+	}
+	points = (size_t)key.dim * key.dim * key.dim;
+	if (cache->points != points)
+	{
+		free_orbit_cache(cache);
+		cache->z = (cl_quat *)malloc(points * sizeof(cl_quat));
+		cache->state = (uint *)malloc(points * sizeof(uint));
+		if (!cache->z || !cache->state)
+		{
+			printf("\x1b[33m[%s]\x1b[0m No memory for the orbit cache, sampling from scratch\n", __FILE__);
+			free_orbit_cache(cache);
+			return 0;
+		}
+		cache->points = points;
+	}
+
+	// Step 0: z is rebuilt from the position when the orbit first runs
+	memset(cache->state, 0, points * sizeof(uint));
+	cache->key = key;
+	cache->valid = 1;
+	return 1;
+}
+
+/**
+ * @brief Cached counterpart of sample_fractal_batch() for n lattice points
+ *
+ * Values match sample_fractal_enhanced() on data->sampler for the
+ * configurations prepare_orbit_cache() accepts. Workers may call it
+ * concurrently on disjoint points.
+ *
+ * @param first Lattice index of the first point; the others follow in x
+ */
+void						sample_orbit_cache(t_data *data, size_t first, const float *x, const float *y,
+								const float *z, float *out, uint n)
+{
+	const t_sampler			*s;
+	const t_julia			*julia;
+	t_orbit_cache			*cache;
+	cl_quat					q;
+	cl_quat					c;
+	cl_quat					q_new;
+	float3					pos;
+	float					radius;
+	float					mag_sq;
+	float					inside;
+	uint					state;
+	uint					step;
+	int						mandelbrot;
+	int						formula;
+
+	s = &data->sampler;
+	julia = &s->julia;
+	cache = &data->orbits;
+	mandelbrot = s->fractal_type == 1;
+	formula = mandelbrot ? 0 : s->formula;
+	inside = s->field_kind == FIELD_ESCAPE_TIME ?
+		(float)(julia->max_iter + 1) / (float)julia->max_iter : 1.0f;
+	for (uint i = 0; i < n; i++)
+	{
+		// Zoomed exactly as sample_fractal_point() does
+		pos = (float3){x[i], y[i], z[i]};
+		if (s->zoom_level > 1.0)
+		{
+			pos.x = pos.x / (float)s->zoom_level;
+			pos.y = pos.y / (float)s->zoom_level;
+			pos.z = pos.z / (float)s->zoom_level;
+		}
+		radius = orbit_start(julia, pos, mandelbrot, formula, &q, &c);
+		state = cache->state[first + i];
+
+		// Escaped before: inside iff that step is now past max_iter
+		if (state & ORBIT_ESCAPED)
+		{
+			step = state & ~ORBIT_ESCAPED;
+			q = cache->z[first + i];
+			mag_sq = (q.x * q.x) + (q.y * q.y) + (q.z * q.z) + (q.w * q.w);
+			if (step > julia->max_iter)
+				out[i] = inside;
+			else if (s->field_kind == FIELD_ESCAPE_TIME)
+				out[i] = escape_time_value(step, mag_sq, radius, formula, julia->max_iter);
+			else
+				out[i] = 0.0f;
+			continue;
+		}
+
+		// Still bounded: run only the steps not taken yet
+		if (state > 0)
+			q = cache->z[first + i];
+		out[i] = inside;
+		for (step = state; step < julia->max_iter; step++)
+		{
+			q_new = formula_step(q, formula);
+			q.x = q_new.x + c.x;
+			q.y = q_new.y + c.y;
+			q.z = q_new.z + c.z;
+			q.w = q_new.w + c.w;
+			mag_sq = (q.x * q.x) + (q.y * q.y) + (q.z * q.z) + (q.w * q.w);
+			if (mag_sq > radius * radius)
+			{
+				state = (step + 1) | ORBIT_ESCAPED;
+				out[i] = s->field_kind == FIELD_ESCAPE_TIME ?
+					escape_time_value(step + 1, mag_sq, radius, formula, julia->max_iter) : 0.0f;
+				break;
+			}
+		}
+		if (!(state & ORBIT_ESCAPED) && state < julia->max_iter)
+			state = julia->max_iter;
+		cache->z[first + i] = q;
+		cache->state[first + i] = state;
+	}
+}
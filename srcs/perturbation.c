@@ -0,0 +1,324 @@
+#include "morphosis.h"
+
+/*
+** Perturbation deep zoom.
+**
+** One reference orbit Z_n, from the zoom centre, is iterated in
+** double-double once per build. Every lattice point then follows only
+** its offset d_n = z_n - Z_n from it, in float. For z^2 + c the offset
+** obeys
+**
+**     d' = Z d + d Z + d^2
+**
+** where Z d + d Z = 2 (Z.x d.x - Z.v . d.v, Z.x d.v + d.x Z.v) for
+** quaternions, since the cross products cancel. c drops out, and d
+** stays small, so float keeps its relative precision however deep the
+** zoom goes.
+**
+** A point whose orbit passes closer to 0 than to the reference has lost
+** that precision: the offset is as large as the point itself (a glitch).
+** Such a point, and any that outlives an escaping reference, is rebased.
+** Its full value becomes the new offset from Z_0, and it carries on
+** along the reference from the start. Points with the same c run the
+** same map, so any point of the orbit can serve as a start.
+**
+** Far enough in, d^2 underflows float and every product of it turns
+** denormal, which costs x86 a microcode assist per operation, several
+** times the whole step. It is far below d's own rounding there, so the
+** kernels flush denormals to zero while they run.
+**
+** includes/pert_kernels.h holds the vector kernel, instantiated below
+** for AVX2 and AVX-512, which gather each lane's reference point.
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+# define PERT_X86 1
+# include <immintrin.h>
+#else
+# define PERT_X86 0
+#endif
+
+/* Keep the vector kernels rounding exactly like the scalar one */
+#if defined(__GNUC__) && !defined(__clang__)
+# define PK_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+# define PK_NO_CONTRACT
+#endif
+
+/**
+ * @brief Compute data->sampler's reference orbit for this build
+ *
+ * From the zoom centre, the origin of the unzoomed lattice, up to the
+ * sampler's max_iter. The orbit lives in data->reference_orbit.
+ */
+void						prepare_reference_orbit(t_data *data)
+{
+	t_sampler				*s;
+	cl_quat					*orbit;
+	uint					need;
+
+	s = &data->sampler;
+	need = s->julia.max_iter + 1;
+	if (data->reference_capacity < need)
+	{
+		orbit = (cl_quat *)realloc(data->reference_orbit, need * sizeof(cl_quat));
+		if (!orbit)
+			error(MALLOC_FAIL_ERR, data);
+		data->reference_orbit = orbit;
+		data->reference_capacity = need;
+	}
+	s->reference_len = double_double_orbit(&s->julia, (double3){0.0, 0.0, 0.0},
+		s->zoom_level, data->reference_orbit);
+	s->reference = data->reference_orbit;
+}
+
+/* Flush-to-zero and denormals-are-zero on, returning the old state */
+static inline uint			flush_denormals(void)
+{
+#if PERT_X86
+	uint					csr;
+
+	csr = _mm_getcsr();
+	_mm_setcsr(csr | 0x8040);
+	return csr;
+#else
+	return 0;
+#endif
+}
+
+static inline void			restore_denormals(uint csr)
+{
+#if PERT_X86
+	_mm_setcsr(csr);
+#else
+	(void)csr;
+#endif
+}
+
+/* Offset of the unzoomed position pos from the reference's start */
+static inline void			start_offset(const t_sampler *s, float3 pos, float *d)
+{
+	d[0] = (float)((double)pos.x / s->zoom_level - (double)s->reference[0].x);
+	d[1] = (float)((double)pos.y / s->zoom_level - (double)s->reference[0].y);
+	d[2] = (float)((double)pos.z / s->zoom_level - (double)s->reference[0].z);
+}
+
+PK_NO_CONTRACT static float	perturbation_orbit(const t_sampler *s, const float *start)
+{
+	const cl_quat			*ref;
+	cl_quat					d;
+	cl_quat					n;
+	cl_quat					z;
+	float					mag_sq;
+	uint					m;
+
+	ref = s->reference;
+	d = (cl_quat){start[0], start[1], start[2], 0.0f};
+	m = 0;
+	for (uint iter = 0; iter < s->julia.max_iter; iter++)
+	{
+		// d' = Z d + d Z + d^2
+		n.x = 2.0f * ((ref[m].x * d.x) - (ref[m].y * d.y) - (ref[m].z * d.z) - (ref[m].w * d.w))
+			+ ((d.x * d.x) - (d.y * d.y) - (d.z * d.z) - (d.w * d.w));
+		n.y = 2.0f * ((ref[m].x * d.y) + (d.x * ref[m].y) + (d.x * d.y));
+		n.z = 2.0f * ((ref[m].x * d.z) + (d.x * ref[m].z) + (d.x * d.z));
+		n.w = 2.0f * ((ref[m].x * d.w) + (d.x * ref[m].w) + (d.x * d.w));
+		d = n;
+		m++;
+		z = (cl_quat){ref[m].x + d.x, ref[m].y + d.y, ref[m].z + d.z, ref[m].w + d.w};
+		mag_sq = (z.x * z.x) + (z.y * z.y) + (z.z * z.z) + (z.w * z.w);
+		if (mag_sq > 4.0f)
+			return 0.0f;
+
+		// Glitched, or past the end of the reference: rebase onto Z_0
+		if (m == s->reference_len
+			|| (d.x * d.x) + (d.y * d.y) + (d.z * d.z) + (d.w * d.w) > mag_sq)
+		{
+			d = (cl_quat){z.x - ref[0].x, z.y - ref[0].y, z.z - ref[0].z, z.w - ref[0].w};
+			m = 0;
+		}
+	}
+	return 1.0f;
+}
+
+/**
+ * @brief Julia set membership at the unzoomed position pos, by perturbation
+ *
+ * Follows sample_4D_Julia_double_double()'s orbit as an offset from
+ * s->reference.
+ */
+float						sample_4D_Julia_perturbation(const t_sampler *s, float3 pos)
+{
+	float					d[3];
+	float					v;
+	uint					csr;
+
+	csr = flush_denormals();
+	start_offset(s, pos, d);
+	v = perturbation_orbit(s, d);
+	restore_denormals(csr);
+	return v;
+}
+
+typedef void				(*t_pert_kernel)(const t_sampler *s,
+								const float *dx, const float *dy, const float *dz, float *out);
+
+#if PERT_X86
+
+/* AVX2: 8 lanes */
+# define PK_SUFFIX			_avx2
+# define PK_TARGET			__attribute__((target("avx2"))) PK_NO_CONTRACT
+# define PK_WIDTH			8
+# define pk_vec				__m256
+# define pk_int				__m256i
+# define pk_mask			__m256
+# define PK_SET1(a)			_mm256_set1_ps(a)
+# define PK_LOAD(p)			_mm256_loadu_ps(p)
+# define PK_ADD(a, b)		_mm256_add_ps(a, b)
+# define PK_SUB(a, b)		_mm256_sub_ps(a, b)
+# define PK_MUL(a, b)		_mm256_mul_ps(a, b)
+# define PK_GATHER(p, i)	_mm256_i32gather_ps(p, i, 4)
+# define PK_ISET1(a)		_mm256_set1_epi32(a)
+# define PK_IADD(a, b)		_mm256_add_epi32(a, b)
+# define PK_IEQ(a, b)		_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))
+# define PK_BLEND(m, a, b)	_mm256_blendv_ps(a, b, m)
+# define PK_IBLEND(m, a, b)	_mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), m))
+# define PK_GT(a, b)		_mm256_cmp_ps(a, b, _CMP_GT_OQ)
+# define PK_OR(a, b)		_mm256_or_ps(a, b)
+# define PK_BITS(m)			_mm256_movemask_ps(m)
+# define PK_NONE			_mm256_setzero_ps()
+# include "pert_kernels.h"
+# undef PK_SUFFIX
+# undef PK_TARGET
+# undef PK_WIDTH
+# undef pk_vec
+# undef pk_int
+# undef pk_mask
+# undef PK_SET1
+# undef PK_LOAD
+# undef PK_ADD
+# undef PK_SUB
+# undef PK_MUL
+# undef PK_GATHER
+# undef PK_ISET1
+# undef PK_IADD
+# undef PK_IEQ
+# undef PK_BLEND
+# undef PK_IBLEND
+# undef PK_GT
+# undef PK_OR
+# undef PK_BITS
+# undef PK_NONE
+
+/* AVX-512: 16 lanes, lane masks live in k-mask registers */
+# define PK_SUFFIX			_avx512
+# define PK_TARGET			__attribute__((target("avx512f"))) PK_NO_CONTRACT
+# define PK_WIDTH			16
+# define pk_vec				__m512
+# define pk_int				__m512i
+# define pk_mask			__mmask16
+# define PK_SET1(a)			_mm512_set1_ps(a)
+# define PK_LOAD(p)			_mm512_loadu_ps(p)
+# define PK_ADD(a, b)		_mm512_add_ps(a, b)
+# define PK_SUB(a, b)		_mm512_sub_ps(a, b)
+# define PK_MUL(a, b)		_mm512_mul_ps(a, b)
+# define PK_GATHER(p, i)	_mm512_i32gather_ps(i, p, 4)
+# define PK_ISET1(a)		_mm512_set1_epi32(a)
+# define PK_IADD(a, b)		_mm512_add_epi32(a, b)
+# define PK_IEQ(a, b)		_mm512_cmpeq_epi32_mask(a, b)
+# define PK_BLEND(m, a, b)	_mm512_mask_blend_ps(m, a, b)
+# define PK_IBLEND(m, a, b)	_mm512_mask_blend_epi32(m, a, b)
+# define PK_GT(a, b)		_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ)
+# define PK_OR(a, b)		((__mmask16)((a) | (b)))
+# define PK_BITS(m)			((int)(m))
+# define PK_NONE			((__mmask16)0)
+# include "pert_kernels.h"
+# undef PK_SUFFIX
+# undef PK_TARGET
+# undef PK_WIDTH
+# undef pk_vec
+# undef pk_int
+# undef pk_mask
+# undef PK_SET1
+# undef PK_LOAD
+# undef PK_ADD
+# undef PK_SUB
+# undef PK_MUL
+# undef PK_GATHER
+# undef PK_ISET1
+# undef PK_IADD
+# undef PK_IEQ
+# undef PK_BLEND
+# undef PK_IBLEND
+# undef PK_GT
+# undef PK_OR
+# undef PK_BITS
+# undef PK_NONE
+
+/**
+ * @brief Vector kernel for level, NULL below AVX2
+ */
+static t_pert_kernel		pert_kernel(int level, uint *width)
+{
+	if (level >= SIMD_AVX512)
+	{
+		*width = 16;
+		return batch_julia_perturbation_avx512;
+	}
+	if (level == SIMD_AVX2)
+	{
+		*width = 8;
+		return batch_julia_perturbation_avx2;
+	}
+	return NULL;
+}
+
+#endif
+
+/**
+ * @brief Classify n points, given unzoomed as SoA coordinates, by perturbation
+ *
+ * Full vectors go through the kernel for s->simd_level, the ragged tail
+ * padded into one last vector; results match
+ * sample_4D_Julia_perturbation() point for point.
+ */
+void						sample_batch_perturbation(const t_sampler *s,
+								const float *x, const float *y, const float *z, float *out, uint n)
+{
+	float					d[3][16];
+	float					to[16];
+	uint					csr;
+	uint					i;
+
+	csr = flush_denormals();
+	i = 0;
+#if PERT_X86
+	t_pert_kernel			k;
+	uint					w;
+
+	if (s->simd_level < SIMD_LEVELS && (k = pert_kernel(s->simd_level, &w)))
+	{
+		for (; i < n; i += w)
+		{
+			for (uint l = 0; l < w; l++)
+			{
+				if (i + l < n)
+					start_offset(s, (float3){x[i + l], y[i + l], z[i + l]}, to);
+				else
+					to[0] = to[1] = to[2] = 0.0f;
+				d[0][l] = to[0];
+				d[1][l] = to[1];
+				d[2][l] = to[2];
+			}
+			k(s, d[0], d[1], d[2], to);
+			memcpy(out + i, to, ((n - i < w) ? n - i : w) * sizeof(float));
+		}
+	}
+#endif
+	for (; i < n; i++)
+	{
+		start_offset(s, (float3){x[i], y[i], z[i]}, d[0]);
+		out[i] = perturbation_orbit(s, d[0]);
+	}
+	restore_denormals(csr);
+}
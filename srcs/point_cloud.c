@@ -5,24 +5,58 @@ void 						calculate_point_cloud(t_data *data)
 	t_fract 				*fract;
 
 	fract = data->fract;
+	data->cycle_skips = 0;
 	fract->grid_size = fract->grid_length / fract->step_size;
 	init_grid(data);
-	init_vertex(data);
+	data->field_kind = sampled_field_kind(data);
+	init_sampler(data);
+	data->binary_field = field_is_binary(data);
+	data->num_shells = shell_count(data);
+	select_shell(data, 0);
 	
-	// Initialize memory optimizations after we know the grid size
-	init_triangle_pool(data);
-	init_flat_triangles(data);
+	// Indexed output needs the lattice's edge structure, so only lattice builds emit it
+	data->indexed_build = data->indexed_mesh && data->shared_lattice;
+	if (data->shared_lattice)
+	{
+		// Binary fields need one bit per point; the indexed mesher reads values
+		data->packed_lattice = data->pack_lattice && data->binary_field && !data->indexed_build;
+		
+		// Grids whose full lattice would not fit comfortably stream through it
+		data->streaming_build = data->force_streaming ||
+			lattice_bytes(fract, data->packed_lattice) > STREAMING_LATTICE_BYTES;
+		
+		// Streamed shells go to one triangle buffer each; data->mesh has no such split
+		if (data->streaming_build && data->num_shells > 1)
+			data->indexed_build = 0;
+		init_lattice(data);
+		
+		// Orbits carried over from the last build, when only max_iter moved
+		data->orbit_cache_active = prepare_orbit_cache(data);
+	}
+	else
+	{
+		data->orbit_cache_active = 0;
+		init_vertex(data);
+	}
 	
-	// Initialize marching cubes vertex list (small, fixed size allocation)
-	printf("\x1b[36m[%s]\x1b[0m Allocating marching cubes vertex list: %u vertices\n", 
-		   __FILE__, data->mc_vertlist_size);
-	if (!(data->mc_vertlist = (float3 *)malloc(data->mc_vertlist_size * sizeof(float3))))
-		error(MALLOC_FAIL_ERR, data);
+	// Initialize memory optimizations after we know the grid size
+	if (data->indexed_build)
+		init_mesh(data);
+	else
+		init_flat_triangles(data);
 	
 	create_grid(data);
 	define_voxel(fract, fract->step_size);
 
-	build_fractal(data);
+	if (!data->shared_lattice)
+		build_fractal(data);
+	else if (data->streaming_build)
+		build_fractal_streaming(data);
+	else
+		build_fractal_lattice(data);
+	if (data->cycle_skips)
+		printf("\x1b[36m[%s]\x1b[0m Periodicity checking skipped %zu iterations of cycling orbits\n",
+			   __FILE__, data->cycle_skips);
 }
 
 void						create_grid(t_data *data)
@@ -64,3 +98,44 @@ void						define_voxel(t_fract *fract, float s)
 		}
 	}
 }
+
+/**
+ * @brief Number of cells per axis, matching the legacy per-cube loop bounds
+ */
+uint						lattice_cells(t_fract *fract)
+{
+	return (uint)ceilf(fract->grid_size);
+}
+
+/**
+ * @brief Bytes a fully resident shared lattice would need for this grid
+ * 
+ * @param packed Lattice stored as occupancy bits instead of float values
+ */
+size_t						lattice_bytes(t_fract *fract, int packed)
+{
+	size_t					dim;
+
+	dim = (size_t)lattice_cells(fract) + 1;
+	if (packed)
+		return OCCUPANCY_WORDS(dim) * dim * dim * sizeof(uint64_t);
+	return dim * dim * dim * sizeof(float);
+}
+
+/**
+ * @brief World position of lattice point (x, y, z)
+ * 
+ * Lattice points sit on the cube corners of the legacy grid: cell centres
+ * are p0 + i * step, so corners are offset by half a step.
+ */
+float3						lattice_point_pos(t_fract *fract, uint x, uint y, uint z)
+{
+	float3					p;
+	float					s;
+
+	s = fract->step_size;
+	p.x = fract->p0.x + ((float)x - 0.5f) * s;
+	p.y = fract->p0.y + ((float)y - 0.5f) * s;
+	p.z = fract->p0.z + ((float)z - 0.5f) * s;
+	return p;
+}
@@ -1,49 +1,53 @@
 #include "morphosis.h"
 #include "look-up.h"
 
-static uint 				getCubeIndex(float *v_val, uint pos)
+static uint 				getCubeIndex(float *v_val, uint pos, float inside)
 {
 	uint					cubeindex;
 
 	cubeindex = 0;
-	if (v_val[pos + 0])
+	if (v_val[pos + 0] > inside)
 		cubeindex |= 1;
-	if (v_val[pos + 1])
+	if (v_val[pos + 1] > inside)
 		cubeindex |= 2;
-	if (v_val[pos + 2])
+	if (v_val[pos + 2] > inside)
 		cubeindex |= 4;
-	if (v_val[pos + 3])
+	if (v_val[pos + 3] > inside)
 		cubeindex |= 8;
-	if (v_val[pos + 4])
+	if (v_val[pos + 4] > inside)
 		cubeindex |= 16;
-	if (v_val[pos + 5])
+	if (v_val[pos + 5] > inside)
 		cubeindex |= 32;
-	if (v_val[pos + 6])
+	if (v_val[pos + 6] > inside)
 		cubeindex |= 64;
-	if (v_val[pos + 7])
+	if (v_val[pos + 7] > inside)
 		cubeindex |= 128;
 	return cubeindex;
 }
 
-static float3				interpolate(float3 p0, float3 p1, float v0, float v1)
+/*
+** Corners valued above data->inside_level are inside; vertices go where
+** the field crosses data->surface_level (see select_shell()).
+*/
+static float3				interpolate(float3 p0, float3 p1, float v0, float v1, float level)
 {
 	float					mu;
 	float3					p;
 
-	if (v0 == 1.0f)
+	if (v0 == level)
 		return p0;
-	if (v1 == 1.0f)
+	if (v1 == level)
 		return p1;
 	if ((v1 - v0) == 0.0f)
 		return p0;
-	mu = (1.0f - v0) / (v1 - v0);
+	mu = (level - v0) / (v1 - v0);
 	p.x = p0.x + mu * (p1.x - p0.x);
 	p.y = p0.y + mu * (p1.y - p0.y);
 	p.z = p0.z + mu * (p1.z - p0.z);
 	return p;
 }
 
-static float3				*get_vertices(uint cubeindex, float3 *v_pos, float *v_val, uint pos)
+static float3				*get_vertices(uint cubeindex, float3 *v_pos, float *v_val, uint pos, float level)
 {
 	float3					*vertlist;
 
@@ -51,29 +55,29 @@ static float3				*get_vertices(uint cubeindex, float3 *v_pos, float *v_val, uint
 		return NULL;
 
 	if (edgetable[cubeindex] & 1)
-		vertlist[0] = interpolate(v_pos[pos + 0], v_pos[pos + 1], v_val[pos + 0], v_val[pos + 1]);
+		vertlist[0] = interpolate(v_pos[pos + 0], v_pos[pos + 1], v_val[pos + 0], v_val[pos + 1], level);
 	if (edgetable[cubeindex] & 2)
-		vertlist[1] = interpolate(v_pos[pos + 1], v_pos[pos + 2], v_val[pos + 1], v_val[pos + 2]);
+		vertlist[1] = interpolate(v_pos[pos + 1], v_pos[pos + 2], v_val[pos + 1], v_val[pos + 2], level);
 	if (edgetable[cubeindex] & 4)
-		vertlist[2] = interpolate(v_pos[pos + 2], v_pos[pos + 3], v_val[pos + 2], v_val[pos + 3]);
+		vertlist[2] = interpolate(v_pos[pos + 2], v_pos[pos + 3], v_val[pos + 2], v_val[pos + 3], level);
 	if (edgetable[cubeindex] & 8)
-		vertlist[3] = interpolate(v_pos[pos + 3], v_pos[pos + 0], v_val[pos + 3], v_val[pos + 0]);
+		vertlist[3] = interpolate(v_pos[pos + 3], v_pos[pos + 0], v_val[pos + 3], v_val[pos + 0], level);
 	if (edgetable[cubeindex] & 16)
-		vertlist[4] = interpolate(v_pos[pos + 4], v_pos[pos + 5], v_val[pos + 4], v_val[pos + 5]);
+		vertlist[4] = interpolate(v_pos[pos + 4], v_pos[pos + 5], v_val[pos + 4], v_val[pos + 5], level);
 	if (edgetable[cubeindex] & 32)
-		vertlist[5] = interpolate(v_pos[pos + 5], v_pos[pos + 6], v_val[pos + 5], v_val[pos + 6]);
+		vertlist[5] = interpolate(v_pos[pos + 5], v_pos[pos + 6], v_val[pos + 5], v_val[pos + 6], level);
 	if (edgetable[cubeindex] & 64)
-		vertlist[6] = interpolate(v_pos[pos + 6], v_pos[pos + 7], v_val[pos + 6], v_val[pos + 7]);
+		vertlist[6] = interpolate(v_pos[pos + 6], v_pos[pos + 7], v_val[pos + 6], v_val[pos + 7], level);
 	if (edgetable[cubeindex] & 128)
-		vertlist[7] = interpolate(v_pos[pos + 7], v_pos[pos + 4], v_val[pos + 7], v_val[pos + 4]);
+		vertlist[7] = interpolate(v_pos[pos + 7], v_pos[pos + 4], v_val[pos + 7], v_val[pos + 4], level);
 	if (edgetable[cubeindex] & 256)
-		vertlist[8] = interpolate(v_pos[pos + 0], v_pos[pos + 4], v_val[pos + 0], v_val[pos + 4]);
+		vertlist[8] = interpolate(v_pos[pos + 0], v_pos[pos + 4], v_val[pos + 0], v_val[pos + 4], level);
 	if (edgetable[cubeindex] & 512)
-		vertlist[9] = interpolate(v_pos[pos + 1], v_pos[pos + 5], v_val[pos + 1], v_val[pos + 5]);
+		vertlist[9] = interpolate(v_pos[pos + 1], v_pos[pos + 5], v_val[pos + 1], v_val[pos + 5], level);
 	if (edgetable[cubeindex] & 1024)
-		vertlist[10] = interpolate(v_pos[pos + 2], v_pos[pos + 6], v_val[pos + 2], v_val[pos + 6]);
+		vertlist[10] = interpolate(v_pos[pos + 2], v_pos[pos + 6], v_val[pos + 2], v_val[pos + 6], level);
 	if (edgetable[cubeindex] & 2048)
-		vertlist[11] = interpolate(v_pos[pos + 3], v_pos[pos + 7], v_val[pos + 3], v_val[pos + 7]);
+		vertlist[11] = interpolate(v_pos[pos + 3], v_pos[pos + 7], v_val[pos + 3], v_val[pos + 7], level);
 	return vertlist;
 }
 
@@ -123,14 +127,14 @@ float3 						**polygonise(float3 *v_pos, float *v_val, uint2 *pos, t_data *data)
 	len.x = 0;
 	
 	// Step 1: Determine cube configuration from 8 vertex values
-	cubeindex = getCubeIndex(v_val, pos->x);
+	cubeindex = getCubeIndex(v_val, pos->x, data->inside_level);
 	
 	// Step 2: Check if surface intersects this cube (edgetable lookup)
 	if (edgetable[cubeindex] == 0)
 		return NULL; // No surface intersection, skip this cube
 	
 	// Step 3: Calculate interpolated vertices on cube edges where surface crosses
-	if (!(vertlist = get_vertices(cubeindex, v_pos, v_val, pos->x)))
+	if (!(vertlist = get_vertices(cubeindex, v_pos, v_val, pos->x, data->surface_level)))
 		error(MALLOC_FAIL_ERR, data);
 
 	// Step 4: Generate triangles using triangle table lookup
@@ -152,82 +156,426 @@ float3 						**polygonise(float3 *v_pos, float *v_val, uint2 *pos, t_data *data)
 }
 
 /**
- * @brief Optimized Marching Cubes Algorithm with memory pool
+ * @brief Triangulate a single cube from its 8 corner positions and values
  * 
- * Enhanced version that uses pre-allocated vertex list to eliminate
- * malloc/free overhead in the critical marching cubes loop.
+ * Shared core of the optimized marching cubes paths. Corners follow the
+ * define_voxel() ordering, so callers only need to gather the 8 corners.
  * 
- * @param v_pos Array of 8 vertex positions for current cube
- * @param v_val Array of 8 scalar values (0.0 or 1.0 from Julia set)
- * @param pos Current position in the grid
- * @param data Main data structure with pre-allocated vertex list
- * @return Array of triangles representing the surface, or NULL if no surface
+ * @param v_pos 8 corner positions of the cube
+ * @param v_val 8 corner scalar values (0.0 or 1.0 from Julia set)
+ * @param inside Corners valued above this are inside
+ * @param level Field value the surface passes through
+ * @param out Triangle buffer the cube's triangles are appended to
+ * @return Number of triangles appended to out
  */
-float3 						**polygonise_optimized(float3 *v_pos, float *v_val, uint2 *pos, t_data *data)
+static uint					polygonise_cube(float3 *v_pos, float *v_val, float inside, float level, t_tribuf *out)
 {
-	float3					**tris;      // Final triangle array
-	float3 					**tris_new;  // Temporary triangle array
-	float3					*vertlist;   // Pre-allocated edge vertices (optimization!)
+	float3					vertlist[12]; // Edge vertices, on the stack so workers never share it
+	float3					*dst;        // Write cursor into the triangle buffer
 	uint 					cubeindex;   // Cube configuration index (0-255)
 	uint 					i;           // Triangle table iterator
-	uint2 					len;         // Array length tracking
 
-	tris = NULL;
-	tris_new = NULL;
 	i = 0;
-	len.x = 0;
 	
 	// Step 1: Determine cube configuration from 8 vertex values
-	cubeindex = getCubeIndex(v_val, pos->x);
+	cubeindex = getCubeIndex(v_val, 0, inside);
 	
 	// Step 2: Check if surface intersects this cube (edgetable lookup)
 	if (edgetable[cubeindex] == 0)
-		return NULL; // No surface intersection, skip this cube
-	
-	// Step 3: Use pre-allocated vertex list (OPTIMIZATION: no malloc!)
-	vertlist = data->mc_vertlist;
+		return 0; // No surface intersection, skip this cube
 	
-	// Calculate interpolated vertices on cube edges where surface crosses
+	// Step 3: Calculate interpolated vertices on cube edges where surface crosses
 	// Optimized: only calculate vertices that are actually used
 	if (edgetable[cubeindex] & 1)
-		vertlist[0] = interpolate(v_pos[pos->x + 0], v_pos[pos->x + 1], v_val[pos->x + 0], v_val[pos->x + 1]);
+		vertlist[0] = interpolate(v_pos[0], v_pos[1], v_val[0], v_val[1], level);
 	if (edgetable[cubeindex] & 2)
-		vertlist[1] = interpolate(v_pos[pos->x + 1], v_pos[pos->x + 2], v_val[pos->x + 1], v_val[pos->x + 2]);
+		vertlist[1] = interpolate(v_pos[1], v_pos[2], v_val[1], v_val[2], level);
 	if (edgetable[cubeindex] & 4)
-		vertlist[2] = interpolate(v_pos[pos->x + 2], v_pos[pos->x + 3], v_val[pos->x + 2], v_val[pos->x + 3]);
+		vertlist[2] = interpolate(v_pos[2], v_pos[3], v_val[2], v_val[3], level);
 	if (edgetable[cubeindex] & 8)
-		vertlist[3] = interpolate(v_pos[pos->x + 3], v_pos[pos->x + 0], v_val[pos->x + 3], v_val[pos->x + 0]);
+		vertlist[3] = interpolate(v_pos[3], v_pos[0], v_val[3], v_val[0], level);
 	if (edgetable[cubeindex] & 16)
-		vertlist[4] = interpolate(v_pos[pos->x + 4], v_pos[pos->x + 5], v_val[pos->x + 4], v_val[pos->x + 5]);
+		vertlist[4] = interpolate(v_pos[4], v_pos[5], v_val[4], v_val[5], level);
 	if (edgetable[cubeindex] & 32)
-		vertlist[5] = interpolate(v_pos[pos->x + 5], v_pos[pos->x + 6], v_val[pos->x + 5], v_val[pos->x + 6]);
+		vertlist[5] = interpolate(v_pos[5], v_pos[6], v_val[5], v_val[6], level);
 	if (edgetable[cubeindex] & 64)
-		vertlist[6] = interpolate(v_pos[pos->x + 6], v_pos[pos->x + 7], v_val[pos->x + 6], v_val[pos->x + 7]);
+		vertlist[6] = interpolate(v_pos[6], v_pos[7], v_val[6], v_val[7], level);
 	if (edgetable[cubeindex] & 128)
-		vertlist[7] = interpolate(v_pos[pos->x + 7], v_pos[pos->x + 4], v_val[pos->x + 7], v_val[pos->x + 4]);
+		vertlist[7] = interpolate(v_pos[7], v_pos[4], v_val[7], v_val[4], level);
 	if (edgetable[cubeindex] & 256)
-		vertlist[8] = interpolate(v_pos[pos->x + 0], v_pos[pos->x + 4], v_val[pos->x + 0], v_val[pos->x + 4]);
+		vertlist[8] = interpolate(v_pos[0], v_pos[4], v_val[0], v_val[4], level);
 	if (edgetable[cubeindex] & 512)
-		vertlist[9] = interpolate(v_pos[pos->x + 1], v_pos[pos->x + 5], v_val[pos->x + 1], v_val[pos->x + 5]);
+		vertlist[9] = interpolate(v_pos[1], v_pos[5], v_val[1], v_val[5], level);
 	if (edgetable[cubeindex] & 1024)
-		vertlist[10] = interpolate(v_pos[pos->x + 2], v_pos[pos->x + 6], v_val[pos->x + 2], v_val[pos->x + 6]);
+		vertlist[10] = interpolate(v_pos[2], v_pos[6], v_val[2], v_val[6], level);
 	if (edgetable[cubeindex] & 2048)
-		vertlist[11] = interpolate(v_pos[pos->x + 3], v_pos[pos->x + 7], v_val[pos->x + 3], v_val[pos->x + 7]);
+		vertlist[11] = interpolate(v_pos[3], v_pos[7], v_val[3], v_val[7], level);
 
-	// Step 4: Generate triangles using triangle table lookup
+	// Step 4: Append triangles straight into the buffer (max 5 per cube)
+	if (!tribuf_reserve(out, 5))
+		error(MALLOC_FAIL_ERR, NULL);
+	dst = &out->tris[(size_t)out->count * 3];
 	while ((int)tritable[cubeindex][i] != -1) // -1 terminates triangle list
 	{
-		// Create triangle from 3 consecutive vertex indices in triangle table
-		tris_new = package_triangles(vertlist, cubeindex, i, data);
-		len.y = 1;
-		
-		// Concatenate new triangle to existing triangle array
-		if (!(tris = arr_float3_cat(tris_new, tris, &len)))
-			error(MALLOC_FAIL_ERR, data);
+		dst[0] = vertlist[tritable[cubeindex][i]];
+		dst[1] = vertlist[tritable[cubeindex][i + 1]];
+		dst[2] = vertlist[tritable[cubeindex][i + 2]];
+		dst += 3;
 		i += 3; // Move to next triangle (3 vertices per triangle)
 	}
-	data->len.y = len.x;
+	out->count += i / 3;
+	return i / 3;
+}
 
-	// No need to free vertlist - it's pre-allocated and reused!
-	return tris; // Return generated triangles
+/**
+ * @brief Optimized Marching Cubes Algorithm with memory pool
+ * 
+ * Enhanced version that uses pre-allocated vertex list to eliminate
+ * malloc/free overhead in the critical marching cubes loop.
+ * 
+ * @param v_pos Array of 8 vertex positions for current cube
+ * @param v_val Array of 8 scalar values (0.0 or 1.0 from Julia set)
+ * @param pos Current position in the grid
+ * @param data Main data structure, triangles go to data->flat
+ * @return Number of triangles appended to data->flat
+ */
+uint 						polygonise_optimized(float3 *v_pos, float *v_val, uint2 *pos, t_data *data)
+{
+	return polygonise_cube(&v_pos[pos->x], &v_val[pos->x], data->inside_level,
+		data->surface_level, &data->flat);
+}
+
+/**
+ * @brief Marching Cubes on the shared-corner lattice
+ * 
+ * Reads the 8 corner values of a cell straight from the two lattice planes
+ * that bound it and derives the corner positions from the lattice indices,
+ * so no per-cube copies of positions or values are ever stored. Only reads
+ * shared state, so bricks can be meshed concurrently into separate buffers.
+ * 
+ * @param plane0 Lattice values of plane cell.z, lattice_dim^2 points
+ * @param plane1 Lattice values of plane cell.z + 1
+ * @param cell Cell index (x, y, z)
+ * @param data Main data structure (lattice geometry)
+ * @param out Triangle buffer the cell's triangles are appended to
+ * @return Number of triangles appended to out
+ */
+uint 						polygonise_lattice(float *plane0, float *plane1, uint3 cell, t_data *data, t_tribuf *out)
+{
+	static const uint		cx[8] = {0, 1, 1, 0, 0, 1, 1, 0};
+	static const uint		cy[8] = {1, 1, 0, 0, 1, 1, 0, 0};
+	static const uint		cz[8] = {0, 0, 0, 0, 1, 1, 1, 1};
+	float3					v_pos[8];
+	float					v_val[8];
+	size_t					dim;
+
+	dim = data->lattice_dim;
+	for (int c = 0; c < 8; c++)
+		v_val[c] = (cz[c] ? plane1 : plane0)[(cell.y + cy[c]) * dim + cell.x + cx[c]];
+	
+	// Skip position derivation entirely for cubes the surface does not cross
+	if (edgetable[getCubeIndex(v_val, 0, data->inside_level)] == 0)
+		return 0;
+	for (int c = 0; c < 8; c++)
+		v_pos[c] = lattice_point_pos(data->fract, cell.x + cx[c], cell.y + cy[c], cell.z + cz[c]);
+	return polygonise_cube(v_pos, v_val, data->inside_level, data->surface_level, out);
+}
+
+/**
+ * @brief Emit the triangles of a binary-field case at a given cell
+ * 
+ * With values strictly 0 or 1, interpolate() always lands on the inside
+ * corner of an edge, so each case's triangles are a fixed list of cell
+ * corners (binary_tri_corners). Vertices are read from the per-axis
+ * lattice coordinates: no interpolation, no edge vertex list and no scan
+ * for the -1 terminator.
+ */
+static uint					emit_binary_case(uint cubeindex, uint3 cell, t_data *data, t_tribuf *out)
+{
+	static const uint		cx[8] = {0, 1, 1, 0, 0, 1, 1, 0};
+	static const uint		cy[8] = {1, 1, 0, 0, 1, 1, 0, 0};
+	static const uint		cz[8] = {0, 0, 0, 0, 1, 1, 1, 1};
+	const unsigned char		*corners;
+	const float				*xs;
+	const float				*ys;
+	const float				*zs;
+	float3					*dst;
+	size_t					dim;
+	uint					n;
+
+	if (!(n = binary_tri_count[cubeindex]))
+		return 0;
+	
+	// Cell origin in the coordinate tables; corner offsets are 0 or 1
+	dim = data->lattice_dim;
+	xs = &data->lattice_coords[cell.x];
+	ys = &data->lattice_coords[dim + cell.y];
+	zs = &data->lattice_coords[2 * dim + cell.z];
+	if (!tribuf_reserve(out, n))
+		error(MALLOC_FAIL_ERR, NULL);
+	dst = &out->tris[(size_t)out->count * 3];
+	corners = binary_tri_corners[cubeindex];
+	for (uint k = 0; k < n * 3; k++)
+	{
+		dst[k].x = xs[cx[corners[k]]];
+		dst[k].y = ys[cy[corners[k]]];
+		dst[k].z = zs[cz[corners[k]]];
+	}
+	out->count += n;
+	return n;
+}
+
+/**
+ * @brief Marching Cubes fast path for binary fields on a float lattice
+ * 
+ * Builds the case index branch-free and emits it with emit_binary_case().
+ * Output matches polygonise_lattice() exactly.
+ * 
+ * @param plane0 Lattice values of plane cell.z, lattice_dim^2 points
+ * @param plane1 Lattice values of plane cell.z + 1
+ * @param cell Cell index (x, y, z)
+ * @param data Main data structure (lattice geometry)
+ * @param out Triangle buffer the cell's triangles are appended to
+ * @return Number of triangles appended to out
+ */
+uint 						polygonise_lattice_binary(float *plane0, float *plane1, uint3 cell, t_data *data, t_tribuf *out)
+{
+	static const uint		cx[8] = {0, 1, 1, 0, 0, 1, 1, 0};
+	static const uint		cy[8] = {1, 1, 0, 0, 1, 1, 0, 0};
+	static const uint		cz[8] = {0, 0, 0, 0, 1, 1, 1, 1};
+	size_t					dim;
+	uint					cubeindex;
+
+	dim = data->lattice_dim;
+	cubeindex = 0;
+	for (int c = 0; c < 8; c++)
+		cubeindex |= (((cz[c] ? plane1 : plane0)[(cell.y + cy[c]) * dim + cell.x + cx[c]]) != 0.0f) << c;
+	return emit_binary_case(cubeindex, cell, data, out);
+}
+
+/**
+ * @brief Bits x and x + 1 of an occupancy row, bit x in the low bit
+ */
+static inline uint			occupancy_pair(const uint64_t *row, uint x)
+{
+	uint64_t				v;
+
+	v = row[x >> 6] >> (x & 63);
+	if ((x & 63) == 63)
+		v |= row[(x >> 6) + 1] << 1;
+	return (uint)(v & 3);
+}
+
+/**
+ * @brief March a whole row of cells of a bit-packed occupancy lattice
+ * 
+ * The four lattice rows bounding cell row (y, z) are combined 64 cells at
+ * a time: a cell is crossed by the surface iff its corners are neither all
+ * outside nor all inside, which is one OR/AND/shift per word. Words with
+ * no crossed cell are skipped with a single test and the crossed cells
+ * are visited by their set bits, so empty space costs almost nothing.
+ * 
+ * @param plane0 Occupancy of plane z, OCCUPANCY_WORDS(dim) words per row
+ * @param plane1 Occupancy of plane z + 1
+ * @param y Row of the cells
+ * @param z Layer of the cells
+ * @param data Main data structure (lattice geometry)
+ * @param out Triangle buffer the row's triangles are appended to
+ * @return Number of triangles appended to out
+ */
+uint						polygonise_lattice_row_bits(const uint64_t *plane0, const uint64_t *plane1,
+								uint y, uint z, t_data *data, t_tribuf *out)
+{
+	// Corner order of getCubeIndex() puts bit x + 1 before bit x on rows y and z
+	static const uint		swap_pair[4] = {0, 2, 1, 3};
+	const uint64_t			*r00;
+	const uint64_t			*r10;
+	const uint64_t			*r01;
+	const uint64_t			*r11;
+	uint64_t				any;
+	uint64_t				all;
+	uint64_t				active;
+	uint					words;
+	uint					cells;
+	uint					count;
+	uint3					cell;
+	uint					x;
+
+	words = OCCUPANCY_WORDS(data->lattice_dim);
+	cells = data->lattice_dim - 1;
+	r00 = plane0 + (size_t)y * words;
+	r10 = plane0 + (size_t)(y + 1) * words;
+	r01 = plane1 + (size_t)y * words;
+	r11 = plane1 + (size_t)(y + 1) * words;
+	cell.y = y;
+	cell.z = z;
+	count = 0;
+	for (uint w = 0; w < words && w * 64 < cells; w++)
+	{
+		// Per lattice column: any corner row inside / every corner row inside
+		any = r00[w] | r10[w] | r01[w] | r11[w];
+		all = r00[w] & r10[w] & r01[w] & r11[w];
+		
+		// Per cell: fold in column x + 1, carried over from the next word
+		if (w + 1 < words)
+		{
+			any = any | (any >> 1) | ((r00[w + 1] | r10[w + 1] | r01[w + 1] | r11[w + 1]) << 63);
+			all = all & ((all >> 1) | ((r00[w + 1] & r10[w + 1] & r01[w + 1] & r11[w + 1]) << 63));
+		}
+		else
+		{
+			any = any | (any >> 1);
+			all = all & (all >> 1);
+		}
+		active = any & ~all;
+		if (cells - w * 64 < 64)
+			active &= ((uint64_t)1 << (cells - w * 64)) - 1;
+		while (active)
+		{
+			x = w * 64 + (uint)__builtin_ctzll(active);
+			cell.x = x;
+			count += emit_binary_case(occupancy_pair(r10, x) | (swap_pair[occupancy_pair(r00, x)] << 2)
+				| (occupancy_pair(r11, x) << 4) | (swap_pair[occupancy_pair(r01, x)] << 6), cell, data, out);
+			active &= active - 1;
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Allocate an edge cache for a lattice with dim points per axis
+ * 
+ * @return 1 on success, 0 if an allocation failed
+ */
+int							init_edge_cache(t_edge_cache *cache, uint dim)
+{
+	size_t					plane;
+
+	plane = (size_t)dim * dim;
+	cache->dim = dim;
+	cache->x_edges[0] = (uint *)malloc(plane * sizeof(uint));
+	cache->x_edges[1] = (uint *)malloc(plane * sizeof(uint));
+	cache->y_edges[0] = (uint *)malloc(plane * sizeof(uint));
+	cache->y_edges[1] = (uint *)malloc(plane * sizeof(uint));
+	cache->z_edges = (uint *)malloc(plane * sizeof(uint));
+	if (!cache->x_edges[0] || !cache->x_edges[1] || !cache->y_edges[0]
+		|| !cache->y_edges[1] || !cache->z_edges)
+		return 0;
+	memset(cache->x_edges[0], 0xFF, plane * sizeof(uint));
+	memset(cache->x_edges[1], 0xFF, plane * sizeof(uint));
+	memset(cache->y_edges[0], 0xFF, plane * sizeof(uint));
+	memset(cache->y_edges[1], 0xFF, plane * sizeof(uint));
+	memset(cache->z_edges, 0xFF, plane * sizeof(uint));
+	return 1;
+}
+
+/**
+ * @brief Move the cache up one cell layer
+ * 
+ * The upper plane's edges become the lower plane's, so vertices created
+ * by layer z are reused by layer z + 1; the new upper plane and the
+ * vertical edges start out empty.
+ */
+void						advance_edge_cache(t_edge_cache *cache)
+{
+	size_t					plane;
+	uint					*tmp;
+
+	plane = (size_t)cache->dim * cache->dim;
+	tmp = cache->x_edges[0];
+	cache->x_edges[0] = cache->x_edges[1];
+	cache->x_edges[1] = tmp;
+	tmp = cache->y_edges[0];
+	cache->y_edges[0] = cache->y_edges[1];
+	cache->y_edges[1] = tmp;
+	memset(cache->x_edges[1], 0xFF, plane * sizeof(uint));
+	memset(cache->y_edges[1], 0xFF, plane * sizeof(uint));
+	memset(cache->z_edges, 0xFF, plane * sizeof(uint));
+}
+
+void						free_edge_cache(t_edge_cache *cache)
+{
+	free(cache->x_edges[0]);
+	free(cache->x_edges[1]);
+	free(cache->y_edges[0]);
+	free(cache->y_edges[1]);
+	free(cache->z_edges);
+}
+
+/**
+ * @brief Marching Cubes on the lattice emitting an indexed mesh
+ * 
+ * Every cube edge is a lattice edge, identified by its axis and its lower
+ * lattice point. The first cell to cross an edge creates its vertex and
+ * records the index in the cache; the up to three other cells sharing the
+ * edge reuse it. Cells must be visited in layer order with
+ * advance_edge_cache() between layers. Triangles go to data->mesh.
+ * 
+ * @param plane0 Lattice values of plane cell.z, lattice_dim^2 points
+ * @param plane1 Lattice values of plane cell.z + 1
+ * @param cell Cell index (x, y, z)
+ * @param data Main data structure (lattice geometry, output mesh)
+ * @param cache Edge vertices of the current cell layer
+ * @return Number of triangles appended to data->mesh
+ */
+uint 						polygonise_lattice_indexed(float *plane0, float *plane1, uint3 cell, t_data *data, t_edge_cache *cache)
+{
+	static const uint		cx[8] = {0, 1, 1, 0, 0, 1, 1, 0};
+	static const uint		cy[8] = {1, 1, 0, 0, 1, 1, 0, 0};
+	static const uint		cz[8] = {0, 0, 0, 0, 1, 1, 1, 1};
+	// Corners joined by each cube edge
+	static const uint		corner[12][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5},
+								{5, 6}, {6, 7}, {7, 4}, {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+	// Axis (0=x, 1=y, 2=z) and lower lattice point offset of each cube edge
+	static const uint		edge[12][4] = {{0, 0, 1, 0}, {1, 1, 0, 0}, {0, 0, 0, 0},
+								{1, 0, 0, 0}, {0, 0, 1, 1}, {1, 1, 0, 1}, {0, 0, 0, 1},
+								{1, 0, 0, 1}, {2, 0, 1, 0}, {2, 1, 1, 0}, {2, 1, 0, 0}, {2, 0, 0, 0}};
+	uint					vertlist[12];
+	float3					p0;
+	float3					p1;
+	float					v_val[8];
+	uint					*slot;
+	uint 					cubeindex;
+	size_t					dim;
+	uint					i;
+
+	dim = data->lattice_dim;
+	for (int c = 0; c < 8; c++)
+		v_val[c] = (cz[c] ? plane1 : plane0)[(cell.y + cy[c]) * dim + cell.x + cx[c]];
+	cubeindex = getCubeIndex(v_val, 0, data->inside_level);
+	if (edgetable[cubeindex] == 0)
+		return 0;
+	
+	// Look up or create the vertex of every crossed edge
+	for (int e = 0; e < 12; e++)
+	{
+		if (!(edgetable[cubeindex] & (1 << e)))
+			continue;
+		i = (cell.y + edge[e][2]) * dim + cell.x + edge[e][1];
+		if (edge[e][0] == 0)
+			slot = &cache->x_edges[edge[e][3]][i];
+		else if (edge[e][0] == 1)
+			slot = &cache->y_edges[edge[e][3]][i];
+		else
+			slot = &cache->z_edges[i];
+		if (*slot == MESH_NO_VERTEX)
+		{
+			p0 = lattice_point_pos(data->fract, cell.x + cx[corner[e][0]],
+				cell.y + cy[corner[e][0]], cell.z + cz[corner[e][0]]);
+			p1 = lattice_point_pos(data->fract, cell.x + cx[corner[e][1]],
+				cell.y + cy[corner[e][1]], cell.z + cz[corner[e][1]]);
+			*slot = mesh_add_vertex(&data->mesh,
+				interpolate(p0, p1, v_val[corner[e][0]], v_val[corner[e][1]], data->surface_level));
+		}
+		vertlist[e] = *slot;
+	}
+	
+	i = 0;
+	while ((int)tritable[cubeindex][i] != -1)
+	{
+		mesh_add_triangle(&data->mesh, vertlist[tritable[cubeindex][i]],
+			vertlist[tritable[cubeindex][i + 1]], vertlist[tritable[cubeindex][i + 2]]);
+		i += 3;
+	}
+	return i / 3;
 }
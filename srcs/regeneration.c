@@ -0,0 +1,279 @@
+#include "morphosis.h"
+#include <pthread.h>
+
+/*
+** Background regeneration.
+**
+** One long-lived worker thread rebuilds the fractal on a private copy of
+** the build state while the render loop keeps drawing the current mesh.
+** A request only records the latest parameters and bumps a generation
+** counter: a request arriving mid-build cancels that build (builds poll
+** data->cancel between bricks and rows), and a burst of key presses
+** coalesces into a single rebuild with the final parameters. The GL
+** thread picks a finished build up in poll_regeneration(), swaps the CPU
+** buffers and flips the double-buffered VAO/VBO/EBO, so it never blocks
+** on the build nor overwrites a buffer the current frame is drawing.
+*/
+
+struct						s_regen
+{
+	pthread_t				thread;
+	pthread_mutex_t			lock;
+	pthread_cond_t			cond;
+	t_data					*work;			// Build state owned by the worker
+	t_data					*next;			// Parameters of the latest request
+	unsigned long			requested;		// Generation of the latest request
+	unsigned long			started;		// Generation the worker last started
+	volatile int			cancel;			// Aborts the build in progress
+	int						ready;			// work holds a finished, unconsumed build
+	int						quit;
+	double					request_time;	// When the latest request was made
+};
+
+/**
+ * @brief Copy every build parameter of src into dst, keeping dst's buffers
+ */
+static void					copy_build_params(t_data *dst, t_data *src)
+{
+	t_data					own;
+	t_fract					own_fract;
+
+	own = *dst;
+	*dst = *src;
+	dst->gl = own.gl;
+	dst->fract = own.fract;
+	dst->vertexpos = own.vertexpos;
+	dst->vertexval = own.vertexval;
+	dst->lattice = own.lattice;
+	dst->lattice_coords = own.lattice_coords;
+	dst->occupancy = own.occupancy;
+	dst->flat = own.flat;
+	dst->mesh = own.mesh;
+	dst->orbits = own.orbits;
+	dst->reference_orbit = own.reference_orbit;
+	dst->reference_capacity = own.reference_capacity;
+	dst->cancel = own.cancel;
+	dst->regen = own.regen;
+
+	own_fract = *dst->fract;
+	*dst->fract = *src->fract;
+	dst->fract->julia = own_fract.julia;
+	dst->fract->grid = own_fract.grid;
+	*dst->fract->julia = *src->fract->julia;
+}
+
+/**
+ * @brief Allocate build state with the parameters of src and no buffers
+ */
+static t_data				*new_build_data(t_data *src)
+{
+	t_data					*d;
+
+	if (!(d = (t_data *)calloc(1, sizeof(t_data))))
+		error(MALLOC_FAIL_ERR, src);
+	d->gl = init_gl_struct();
+	d->fract = init_fract();
+	copy_build_params(d, src);
+	return d;
+}
+
+static void					free_build_data(t_data *d)
+{
+	if (!d)
+		return;
+	free(d->gl->vertex_normals);
+	d->gl->vertex_normals = NULL;
+	clean_up(d);
+}
+
+/**
+ * @brief Rebuild everything the renderer needs on the worker's state
+ */
+static void					rebuild(t_data *work)
+{
+	clean_calcs(work);
+	work->flat.count = 0;
+	calculate_point_cloud(work);
+	if (!BUILD_CANCELLED(work))
+	{
+		gl_retrieve_tris(work);
+		calculate_vertex_normals(work);
+	}
+	clean_calcs(work);
+}
+
+static void					*regen_worker(void *arg)
+{
+	t_regen					*r;
+	unsigned long			gen;
+
+	r = (t_regen *)arg;
+	pthread_mutex_lock(&r->lock);
+	while (1)
+	{
+		while (!r->quit && (r->ready || r->started == r->requested))
+			pthread_cond_wait(&r->cond, &r->lock);
+		if (r->quit)
+			break;
+		gen = r->requested;
+		r->started = gen;
+		r->cancel = 0;
+		copy_build_params(r->work, r->next);
+		pthread_mutex_unlock(&r->lock);
+
+		rebuild(r->work);
+
+		pthread_mutex_lock(&r->lock);
+		if (!r->cancel && gen == r->requested)
+			r->ready = 1;
+	}
+	pthread_mutex_unlock(&r->lock);
+	return NULL;
+}
+
+/**
+ * @brief Start the regeneration worker
+ *
+ * Leaves data->regen NULL if the thread cannot be created, in which case
+ * the render loop falls back to synchronous regenerate_fractal().
+ */
+void						start_regeneration(t_data *data)
+{
+	t_regen					*r;
+
+	if (!(r = (t_regen *)calloc(1, sizeof(t_regen))))
+		error(MALLOC_FAIL_ERR, data);
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+	r->work = new_build_data(data);
+	r->next = new_build_data(data);
+	r->work->cancel = &r->cancel;
+	if (pthread_create(&r->thread, NULL, regen_worker, r) != 0)
+	{
+		printf("\x1b[33m[%s]\x1b[0m No regeneration thread, rebuilding synchronously\n", __FILE__);
+		free_build_data(r->work);
+		free_build_data(r->next);
+		pthread_mutex_destroy(&r->lock);
+		pthread_cond_destroy(&r->cond);
+		free(r);
+		return;
+	}
+	data->regen = r;
+}
+
+/**
+ * @brief Ask for a rebuild with the current parameters of data
+ *
+ * Never waits for the build: an outdated build still running is cancelled
+ * and an outdated result not yet shown is dropped.
+ */
+void						request_regeneration(t_data *data)
+{
+	t_regen					*r;
+
+	r = data->regen;
+	pthread_mutex_lock(&r->lock);
+	copy_build_params(r->next, data);
+	r->requested++;
+	r->cancel = 1;
+	r->ready = 0;
+	r->request_time = glfwGetTime();
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+	printf("\x1b[33m[%s]\x1b[0m Regenerating fractal in the background...\n", __FILE__);
+}
+
+/**
+ * @brief Show a finished background build, if there is one
+ *
+ * Called once per frame on the GL thread.
+ *
+ * @return 1 if new geometry was swapped in
+ */
+int							poll_regeneration(t_data *data)
+{
+	t_regen					*r;
+	t_data					*w;
+	t_gl					*gl;
+	t_gl					tmp;
+	t_tribuf				flat;
+	t_mesh					mesh;
+	int						indexed;
+
+	r = data->regen;
+	if (!r || pthread_mutex_trylock(&r->lock) != 0)
+		return 0;
+	if (!r->ready)
+	{
+		pthread_mutex_unlock(&r->lock);
+		return 0;
+	}
+
+	// Trade buffers with the worker: it reuses ours for its next build
+	w = r->work;
+	gl = data->gl;
+	tmp = *gl;
+	gl->tris = w->gl->tris;
+	gl->num_pts = w->gl->num_pts;
+	gl->num_tris = w->gl->num_tris;
+	gl->indices = w->gl->indices;
+	gl->num_indices = w->gl->num_indices;
+	gl->vertex_normals = w->gl->vertex_normals;
+	w->gl->tris = tmp.tris;
+	w->gl->indices = tmp.indices;
+	w->gl->vertex_normals = tmp.vertex_normals;
+	flat = data->flat;
+	data->flat = w->flat;
+	w->flat = flat;
+	mesh = data->mesh;
+	data->mesh = w->mesh;
+	w->mesh = mesh;
+	indexed = data->indexed_build;
+	data->indexed_build = w->indexed_build;
+	w->indexed_build = indexed;
+	data->num_shells = w->num_shells;
+	memcpy(data->shell_start, w->shell_start, sizeof(data->shell_start));
+	r->ready = 0;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+
+	swap_in_back_buffers(gl);
+	if (gl->enhanced_shader_program != 0 && gl->vertex_normals != NULL)
+	{
+		if (gl->normal_buffer == 0)
+			glGenBuffers(1, &gl->normal_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, gl->normal_buffer);
+		glBufferData(GL_ARRAY_BUFFER, gl->num_pts * sizeof(float),
+					 gl->vertex_normals, GL_STATIC_DRAW);
+	}
+
+	data->last_regen_time = glfwGetTime();
+	printf("\x1b[32m[%s]\x1b[0m Regeneration complete: %.2fs, %d triangles\n",
+		   __FILE__, data->last_regen_time - r->request_time, gl->num_tris);
+	if (data->show_info)
+		print_parameter_info(data);
+	return 1;
+}
+
+/**
+ * @brief Cancel any build in progress and stop the worker
+ */
+void						stop_regeneration(t_data *data)
+{
+	t_regen					*r;
+
+	if (!(r = data->regen))
+		return;
+	pthread_mutex_lock(&r->lock);
+	r->quit = 1;
+	r->cancel = 1;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+	pthread_join(r->thread, NULL);
+	free_build_data(r->work);
+	free_build_data(r->next);
+	pthread_mutex_destroy(&r->lock);
+	pthread_cond_destroy(&r->cond);
+	free(r);
+	data->regen = NULL;
+}
@@ -0,0 +1,318 @@
+#include "morphosis.h"
+
+/*
+** Batched sampling with runtime instruction-set dispatch.
+**
+** includes/batch_kernels.h holds the kernels once, written against a tiny
+** set of lane macros; it is instantiated below for SSE2, AVX2 and AVX-512
+** using per-function target attributes, so the binary runs anywhere and
+** detect_simd_level() picks the widest set the CPU and OS support.
+** Non-x86 builds only get the scalar path.
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+# define BATCH_X86 1
+# include <immintrin.h>
+#else
+# define BATCH_X86 0
+#endif
+
+/*
+** GCC happily fuses the multiply/add intrinsics into FMAs once AVX-512 is
+** enabled, which would make the wide path round differently from the
+** scalar kernels. Keep contraction off so every path classifies alike.
+*/
+#if defined(__GNUC__) && !defined(__clang__)
+# define BK_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+# define BK_NO_CONTRACT
+#endif
+
+typedef void				(*t_vec_kernel)(const t_julia *julia,
+								const float *x, const float *y, const float *z, float *out);
+
+#if BATCH_X86
+
+/* SSE2: 4 lanes */
+# define BK_SUFFIX			_sse2
+# define BK_TARGET			__attribute__((target("sse2"))) BK_NO_CONTRACT
+# define BK_WIDTH			4
+# define bk_vec				__m128
+# define bk_mask			__m128
+# define BK_SET1(a)			_mm_set1_ps(a)
+# define BK_LOAD(p)			_mm_loadu_ps(p)
+# define BK_ADD(a, b)		_mm_add_ps(a, b)
+# define BK_SUB(a, b)		_mm_sub_ps(a, b)
+# define BK_MUL(a, b)		_mm_mul_ps(a, b)
+# define BK_GT(a, b)		_mm_cmpgt_ps(a, b)
+# define BK_OR(a, b)		_mm_or_ps(a, b)
+# define BK_BITS(m)			_mm_movemask_ps(m)
+# define BK_NONE			_mm_setzero_ps()
+# include "batch_kernels.h"
+# undef BK_SUFFIX
+# undef BK_TARGET
+# undef BK_WIDTH
+# undef bk_vec
+# undef bk_mask
+# undef BK_SET1
+# undef BK_LOAD
+# undef BK_ADD
+# undef BK_SUB
+# undef BK_MUL
+# undef BK_GT
+# undef BK_OR
+# undef BK_BITS
+# undef BK_NONE
+
+/* AVX2: 8 lanes */
+# define BK_SUFFIX			_avx2
+# define BK_TARGET			__attribute__((target("avx2"))) BK_NO_CONTRACT
+# define BK_WIDTH			8
+# define bk_vec				__m256
+# define bk_mask			__m256
+# define BK_SET1(a)			_mm256_set1_ps(a)
+# define BK_LOAD(p)			_mm256_loadu_ps(p)
+# define BK_ADD(a, b)		_mm256_add_ps(a, b)
+# define BK_SUB(a, b)		_mm256_sub_ps(a, b)
+# define BK_MUL(a, b)		_mm256_mul_ps(a, b)
+# define BK_GT(a, b)		_mm256_cmp_ps(a, b, _CMP_GT_OQ)
+# define BK_OR(a, b)		_mm256_or_ps(a, b)
+# define BK_BITS(m)			_mm256_movemask_ps(m)
+# define BK_NONE			_mm256_setzero_ps()
+# include "batch_kernels.h"
+# undef BK_SUFFIX
+# undef BK_TARGET
+# undef BK_WIDTH
+# undef bk_vec
+# undef bk_mask
+# undef BK_SET1
+# undef BK_LOAD
+# undef BK_ADD
+# undef BK_SUB
+# undef BK_MUL
+# undef BK_GT
+# undef BK_OR
+# undef BK_BITS
+# undef BK_NONE
+
+/* AVX-512: 16 lanes, escape state lives in a k-mask register; its 32
+** registers hold the hybrid type's two orbits at once */
+# define BK_HYBRID
+# define BK_SUFFIX			_avx512
+# define BK_TARGET			__attribute__((target("avx512f"))) BK_NO_CONTRACT
+# define BK_WIDTH			16
+# define bk_vec				__m512
+# define bk_mask			__mmask16
+# define BK_SET1(a)			_mm512_set1_ps(a)
+# define BK_LOAD(p)			_mm512_loadu_ps(p)
+# define BK_ADD(a, b)		_mm512_add_ps(a, b)
+# define BK_SUB(a, b)		_mm512_sub_ps(a, b)
+# define BK_MUL(a, b)		_mm512_mul_ps(a, b)
+# define BK_GT(a, b)		_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ)
+# define BK_OR(a, b)		((__mmask16)((a) | (b)))
+# define BK_BITS(m)			((int)(m))
+# define BK_NONE			((__mmask16)0)
+# include "batch_kernels.h"
+# undef BK_SUFFIX
+# undef BK_TARGET
+# undef BK_WIDTH
+# undef bk_vec
+# undef bk_mask
+# undef BK_SET1
+# undef BK_LOAD
+# undef BK_ADD
+# undef BK_SUB
+# undef BK_MUL
+# undef BK_GT
+# undef BK_OR
+# undef BK_BITS
+# undef BK_NONE
+# undef BK_HYBRID
+
+/* Per kind: the loop kernel, then the one unrolled for BATCH_UNROLLED_ITER */
+# define BK_KERNEL_ROW(sfx) { \
+	{batch_julia##sfx, batch_julia_fixed##sfx}, \
+	{batch_mandelbrot##sfx, batch_mandelbrot_fixed##sfx}, \
+	{batch_cubic##sfx, batch_cubic_fixed##sfx}, \
+	{batch_square_linear##sfx, batch_square_linear_fixed##sfx}, \
+	{batch_magnitude##sfx, batch_magnitude_fixed##sfx}, \
+	{batch_power2##sfx, batch_power2_fixed##sfx}, \
+	{batch_power3##sfx, batch_power3_fixed##sfx}, \
+	{batch_power4##sfx, batch_power4_fixed##sfx}, \
+	{batch_power5##sfx, batch_power5_fixed##sfx}, \
+	{batch_power6##sfx, batch_power6_fixed##sfx}, \
+	{batch_power7##sfx, batch_power7_fixed##sfx}, \
+	{batch_power8##sfx, batch_power8_fixed##sfx}}
+
+static const t_vec_kernel	g_vec_kernels[SIMD_LEVELS][BATCH_KINDS][2] = {
+	{{NULL, NULL}},
+	BK_KERNEL_ROW(_sse2),
+	BK_KERNEL_ROW(_avx2),
+	BK_KERNEL_ROW(_avx512),
+};
+
+#endif
+
+static const uint			g_vec_width[SIMD_LEVELS] = {1, 4, 8, 16};
+
+/**
+ * @brief Widest vector instruction set usable on this machine
+ * 
+ * __builtin_cpu_supports() also checks that the OS saves the wide
+ * register state, so AVX-512 is only reported when it is really usable.
+ */
+int							detect_simd_level(void)
+{
+#if BATCH_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SIMD_SSE2;
+#endif
+	return SIMD_SCALAR;
+}
+
+const char					*simd_level_name(int level)
+{
+	static const char		*names[SIMD_LEVELS] = {"scalar", "SSE2", "AVX2", "AVX-512"};
+
+	if (level < 0 || level >= SIMD_LEVELS)
+		return "unknown";
+	return names[level];
+}
+
+static float				sample_scalar(int kind, const t_julia *julia, float3 pos)
+{
+	if (kind == BATCH_MANDELBROT)
+		return sample_4D_Mandelbrot(julia, pos);
+	if (kind >= BATCH_CUBIC)
+		return sample_4D_Julia_alternative_formula(julia, pos, kind - BATCH_CUBIC + 1);
+	return sample_4D_Julia_optimized(julia, pos);
+}
+
+/**
+ * @brief Classify n points given as SoA coordinate arrays
+ * 
+ * Runs full vectors through the kernel for the requested instruction set
+ * and pads the ragged tail into one last vector. kind selects the
+ * Julia (BATCH_JULIA), Mandelbrot (BATCH_MANDELBROT) or alternative
+ * formula (BATCH_CUBIC and on) kernel, unrolled when
+ * max_iter is BATCH_UNROLLED_ITER. Results match the scalar kernels point
+ * for point.
+ */
+void						sample_batch(int level, int kind, const t_julia *julia,
+								const float *x, const float *y, const float *z, float *out, uint n)
+{
+	uint					i;
+
+	i = 0;
+#if BATCH_X86
+	if (level > SIMD_SCALAR && level < SIMD_LEVELS)
+	{
+		t_vec_kernel		k = g_vec_kernels[level][kind][julia->max_iter == BATCH_UNROLLED_ITER];
+		uint				w = g_vec_width[level];
+		float				tx[16], ty[16], tz[16], to[16];
+
+		for (; i + w <= n; i += w)
+			k(julia, x + i, y + i, z + i, out + i);
+		if (i < n)
+		{
+			for (uint l = 0; l < w; l++)
+			{
+				tx[l] = (i + l < n) ? x[i + l] : 0.0f;
+				ty[l] = (i + l < n) ? y[i + l] : 0.0f;
+				tz[l] = (i + l < n) ? z[i + l] : 0.0f;
+			}
+			k(julia, tx, ty, tz, to);
+			memcpy(out + i, to, (n - i) * sizeof(float));
+		}
+		return;
+	}
+#else
+	(void)level;
+	(void)g_vec_width;
+#endif
+	for (; i < n; i++)
+		out[i] = sample_scalar(kind, julia, (float3){x[i], y[i], z[i]});
+}
+
+/**
+ * @brief Both hybrid memberships of n points through the fused kernel
+ *
+ * @return 0 where level has no fused kernel, or the unrolled kernels apply
+ */
+static int					sample_batch_fused(int level, const t_julia *julia,
+								const float *x, const float *y, const float *z,
+								float *julia_out, float *mandel_out, uint n)
+{
+#if BATCH_X86
+	float					tx[16], ty[16], tz[16], tj[16], tm[16];
+	uint					i;
+
+	if (level != SIMD_AVX512 || julia->max_iter == BATCH_UNROLLED_ITER)
+		return 0;
+	for (i = 0; i + 16 <= n; i += 16)
+		batch_hybrid_avx512(julia, x + i, y + i, z + i, julia_out + i, mandel_out + i);
+	if (i < n)
+	{
+		for (uint l = 0; l < 16; l++)
+		{
+			tx[l] = (i + l < n) ? x[i + l] : 0.0f;
+			ty[l] = (i + l < n) ? y[i + l] : 0.0f;
+			tz[l] = (i + l < n) ? z[i + l] : 0.0f;
+		}
+		batch_hybrid_avx512(julia, tx, ty, tz, tj, tm);
+		memcpy(julia_out + i, tj, (n - i) * sizeof(float));
+		memcpy(mandel_out + i, tm, (n - i) * sizeof(float));
+	}
+	return 1;
+#else
+	(void)level;
+	(void)julia;
+	(void)x;
+	(void)y;
+	(void)z;
+	(void)julia_out;
+	(void)mandel_out;
+	(void)n;
+	return 0;
+#endif
+}
+
+/**
+ * @brief Hybrid Julia / Mandelbrot blend of n points given as SoA arrays
+ *
+ * On AVX-512 one fused kernel runs both orbits. Narrower sets, which
+ * would spill the pair, and the unrolled default iteration count, which
+ * retires faster per set, run the two kernels back to back. The blend is
+ * then only evaluated where the sets disagree (see hybrid_mix()).
+ */
+void						sample_batch_hybrid(int level, const t_julia *julia,
+								const float *x, const float *y, const float *z, float *out, uint n)
+{
+	float					tj[SAMPLE_BATCH_CHUNK];
+	float					tm[SAMPLE_BATCH_CHUNK];
+	uint					count;
+
+	if (level <= SIMD_SCALAR || level >= SIMD_LEVELS)
+	{
+		for (uint i = 0; i < n; i++)
+			out[i] = sample_4D_hybrid(julia, (float3){x[i], y[i], z[i]});
+		return;
+	}
+	for (uint base = 0; base < n; base += SAMPLE_BATCH_CHUNK)
+	{
+		count = (n - base < SAMPLE_BATCH_CHUNK) ? n - base : SAMPLE_BATCH_CHUNK;
+		if (!sample_batch_fused(level, julia, x + base, y + base, z + base, tj, tm, count))
+		{
+			sample_batch(level, BATCH_JULIA, julia, x + base, y + base, z + base, tj, count);
+			sample_batch(level, BATCH_MANDELBROT, julia, x + base, y + base, z + base, tm, count);
+		}
+		for (uint i = 0; i < count; i++)
+			out[base + i] = (tj[i] == tm[i]) ? tj[i]
+				: hybrid_mix(tj[i], tm[i], (float3){x[base + i], y[base + i], z[base + i]});
+	}
+}
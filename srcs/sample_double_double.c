@@ -0,0 +1,335 @@
+#include "morphosis.h"
+
+/*
+** Double-double deep zoom.
+**
+** Past DEEP_ZOOM_DD_MIN the squares of neighbouring starting points
+** differ by less than a double's rounding of c, so in double precision
+** every orbit is the same after one step. Here each number is an
+** unevaluated sum hi + lo of two doubles, about 106 bits, kept exact by
+** error-free transforms: two_sum() recovers the rounding error of an
+** addition, and a fused multiply-subtract that of a product. A step costs
+** roughly twenty double operations where the double kernel needs three;
+** nothing else in the loop changes.
+**
+** includes/dd_kernels.h holds the vector kernel, instantiated below for
+** AVX2 with FMA and for AVX-512, mirroring these scalar functions
+** operation for operation. Neither has periodicity checks, so both
+** classify every point alike.
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+# define DD_X86 1
+# include <immintrin.h>
+#else
+# define DD_X86 0
+#endif
+
+/*
+** The transforms are exact only if every operation is rounded as
+** written: a contracted a * b + c would lose the error they recover.
+*/
+#if defined(__GNUC__) && !defined(__clang__)
+# define DD_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+# define DD_NO_CONTRACT
+#endif
+
+typedef struct				s_dd
+{
+	double					hi;
+	double					lo;
+}							t_dd;
+
+/* s + e == a + b exactly, for any a and b */
+DD_NO_CONTRACT static inline t_dd	dd_two_sum(double a, double b)
+{
+	t_dd					r;
+	double					bb;
+
+	r.hi = a + b;
+	bb = r.hi - a;
+	r.lo = (a - (r.hi - bb)) + (b - bb);
+	return r;
+}
+
+/* s + e == a + b exactly, for |a| >= |b| */
+DD_NO_CONTRACT static inline t_dd	dd_quick_sum(double a, double b)
+{
+	t_dd					r;
+
+	r.hi = a + b;
+	r.lo = b - (r.hi - a);
+	return r;
+}
+
+DD_NO_CONTRACT static inline t_dd	dd_add(t_dd a, t_dd b)
+{
+	t_dd					s;
+	t_dd					t;
+
+	s = dd_two_sum(a.hi, b.hi);
+	t = dd_two_sum(a.lo, b.lo);
+	s = dd_quick_sum(s.hi, s.lo + t.hi);
+	return dd_quick_sum(s.hi, s.lo + t.lo);
+}
+
+DD_NO_CONTRACT static inline t_dd	dd_sub(t_dd a, t_dd b)
+{
+	b.hi = 0.0 - b.hi;
+	b.lo = 0.0 - b.lo;
+	return dd_add(a, b);
+}
+
+/* a + b for a plain double b */
+DD_NO_CONTRACT static inline t_dd	dd_add_d(t_dd a, double b)
+{
+	t_dd					s;
+
+	s = dd_two_sum(a.hi, b);
+	return dd_quick_sum(s.hi, s.lo + a.lo);
+}
+
+DD_NO_CONTRACT static inline t_dd	dd_mul(t_dd a, t_dd b)
+{
+	double					p;
+	double					e;
+
+	p = a.hi * b.hi;
+	e = fma(a.hi, b.hi, -p);
+	e = e + ((a.hi * b.lo) + (a.lo * b.hi));
+	return dd_quick_sum(p, e);
+}
+
+DD_NO_CONTRACT static inline t_dd	dd_sqr(t_dd a)
+{
+	double					p;
+	double					e;
+
+	p = a.hi * a.hi;
+	e = fma(a.hi, a.hi, -p);
+	e = e + 2.0 * (a.hi * a.lo);
+	return dd_quick_sum(p, e);
+}
+
+/* 2 * a, exact */
+static inline t_dd			dd_twice(t_dd a)
+{
+	a.hi = a.hi + a.hi;
+	a.lo = a.lo + a.lo;
+	return a;
+}
+
+/**
+ * @brief One step of z^2 + c on the double-double quaternion q
+ *
+ * @return |z|^2 of the new point, from the high parts
+ */
+DD_NO_CONTRACT static inline double	dd_julia_step(t_dd *q, const t_julia *julia)
+{
+	t_dd					nx, ny, nz;
+
+	nx = dd_sub(dd_sub(dd_sub(dd_sqr(q[0]), dd_sqr(q[1])), dd_sqr(q[2])), dd_sqr(q[3]));
+	ny = dd_add_d(dd_twice(dd_mul(q[0], q[1])), (double)julia->c.y);
+	nz = dd_add_d(dd_twice(dd_mul(q[0], q[2])), (double)julia->c.z);
+	q[3] = dd_add_d(dd_twice(dd_mul(q[0], q[3])), (double)julia->c.w);
+	q[0] = dd_add_d(nx, (double)julia->c.x);
+	q[1] = ny;
+	q[2] = nz;
+	return (q[0].hi * q[0].hi) + (q[1].hi * q[1].hi) + (q[2].hi * q[2].hi) + (q[3].hi * q[3].hi);
+}
+
+static inline void			dd_start(t_dd *q, const t_julia *julia, double3 pos, double zoom_level)
+{
+	q[0] = (t_dd){pos.x / zoom_level, 0.0};
+	q[1] = (t_dd){pos.y / zoom_level, 0.0};
+	q[2] = (t_dd){pos.z / zoom_level, 0.0};
+	q[3] = (t_dd){(double)julia->w / zoom_level, 0.0};
+}
+
+/**
+ * @brief Deep zoom Julia set sampling in double-double precision
+ *
+ * Same orbit as sample_4D_Julia_deep_zoom(), z^2 + c from pos / zoom_level,
+ * carried to about 106 bits. pos is the unzoomed lattice position.
+ */
+DD_NO_CONTRACT float		sample_4D_Julia_double_double(const t_julia *julia, double3 pos, double zoom_level)
+{
+	t_dd					q[4];
+
+	dd_start(q, julia, pos, zoom_level);
+	for (uint iter = 0; iter < julia->max_iter; iter++)
+	{
+		if (dd_julia_step(q, julia) > 4.0)
+			return 0.0f;
+	}
+	return 1.0f;
+}
+
+/**
+ * @brief Orbit of pos / zoom_level in double-double, each point rounded to float
+ *
+ * Stores z_0 onwards into orbit, up to max_iter steps, stopping after
+ * the first point past the escape radius.
+ *
+ * @return Index of the last point stored
+ */
+DD_NO_CONTRACT uint			double_double_orbit(const t_julia *julia, double3 pos, double zoom_level, cl_quat *orbit)
+{
+	t_dd					q[4];
+	uint					n;
+	double					mag_sq;
+
+	dd_start(q, julia, pos, zoom_level);
+	n = 0;
+	while (1)
+	{
+		orbit[n] = (cl_quat){(float)q[0].hi, (float)q[1].hi, (float)q[2].hi, (float)q[3].hi};
+		if (n == julia->max_iter)
+			return n;
+		mag_sq = dd_julia_step(q, julia);
+		n++;
+		if (mag_sq > 4.0)
+		{
+			orbit[n] = (cl_quat){(float)q[0].hi, (float)q[1].hi, (float)q[2].hi, (float)q[3].hi};
+			return n;
+		}
+	}
+}
+
+typedef void				(*t_dd_kernel)(const t_julia *julia, double zoom_level,
+								const float *x, const float *y, const float *z, float *out);
+
+#if DD_X86
+
+/* AVX2 with FMA: 4 lanes */
+# define DK_SUFFIX			_avx2
+# define DK_TARGET			__attribute__((target("avx2,fma"))) DD_NO_CONTRACT
+# define DK_WIDTH			4
+# define dk_vec				__m256d
+# define dk_mask			__m256d
+# define DK_SET1(a)			_mm256_set1_pd(a)
+# define DK_LOAD_PS(p)		_mm256_cvtps_pd(_mm_loadu_ps(p))
+# define DK_ADD(a, b)		_mm256_add_pd(a, b)
+# define DK_SUB(a, b)		_mm256_sub_pd(a, b)
+# define DK_MUL(a, b)		_mm256_mul_pd(a, b)
+# define DK_DIV(a, b)		_mm256_div_pd(a, b)
+# define DK_FMS(a, b, c)	_mm256_fmsub_pd(a, b, c)
+# define DK_GT(a, b)		_mm256_cmp_pd(a, b, _CMP_GT_OQ)
+# define DK_OR(a, b)		_mm256_or_pd(a, b)
+# define DK_BITS(m)			_mm256_movemask_pd(m)
+# define DK_NONE			_mm256_setzero_pd()
+# include "dd_kernels.h"
+# undef DK_SUFFIX
+# undef DK_TARGET
+# undef DK_WIDTH
+# undef dk_vec
+# undef dk_mask
+# undef DK_SET1
+# undef DK_LOAD_PS
+# undef DK_ADD
+# undef DK_SUB
+# undef DK_MUL
+# undef DK_DIV
+# undef DK_FMS
+# undef DK_GT
+# undef DK_OR
+# undef DK_BITS
+# undef DK_NONE
+
+/* AVX-512: 8 lanes, escape state lives in a k-mask register */
+# define DK_SUFFIX			_avx512
+# define DK_TARGET			__attribute__((target("avx512f"))) DD_NO_CONTRACT
+# define DK_WIDTH			8
+# define dk_vec				__m512d
+# define dk_mask			__mmask8
+# define DK_SET1(a)			_mm512_set1_pd(a)
+# define DK_LOAD_PS(p)		_mm512_cvtps_pd(_mm256_loadu_ps(p))
+# define DK_ADD(a, b)		_mm512_add_pd(a, b)
+# define DK_SUB(a, b)		_mm512_sub_pd(a, b)
+# define DK_MUL(a, b)		_mm512_mul_pd(a, b)
+# define DK_DIV(a, b)		_mm512_div_pd(a, b)
+# define DK_FMS(a, b, c)	_mm512_fmsub_pd(a, b, c)
+# define DK_GT(a, b)		_mm512_cmp_pd_mask(a, b, _CMP_GT_OQ)
+# define DK_OR(a, b)		((__mmask8)((a) | (b)))
+# define DK_BITS(m)			((int)(m))
+# define DK_NONE			((__mmask8)0)
+# include "dd_kernels.h"
+# undef DK_SUFFIX
+# undef DK_TARGET
+# undef DK_WIDTH
+# undef dk_vec
+# undef dk_mask
+# undef DK_SET1
+# undef DK_LOAD_PS
+# undef DK_ADD
+# undef DK_SUB
+# undef DK_MUL
+# undef DK_DIV
+# undef DK_FMS
+# undef DK_GT
+# undef DK_OR
+# undef DK_BITS
+# undef DK_NONE
+
+/**
+ * @brief Vector kernel for level, NULL where FMA is missing or below AVX2
+ */
+static t_dd_kernel			dd_kernel(int level, uint *width)
+{
+	if (level >= SIMD_AVX512)
+	{
+		*width = 8;
+		return batch_julia_dd_avx512;
+	}
+	if (level == SIMD_AVX2 && __builtin_cpu_supports("fma"))
+	{
+		*width = 4;
+		return batch_julia_dd_avx2;
+	}
+	return NULL;
+}
+
+#endif
+
+/**
+ * @brief Classify n points, given unzoomed as SoA coordinates, in double-double
+ *
+ * Full vectors go through the kernel for level, the ragged tail padded
+ * into one last vector; results match sample_4D_Julia_double_double()
+ * point for point.
+ */
+void						sample_batch_double_double(int level, const t_julia *julia, double zoom_level,
+								const float *x, const float *y, const float *z, float *out, uint n)
+{
+	uint					i;
+
+	i = 0;
+#if DD_X86
+	t_dd_kernel				k;
+	uint					w;
+	float					tx[8], ty[8], tz[8], to[8];
+
+	if (level < SIMD_LEVELS && (k = dd_kernel(level, &w)))
+	{
+		for (; i + w <= n; i += w)
+			k(julia, zoom_level, x + i, y + i, z + i, out + i);
+		if (i < n)
+		{
+			for (uint l = 0; l < w; l++)
+			{
+				tx[l] = (i + l < n) ? x[i + l] : 0.0f;
+				ty[l] = (i + l < n) ? y[i + l] : 0.0f;
+				tz[l] = (i + l < n) ? z[i + l] : 0.0f;
+			}
+			k(julia, zoom_level, tx, ty, tz, to);
+			memcpy(out + i, to, (n - i) * sizeof(float));
+		}
+		return;
+	}
+#else
+	(void)level;
+#endif
+	for (; i < n; i++)
+		out[i] = sample_4D_Julia_double_double(julia, (double3){x[i], y[i], z[i]}, zoom_level);
+}
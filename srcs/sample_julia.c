@@ -10,7 +10,7 @@
  * @param pos 3D position to sample (x,y,z components of quaternion)
  * @return 1.0f if point is in the set, 0.0f if it escapes
  */
-float 						sample_4D_Julia(t_julia *julia, float3 pos)
+float 						sample_4D_Julia(const t_julia *julia, float3 pos)
 {
 	cl_quat 				z;      // Current quaternion value z_n
 	uint 					iter;   // Current iteration count
@@ -63,18 +63,26 @@ float						cl_quat_mod_fast(cl_quat q)
  * 2. Early termination with magnitude squared comparison (avoids sqrt)
  * 3. Optimized quaternion operations with reduced temporary variables
  * 4. Loop unrolling hints for better compiler optimization
+ * 5. Brent periodicity checking: an orbit that comes back to the point
+ *    saved at the last power-of-two step is cycling, so the point is
+ *    inside and the remaining iterations are skipped
  * 
  * @param julia Julia set parameters (constant c and max iterations)
  * @param pos 3D position to sample (x,y,z components of quaternion)
  * @return 1.0f if point is in the set, 0.0f if it escapes
  */
-float						sample_4D_Julia_optimized(t_julia *julia, float3 pos)
+float						sample_4D_Julia_optimized(const t_julia *julia, float3 pos)
 {
 	cl_quat 				z;      // Current quaternion value z_n
 	cl_quat					c;      // Julia set constant (cached for performance)
+	cl_quat					saved;  // Orbit point the cycle check compares against
 	uint 					iter;   // Current iteration count
+	uint					period; // Steps between two saved points (Brent's power)
+	uint					lam;    // Steps since the last save
 	float					mag_sq; // Magnitude squared (avoids sqrt until needed)
+	float					dist_sq; // Squared distance to the saved point
 	const float				escape_threshold_sq = 4.0f; // 2² = 4 for escape condition
+	const float				cycle_tol_sq = PERIODICITY_TOL_F * PERIODICITY_TOL_F;
 
 	// Initialize quaternion z with 3D position + julia->w as 4th component
 	z.x = pos.x;  // Real component
@@ -84,6 +92,9 @@ float						sample_4D_Julia_optimized(t_julia *julia, float3 pos)
 	
 	// Cache Julia set constant for better performance
 	c = julia->c;
+	saved = z;
+	period = 1;
+	lam = 0;
 	
 	// Optimized iteration loop with early termination
 	for (iter = 0; iter < julia->max_iter; iter++)
@@ -109,6 +120,26 @@ float						sample_4D_Julia_optimized(t_julia *julia, float3 pos)
 		// Early termination: if |z|² > 4, the point escapes to infinity
 		if (mag_sq > escape_threshold_sq)
 			return 0.0f; // Point is NOT in the Julia set
+		
+		// Caught in a cycle: it can never escape. The x test alone rejects
+		// almost every step, keeping the check off the escaping orbits' path
+		if (fabsf(z.x - saved.x) < PERIODICITY_TOL_F)
+		{
+			dist_sq = ((z.x - saved.x) * (z.x - saved.x)) + ((z.y - saved.y) * (z.y - saved.y))
+				+ ((z.z - saved.z) * (z.z - saved.z)) + ((z.w - saved.w) * (z.w - saved.w));
+			if (dist_sq < cycle_tol_sq)
+			{
+				if (julia->cycle_skips)
+					__sync_add_and_fetch(julia->cycle_skips, julia->max_iter - iter - 1);
+				return 1.0f;
+			}
+		}
+		if (++lam == period)
+		{
+			saved = z;
+			period <<= 1;
+			lam = 0;
+		}
 	}
 	
 	// Point didn't escape within max_iter iterations
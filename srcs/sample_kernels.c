@@ -0,0 +1,322 @@
+#include "morphosis.h"
+
+/*
+** Specialised point kernels.
+**
+** init_sampler() runs once per build: it copies what the samplers read
+** into data->sampler and resolves that configuration into its
+** point_kernel and batch_kind. sample_fractal_point() then calls through
+** the pointer: no switch on fractal type, formula, precision or field
+** kind is left in the per-sample path, and none on the formula inside
+** any iteration loop. Every kernel takes the sampler by const pointer.
+**
+** The membership kernels are generated by PK_KERNEL() from a start and a
+** step, the same pieces includes/batch_kernels.h builds the vector
+** kernels from, once per formula in PK_JULIA_FORMULAS. Each comes as a
+** loop over max_iter and a fully unrolled BATCH_UNROLLED_ITER variant
+** for the default iteration count. The arithmetic matches the generic
+** samplers operation for operation.
+*/
+
+/*
+** Starts: z is the position (Julia) or c is (Mandelbrot, z at c_julia / 10)
+*/
+#define PK_START_JULIA \
+	zx = pos.x; \
+	zy = pos.y; \
+	zz = pos.z; \
+	zw = julia->w; \
+	cx = julia->c.x; \
+	cy = julia->c.y; \
+	cz = julia->c.z; \
+	cw = julia->c.w;
+
+#define PK_START_MANDELBROT \
+	cx = pos.x; \
+	cy = pos.y; \
+	cz = pos.z; \
+	cw = julia->w; \
+	zx = julia->c.x * 0.1f; \
+	zy = julia->c.y * 0.1f; \
+	zz = julia->c.z * 0.1f; \
+	zw = julia->c.w * 0.1f;
+
+/*
+** Steps: n = f(z) without the constant, numbered as formula_step()
+*/
+#define PK_STEP_SQUARE \
+	nx = (zx * zx) - (zy * zy) - (zz * zz) - (zw * zw); \
+	ny = 2.0f * (zx * zy); \
+	nz = 2.0f * (zx * zz); \
+	nw = 2.0f * (zx * zw);
+
+#define PK_STEP_CUBIC /* z * z^2 */ \
+	sx = (zx * zx) - (zy * zy) - (zz * zz) - (zw * zw); \
+	sy = 2.0f * (zx * zy); \
+	sz = 2.0f * (zx * zz); \
+	sw = 2.0f * (zx * zw); \
+	nx = (zx * sx) - (zy * sy) - (zz * sz) - (zw * sw); \
+	ny = (zx * sy) + (zy * sx) + (zz * sw) - (zw * sz); \
+	nz = (zx * sz) - (zy * sw) + (zz * sx) + (zw * sy); \
+	nw = (zx * sw) + (zy * sz) - (zz * sy) + (zw * sx);
+
+#define PK_STEP_SQUARE_LINEAR /* z^2 + z */ \
+	nx = (zx * zx) - (zy * zy) - (zz * zz) - (zw * zw) + zx; \
+	ny = 2.0f * (zx * zy) + zy; \
+	nz = 2.0f * (zx * zz) + zz; \
+	nw = 2.0f * (zx * zw) + zw;
+
+#define PK_STEP_MAGNITUDE /* |z|^2 - z^2 */ \
+	sx = (zx * zx) + (zy * zy) + (zz * zz) + (zw * zw); \
+	nx = sx - ((zx * zx) - (zy * zy) - (zz * zz) - (zw * zw)); \
+	ny = -2.0f * (zx * zy); \
+	nz = -2.0f * (zx * zz); \
+	nw = -2.0f * (zx * zw);
+
+#define PK_STEP_POWER(n) /* z^n as (A, S) in sx, sy; q in sz, see quaternion_power() */ \
+	sx = zx; \
+	sy = 1.0f; \
+	sz = (zy * zy) + (zz * zz) + (zw * zw); \
+	for (int bit = POWER_TOP_BIT(n) - 1; bit >= 0; bit--) \
+	{ \
+		sw = (sx * sx) - (sz * (sy * sy)); \
+		sy = 2.0f * (sx * sy); \
+		sx = sw; \
+		if (((n) >> bit) & 1) \
+		{ \
+			sw = (sx * zx) - (sz * sy); \
+			sy = sx + (zx * sy); \
+			sx = sw; \
+		} \
+	} \
+	nx = sx; \
+	ny = sy * zy; \
+	nz = sy * zz; \
+	nw = sy * zw;
+
+/*
+** One membership kernel: START sets z and c, STEP runs f, esc_sq is the
+** squared escape radius and ITER the trip count, unrolled when UNROLL says so.
+*/
+#define PK_KERNEL(name, START, STEP, esc_sq, ITER, UNROLL) \
+static float				name(const t_sampler *s, float3 pos) \
+{ \
+	const t_julia			*julia; \
+	float					zx, zy, zz, zw; \
+	float					nx, ny, nz, nw; \
+	float					sx, sy, sz, sw; \
+	float					cx, cy, cz, cw; \
+	\
+	(void)sx; (void)sy; (void)sz; (void)sw; \
+	julia = &s->julia; \
+	START \
+	UNROLL \
+	for (uint iter = 0; iter < (ITER); iter++) \
+	{ \
+		STEP \
+		zx = nx + cx; \
+		zy = ny + cy; \
+		zz = nz + cz; \
+		zw = nw + cw; \
+		if ((zx * zx) + (zy * zy) + (zz * zz) + (zw * zw) > (esc_sq)) \
+			return 0.0f; \
+	} \
+	return 1.0f; \
+}
+
+#define PK_UNROLL_FIXED		_Pragma("GCC unroll 8")
+
+#define PK_KERNEL_PAIR(name, START, STEP, esc_sq) \
+	PK_KERNEL(name, START, STEP, esc_sq, julia->max_iter, ) \
+	PK_KERNEL(name##_fixed, START, STEP, esc_sq, BATCH_UNROLLED_ITER, PK_UNROLL_FIXED)
+
+/*
+** Alternative Julia formulas by quaternion_formula (1 on): name, step,
+** squared escape radius of sample_4D_Julia_alternative_formula()
+*/
+#define PK_JULIA_FORMULAS(X) \
+	X(julia_cubic, PK_STEP_CUBIC, 16.0f) \
+	X(julia_square_linear, PK_STEP_SQUARE_LINEAR, 16.0f) \
+	X(julia_magnitude, PK_STEP_MAGNITUDE, 16.0f) \
+	X(julia_power2, PK_STEP_POWER(2), 16.0f) \
+	X(julia_power3, PK_STEP_POWER(3), 16.0f) \
+	X(julia_power4, PK_STEP_POWER(4), 16.0f) \
+	X(julia_power5, PK_STEP_POWER(5), 16.0f) \
+	X(julia_power6, PK_STEP_POWER(6), 16.0f) \
+	X(julia_power7, PK_STEP_POWER(7), 16.0f) \
+	X(julia_power8, PK_STEP_POWER(8), 16.0f)
+
+#define PK_JULIA_PAIR(name, STEP, esc_sq) PK_KERNEL_PAIR(name, PK_START_JULIA, STEP, esc_sq)
+#define PK_JULIA_ENTRY(name, STEP, esc_sq) {name, name##_fixed},
+
+PK_JULIA_FORMULAS(PK_JULIA_PAIR)
+PK_KERNEL_PAIR(mandelbrot, PK_START_MANDELBROT, PK_STEP_SQUARE, 4.0f)
+PK_KERNEL(julia_square_fixed, PK_START_JULIA, PK_STEP_SQUARE, 4.0f, BATCH_UNROLLED_ITER, PK_UNROLL_FIXED)
+
+static const t_point_kernel	g_julia_kernels[][2] = {
+	PK_JULIA_FORMULAS(PK_JULIA_ENTRY)
+};
+
+#define PK_JULIA_FORMULA_COUNT ((int)(sizeof(g_julia_kernels) / sizeof(g_julia_kernels[0])))
+
+/**
+ * @brief z^2 + c over max_iter, with sample_4D_Julia_optimized()'s cycle checks
+ */
+static float				julia_square(const t_sampler *s, float3 pos)
+{
+	return sample_4D_Julia_optimized(&s->julia, pos);
+}
+
+/**
+ * @brief Deep zoom kernels, given the unzoomed position
+ */
+static float				julia_deep_zoom(const t_sampler *s, float3 pos)
+{
+	double3					pos_d;
+
+	pos_d = (double3){pos.x, pos.y, pos.z};
+	return sample_4D_Julia_deep_zoom(&s->julia, pos_d, s->zoom_level);
+}
+
+static float				julia_double_double(const t_sampler *s, float3 pos)
+{
+	double3					pos_d;
+
+	pos_d = (double3){pos.x, pos.y, pos.z};
+	return sample_4D_Julia_double_double(&s->julia, pos_d, s->zoom_level);
+}
+
+/**
+ * @brief Blend of the Julia and Mandelbrot sets, varying with position
+ */
+static float				hybrid(const t_sampler *s, float3 pos)
+{
+	return sample_4D_hybrid(&s->julia, pos);
+}
+
+/**
+ * @brief The custom formula, as a batch of one
+ *
+ * Through the baseline interpreter, whose blocks are narrowest, since
+ * the other lanes would only be padding.
+ */
+static float				custom_formula(const t_sampler *s, float3 pos)
+{
+	float					v;
+
+	run_formula(SIMD_SCALAR, s->program, &s->julia, &pos.x, &pos.y, &pos.z, &v, 1);
+	return v;
+}
+
+/**
+ * @brief Signed distance, scaled back from zoomed to grid units
+ */
+static float				distance(const t_sampler *s, float3 pos)
+{
+	float					d;
+
+	d = sample_4D_distance(&s->julia, pos, s->fractal_type == 1, s->formula);
+	return s->zoom_level > 1.0 ? d * (float)s->zoom_level : d;
+}
+
+static float				escape_time(const t_sampler *s, float3 pos)
+{
+	return sample_4D_escape_time(&s->julia, pos, s->fractal_type == 1, s->formula);
+}
+
+/**
+ * @brief Point kernel for the configuration in s
+ */
+static t_point_kernel		point_kernel(const t_sampler *s)
+{
+	int						fixed;
+
+	if (s->field_kind == FIELD_DISTANCE)
+		return distance;
+	if (s->field_kind == FIELD_ESCAPE_TIME)
+		return escape_time;
+	fixed = s->julia.max_iter == BATCH_UNROLLED_ITER;
+	if (s->fractal_type == 1)
+		return fixed ? mandelbrot_fixed : mandelbrot;
+	if (s->fractal_type == 2)
+		return hybrid;
+	if (s->deep_zoom == DEEP_ZOOM_PERTURBATION)
+		return sample_4D_Julia_perturbation;
+	if (s->deep_zoom == DEEP_ZOOM_DOUBLE_DOUBLE)
+		return julia_double_double;
+	if (s->deep_zoom)
+		return julia_deep_zoom;
+	if (s->formula == FORMULA_CUSTOM)
+		return custom_formula;
+	if (s->formula > 0 && s->formula <= PK_JULIA_FORMULA_COUNT)
+		return g_julia_kernels[s->formula - 1][fixed];
+	return fixed ? julia_square_fixed : julia_square;
+}
+
+/**
+ * @brief Vector kernel family for the configuration in s
+ *
+ * BATCH_NONE where only the point kernels apply: supersampling,
+ * double-precision deep zoom, and distance and escape-time fields.
+ */
+static int					batch_kind(const t_sampler *s)
+{
+	if (s->supersampling > 1 || s->field_kind != FIELD_MEMBERSHIP)
+		return BATCH_NONE;
+	if (s->fractal_type == 1)
+		return BATCH_MANDELBROT;
+	if (s->fractal_type == 2)
+		return BATCH_HYBRID;
+	if (s->deep_zoom == DEEP_ZOOM_DOUBLE_DOUBLE)
+		return BATCH_DOUBLE_DOUBLE;
+	if (s->deep_zoom == DEEP_ZOOM_PERTURBATION)
+		return BATCH_PERTURBATION;
+	if (s->deep_zoom)
+		return BATCH_NONE;
+	if (s->formula == FORMULA_CUSTOM)
+		return BATCH_CUSTOM;
+	if (s->formula > 0 && s->formula <= BATCH_KINDS - BATCH_CUBIC)
+		return BATCH_CUBIC + s->formula - 1;
+	return BATCH_JULIA;
+}
+
+/**
+ * @brief Snapshot the sampler of the build about to run on data
+ *
+ * Reads field_kind, so it follows sampled_field_kind() in
+ * calculate_point_cloud(). The build samples through data->sampler only,
+ * so changes to data from then on do not reach it.
+ */
+void						init_sampler(t_data *data)
+{
+	t_sampler				*s;
+
+	s = &data->sampler;
+	memset(s, 0, sizeof(t_sampler));
+	s->julia = *data->fract->julia;
+	s->julia.cycle_skips = &data->cycle_skips;
+	s->zoom_level = data->zoom_level;
+	s->fractal_type = data->fractal_type;
+	s->formula = data->quaternion_formula;
+	s->field_kind = data->field_kind;
+	s->deep_zoom = deep_zoom_precision(data);
+	s->supersampling = data->supersampling;
+	s->step_size = data->fract->step_size;
+	s->simd_level = data->simd_level;
+	s->program = &data->custom_formula;
+	if (s->deep_zoom == DEEP_ZOOM_PERTURBATION)
+		prepare_reference_orbit(data);
+	resolve_sampler(s);
+}
+
+/**
+ * @brief Pick the kernels for s again after a build changed it
+ *
+ * For a pass that samples differently from the rest of the build, such
+ * as the two-level budget's low iteration cap.
+ */
+void						resolve_sampler(t_sampler *s)
+{
+	s->point_kernel = point_kernel(s);
+	s->batch_kind = batch_kind(s);
+}
@@ -0,0 +1,234 @@
+#include "morphosis.h"
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+** Work-stealing task runner for the fractal build.
+**
+** All tasks are known up front, so each worker's deque is simply a range
+** [head, tail) of task ids. The owner pops from the head, which keeps it
+** walking neighbouring bricks in order; idle workers steal from the tail
+** of a victim's range. Work is never created while running, so a worker
+** that finds every deque empty can stop.
+**
+** Helper threads are started on first use and then parked on a condition
+** variable between runs, so a build that runs a pass per plane does not
+** pay a thread creation per pass. One run owns the helpers at a time;
+** a run started from inside a task is done by its calling thread alone.
+*/
+
+typedef struct				s_task_deque
+{
+	pthread_mutex_t			lock;
+	uint					head;		// Next task the owner will run
+	uint					tail;		// One past the last task in the range
+}							t_task_deque;
+
+typedef struct				s_task_pool
+{
+	t_task_deque			*deques;
+	uint					num_workers;
+	uint					helpers;	// Parked threads joining as workers 1..helpers
+	t_task_fn				fn;
+	void					*ctx;
+}							t_task_pool;
+
+/*
+** The parked helpers. Helper i runs as worker i of the current job;
+** busy counts those of the job still running.
+*/
+typedef struct				s_task_threads
+{
+	pthread_mutex_t			run_lock;	// Held by the run that owns the helpers
+	pthread_mutex_t			lock;
+	pthread_cond_t			wake;
+	pthread_cond_t			done;
+	uint					started;
+	t_task_pool				*job;
+	unsigned long			generation;	// Bumped for every job
+	uint					busy;
+}							t_task_threads;
+
+typedef struct				s_task_worker
+{
+	t_task_pool				*pool;
+	uint					id;
+}							t_task_worker;
+
+static t_task_threads		g_threads = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+								PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, NULL, 0, 0};
+static __thread int			g_in_task;	// This thread is running tasks
+
+static int					pop_own_task(t_task_deque *dq, uint *task)
+{
+	int						found;
+
+	pthread_mutex_lock(&dq->lock);
+	found = dq->head < dq->tail;
+	if (found)
+		*task = dq->head++;
+	pthread_mutex_unlock(&dq->lock);
+	return found;
+}
+
+static int					steal_task(t_task_deque *dq, uint *task)
+{
+	int						found;
+
+	pthread_mutex_lock(&dq->lock);
+	found = dq->head < dq->tail;
+	if (found)
+		*task = --dq->tail;
+	pthread_mutex_unlock(&dq->lock);
+	return found;
+}
+
+static void					*task_worker(void *arg)
+{
+	t_task_worker			*w;
+	t_task_pool				*pool;
+	uint					task;
+	int						found;
+	int						nested;
+
+	w = (t_task_worker *)arg;
+	pool = w->pool;
+	nested = g_in_task;
+	g_in_task = 1;
+	while (1)
+	{
+		found = pop_own_task(&pool->deques[w->id], &task);
+		for (uint v = 1; !found && v < pool->num_workers; v++)
+			found = steal_task(&pool->deques[(w->id + v) % pool->num_workers], &task);
+		if (!found)
+			break;
+		pool->fn(pool->ctx, task, w->id);
+	}
+	g_in_task = nested;
+	return NULL;
+}
+
+/**
+ * @brief Body of a parked helper: join every job that has room for it
+ */
+static void					*helper_thread(void *arg)
+{
+	t_task_worker			w;
+	unsigned long			seen;
+
+	w.id = (uint)(size_t)arg;
+	seen = 0;
+	pthread_mutex_lock(&g_threads.lock);
+	while (1)
+	{
+		while (g_threads.generation == seen)
+			pthread_cond_wait(&g_threads.wake, &g_threads.lock);
+		seen = g_threads.generation;
+		if (!g_threads.job || w.id > g_threads.job->helpers)
+			continue;
+		w.pool = g_threads.job;
+		pthread_mutex_unlock(&g_threads.lock);
+		task_worker(&w);
+		pthread_mutex_lock(&g_threads.lock);
+		if (--g_threads.busy == 0)
+			pthread_cond_signal(&g_threads.done);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Start helpers until count are parked, as far as the system allows
+ *
+ * @return Helpers available
+ */
+static uint					start_helpers(uint count)
+{
+	pthread_t				thread;
+
+	while (g_threads.started < count)
+	{
+		if (pthread_create(&thread, NULL, helper_thread, (void *)(size_t)(g_threads.started + 1)) != 0)
+			break;
+		pthread_detach(thread);
+		g_threads.started++;
+	}
+	return g_threads.started < count ? g_threads.started : count;
+}
+
+/**
+ * @brief Number of worker threads to use by default (online CPUs)
+ */
+uint						default_thread_count(void)
+{
+	long					n;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+		return 1;
+	if (n > MAX_BUILD_THREADS)
+		return MAX_BUILD_THREADS;
+	return (uint)n;
+}
+
+/**
+ * @brief Run fn(ctx, task, worker) for every task in [0, num_tasks)
+ * 
+ * Tasks are split into contiguous ranges, one per worker, and balanced by
+ * work stealing. The calling thread acts as worker 0, parked helpers as
+ * the others. Worker ids are stable for the duration of the call and lie
+ * in [0, num_threads), so callers can index per-worker scratch state
+ * with them. Returns once every task has finished.
+ */
+void						run_tasks_stealing(uint num_tasks, uint num_threads, t_task_fn fn, void *ctx)
+{
+	t_task_pool				pool;
+	t_task_worker			caller;
+
+	if (num_threads < 1 || g_in_task)
+		num_threads = 1;
+	if (num_threads > MAX_BUILD_THREADS)
+		num_threads = MAX_BUILD_THREADS;
+	if (num_threads > num_tasks)
+		num_threads = num_tasks ? num_tasks : 1;
+	pool.num_workers = num_threads;
+	pool.helpers = 0;
+	pool.fn = fn;
+	pool.ctx = ctx;
+	if (!(pool.deques = (t_task_deque *)malloc(num_threads * sizeof(t_task_deque))))
+		error(MALLOC_FAIL_ERR, NULL);
+	for (uint w = 0; w < num_threads; w++)
+	{
+		pthread_mutex_init(&pool.deques[w].lock, NULL);
+		pool.deques[w].head = (uint)(((size_t)num_tasks * w) / num_threads);
+		pool.deques[w].tail = (uint)(((size_t)num_tasks * (w + 1)) / num_threads);
+	}
+	caller.pool = &pool;
+	caller.id = 0;
+	
+	// Ranges of helpers that could not be started are just stolen
+	if (num_threads > 1)
+	{
+		pthread_mutex_lock(&g_threads.run_lock);
+		pool.helpers = start_helpers(num_threads - 1);
+		pthread_mutex_lock(&g_threads.lock);
+		g_threads.job = &pool;
+		g_threads.busy = pool.helpers;
+		g_threads.generation++;
+		pthread_cond_broadcast(&g_threads.wake);
+		pthread_mutex_unlock(&g_threads.lock);
+	}
+	task_worker(&caller);
+	if (num_threads > 1)
+	{
+		pthread_mutex_lock(&g_threads.lock);
+		while (g_threads.busy)
+			pthread_cond_wait(&g_threads.done, &g_threads.lock);
+		g_threads.job = NULL;
+		pthread_mutex_unlock(&g_threads.lock);
+		pthread_mutex_unlock(&g_threads.run_lock);
+	}
+	
+	for (uint w = 0; w < num_threads; w++)
+		pthread_mutex_destroy(&pool.deques[w].lock);
+	free(pool.deques);
+}
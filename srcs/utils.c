@@ -1,65 +1,78 @@
 #include "morphosis.h"
 
 /**
- * @brief Initialize triangle memory pool for efficient allocation
+ * @brief Allocate an empty triangle buffer with the given capacity
  * 
- * Pre-allocates a large pool of triangle vertices to avoid frequent
- * malloc/free cycles during triangle generation.
+ * @return 1 on success, 0 if the allocation failed
  */
-void						init_triangle_pool(t_data *data)
+int							tribuf_init(t_tribuf *buf, uint capacity)
 {
-	// Estimate triangle pool size based on grid size
-	// Worst case: ~5 triangles per cube, 3 vertices per triangle
-	size_t cubes = pow(data->fract->grid_size, 3);
-	data->triangle_pool_size = cubes * 5 * 3; // Conservative estimate
-	
-	printf("\x1b[36m[%s]\x1b[0m Allocating triangle pool: %u vertices\n", 
-		   __FILE__, data->triangle_pool_size);
-	
-	if (!(data->triangle_pool = (float3 *)malloc(data->triangle_pool_size * sizeof(float3))))
-		error(MALLOC_FAIL_ERR, data);
-	
-	data->triangle_pool_used = 0;
+	buf->count = 0;
+	buf->capacity = capacity < FLAT_TRIANGLES_MIN ? FLAT_TRIANGLES_MIN : capacity;
+	buf->tris = (float3 *)malloc((size_t)buf->capacity * 3 * sizeof(float3));
+	return buf->tris != NULL;
 }
 
 /**
- * @brief Get pre-allocated triangle from memory pool
+ * @brief Ensure room for at least count more triangles
+ * 
+ * Doubles the capacity until the request fits, so appending n triangles
+ * costs O(log n) reallocations in total. A freed buffer starts over from
+ * FLAT_TRIANGLES_MIN.
  * 
- * Returns pointer to next available triangle (3 consecutive vertices)
- * from the pre-allocated pool, avoiding malloc overhead.
+ * @return 1 on success, 0 if the reallocation failed or the buffer
+ * would outgrow a uint count
  */
-float3						*get_triangle_from_pool(t_data *data)
+int							tribuf_reserve(t_tribuf *buf, uint count)
 {
-	if (data->triangle_pool_used + 3 > data->triangle_pool_size) {
-		// Pool exhausted, need to expand (fallback to malloc)
-		printf("\x1b[33m[%s]\x1b[0m Triangle pool exhausted, using fallback malloc\n", __FILE__);
-		return (float3 *)malloc(3 * sizeof(float3));
-	}
+	float3					*grown;
+	size_t					need;
+	size_t					limit;
+	size_t					capacity;
 	
-	float3 *triangle = &data->triangle_pool[data->triangle_pool_used];
-	data->triangle_pool_used += 3;
-	return triangle;
+	need = (size_t)buf->count + count;
+	if (need <= buf->capacity)
+		return 1;
+	
+	// Largest capacity both a uint count and the byte size hold
+	limit = SIZE_MAX / (3 * sizeof(float3));
+	if (limit > UINT_MAX)
+		limit = UINT_MAX;
+	if (need > limit)
+		return 0;
+	
+	// Double the capacity, stopping at the limit
+	capacity = buf->capacity ? buf->capacity : FLAT_TRIANGLES_MIN;
+	while (capacity < need)
+		capacity = capacity > limit / 2 ? limit : capacity * 2;
+	if (!(grown = (float3 *)realloc(buf->tris, capacity * 3 * sizeof(float3))))
+		return 0;
+	buf->tris = grown;
+	buf->capacity = (uint)capacity;
+	return 1;
 }
 
 /**
- * @brief Reset triangle pool for reuse
+ * @brief Append count triangles to a buffer with a single copy
+ * 
+ * @return 1 on success, 0 if the buffer could not grow
  */
-void						reset_triangle_pool(t_data *data)
+int							tribuf_append(t_tribuf *buf, float3 *tris, uint count)
 {
-	data->triangle_pool_used = 0;
+	if (!tribuf_reserve(buf, count))
+		return 0;
+	memcpy(&buf->tris[(size_t)buf->count * 3], tris, (size_t)count * 3 * sizeof(float3));
+	buf->count += count;
+	return 1;
 }
 
-/**
- * @brief Clean up triangle pool memory
- */
-void						clean_triangle_pool(t_data *data)
+void						tribuf_free(t_tribuf *buf)
 {
-	if (data->triangle_pool) {
-		free(data->triangle_pool);
-		data->triangle_pool = NULL;
-	}
-	data->triangle_pool_size = 0;
-	data->triangle_pool_used = 0;
+	if (buf->tris)
+		free(buf->tris);
+	buf->tris = NULL;
+	buf->count = 0;
+	buf->capacity = 0;
 }
 
 /**
@@ -67,22 +80,23 @@ void						clean_triangle_pool(t_data *data)
  * 
  * Creates a single contiguous array for all triangle vertices,
  * improving cache locality and reducing memory fragmentation.
+ * The mesh is a surface, so the initial capacity scales with the
+ * slice area rather than the volume; the buffer grows geometrically
+ * from there. An existing buffer is reused across regenerations.
  */
 void						init_flat_triangles(t_data *data)
 {
-	// Initial capacity based on grid size estimate
-	size_t cubes = pow(data->fract->grid_size, 3);
-	data->flat_triangle_capacity = cubes * 5; // Conservative estimate: 5 triangles per cube
+	data->flat.count = 0;
+	if (data->flat.tris)
+		return;
 	
-	printf("\x1b[36m[%s]\x1b[0m Allocating flat triangle storage: %u triangles\n", 
-		   __FILE__, data->flat_triangle_capacity);
+	// Initial capacity: ~2 triangles per cell of one grid slice
+	size_t cells = lattice_cells(data->fract);
 	
-	// Allocate flat array: capacity * 3 vertices per triangle
-	size_t vertices_needed = data->flat_triangle_capacity * 3;
-	if (!(data->flat_triangles = (float3 *)malloc(vertices_needed * sizeof(float3))))
+	printf("\x1b[36m[%s]\x1b[0m Allocating flat triangle storage: %zu triangles\n", 
+		   __FILE__, cells * cells * 2);
+	if (!tribuf_init(&data->flat, cells * cells * 2))
 		error(MALLOC_FAIL_ERR, data);
-	
-	data->flat_triangle_count = 0;
 }
 
 /**
@@ -93,23 +107,8 @@ void						init_flat_triangles(t_data *data)
  */
 void						add_triangle_to_flat(t_data *data, float3 *vertices)
 {
-	// Check if we need to expand capacity
-	if (data->flat_triangle_count >= data->flat_triangle_capacity) {
-		// Double the capacity
-		data->flat_triangle_capacity *= 2;
-		size_t new_size = data->flat_triangle_capacity * 3 * sizeof(float3);
-		
-		printf("\x1b[33m[%s]\x1b[0m Expanding flat triangle storage to %u triangles\n", 
-			   __FILE__, data->flat_triangle_capacity);
-		
-		if (!(data->flat_triangles = (float3 *)realloc(data->flat_triangles, new_size)))
-			error(MALLOC_FAIL_ERR, data);
-	}
-	
-	// Add triangle vertices to flat array (cache-friendly sequential access)
-	size_t base_index = data->flat_triangle_count * 3;
-	memcpy(&data->flat_triangles[base_index], vertices, sizeof(float3) * 3);
-	data->flat_triangle_count++;
+	if (!tribuf_append(&data->flat, vertices, 1))
+		error(MALLOC_FAIL_ERR, data);
 }
 
 /**
@@ -117,12 +116,82 @@ void						add_triangle_to_flat(t_data *data, float3 *vertices)
  */
 void						clean_flat_triangles(t_data *data)
 {
-	if (data->flat_triangles) {
-		free(data->flat_triangles);
-		data->flat_triangles = NULL;
+	tribuf_free(&data->flat);
+}
+
+/**
+ * @brief Initialize indexed mesh storage
+ * 
+ * Sized like the flat buffer (~2 triangles per cell of one slice); a
+ * closed marching cubes surface has about half as many vertices as
+ * triangles. Existing buffers are reused across regenerations.
+ */
+void						init_mesh(t_data *data)
+{
+	size_t					cells;
+
+	data->mesh.num_verts = 0;
+	data->mesh.num_indices = 0;
+	if (data->mesh.verts && data->mesh.indices)
+		return;
+	cells = lattice_cells(data->fract);
+	data->mesh.vert_capacity = cells * cells < FLAT_TRIANGLES_MIN ? FLAT_TRIANGLES_MIN : cells * cells;
+	data->mesh.index_capacity = data->mesh.vert_capacity * 6;
+	data->mesh.verts = (float3 *)malloc((size_t)data->mesh.vert_capacity * sizeof(float3));
+	data->mesh.indices = (uint *)malloc((size_t)data->mesh.index_capacity * sizeof(uint));
+	if (!data->mesh.verts || !data->mesh.indices)
+		error(MALLOC_FAIL_ERR, data);
+}
+
+/**
+ * @brief Append a vertex, doubling the storage when full
+ * 
+ * @return Index of the new vertex
+ */
+uint						mesh_add_vertex(t_mesh *mesh, float3 p)
+{
+	float3					*grown;
+
+	if (mesh->num_verts == mesh->vert_capacity)
+	{
+		mesh->vert_capacity *= 2;
+		if (!(grown = (float3 *)realloc(mesh->verts, (size_t)mesh->vert_capacity * sizeof(float3))))
+			error(MALLOC_FAIL_ERR, NULL);
+		mesh->verts = grown;
 	}
-	data->flat_triangle_count = 0;
-	data->flat_triangle_capacity = 0;
+	mesh->verts[mesh->num_verts] = p;
+	return mesh->num_verts++;
+}
+
+/**
+ * @brief Append one triangle by the indices of its three vertices
+ */
+void						mesh_add_triangle(t_mesh *mesh, uint a, uint b, uint c)
+{
+	uint					*grown;
+
+	if (mesh->num_indices + 3 > mesh->index_capacity)
+	{
+		mesh->index_capacity *= 2;
+		if (!(grown = (uint *)realloc(mesh->indices, (size_t)mesh->index_capacity * sizeof(uint))))
+			error(MALLOC_FAIL_ERR, NULL);
+		mesh->indices = grown;
+	}
+	mesh->indices[mesh->num_indices++] = a;
+	mesh->indices[mesh->num_indices++] = b;
+	mesh->indices[mesh->num_indices++] = c;
+}
+
+void						clean_mesh(t_data *data)
+{
+	if (data->mesh.verts)
+		free(data->mesh.verts);
+	if (data->mesh.indices)
+		free(data->mesh.indices);
+	data->mesh.verts = NULL;
+	data->mesh.indices = NULL;
+	data->mesh.num_verts = 0;
+	data->mesh.num_indices = 0;
 }
 
 float3 						**alloc_float3_arr(float3 **mem, uint2 *len)
@@ -7,6 +7,42 @@ static void						fetch_vertex_coords(float3 vertex, float *res)
 	res[2] = vertex.z;
 }
 
+/**
+ * @brief Write data->mesh: each shared vertex once, polygons by index
+ * 
+ * Every shell becomes its own surface of o, all sharing the vertices.
+ */
+static void					write_indexed_mesh(t_data *data, int surface, obj *o, float *vertex)
+{
+	int						first;
+	int						polygon;
+	int 					verts[3];
+	uint					*indices;
+	uint					shell;
+
+	first = -1;
+	for (uint v = 0; v < data->mesh.num_verts; v++)
+	{
+		int id = obj_add_vert(o);
+		if (first < 0)
+			first = id;
+		fetch_vertex_coords(data->mesh.verts[v], vertex);
+		obj_set_vert_v(o, id, vertex);
+	}
+	indices = data->mesh.indices;
+	shell = 0;
+	for (uint i = 0; i < data->gl->num_tris; i++)
+	{
+		printf("Written: %.3f %%\n", (((float)i / data->gl->num_tris) * 100));
+		for (; shell + 1 < data->num_shells && i == data->shell_start[shell + 1]; shell++)
+			surface = obj_add_surf(o);
+		polygon = obj_add_poly(o, surface);
+		for (int v = 0; v < 3; v++)
+			verts[v] = first + (int)indices[i * 3 + v];
+		obj_set_poly(o, surface, polygon, verts);
+	}
+}
+
 void 						export_obj(t_data *data)
 {
 	obj 					*o;
@@ -24,25 +60,37 @@ void 						export_obj(t_data *data)
 
 void						write_mesh(t_data *data, int surface, obj *o)
 {
-	float3 					**tris;
+	float3 					*tris;
 	uint 					i;
 	int						polygon;
 	int 					verts[3];
 	float 					*vertex;
 	float					percent;
+	uint					shell;
 
 	if (!(vertex = (float *)malloc(3 * sizeof(float))))
 		error(MALLOC_FAIL_ERR, data);
-	tris = data->triangles;
+	if (data->indexed_build)
+	{
+		write_indexed_mesh(data, surface, o, vertex);
+		free(vertex);
+		return;
+	}
+	tris = data->flat.tris;
 	i = 0;
+	shell = 0;
 	while (i < data->gl->num_tris)
 	{
 		printf("Written: %.3f %%\n", (((float)i / data->gl->num_tris) * 100));
+		
+		// Each escape-time shell is a surface of its own
+		for (; shell + 1 < data->num_shells && i == data->shell_start[shell + 1]; shell++)
+			surface = obj_add_surf(o);
 		polygon = obj_add_poly(o, surface);
 		for (int v = 0; v < 3; v++)
 		{
 			verts[v] = obj_add_vert(o);
-			fetch_vertex_coords(tris[i][v], vertex);
+			fetch_vertex_coords(tris[i * 3 + v], vertex);
 			obj_set_vert_v(o, verts[v], vertex);
 		}
 		obj_set_poly(o, surface, polygon, verts);
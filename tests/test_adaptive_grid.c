@@ -0,0 +1,137 @@
+#include "morphosis.h"
+
+/*
+** Coarse-to-fine sampling against the plain lattice.
+**
+** Builds each case's lattice at the default step and at FINE_STEP with
+** adaptive_grid off, then on at every max_grid_depth, and checks that both
+** classify all but MAX_MISMATCH of the lattice points alike. The default
+** grid is too coarse for bricks and clamps every depth to 0; FINE_STEP
+** must run depths up to FINE_DEPTH as set so subdivision is exercised.
+** Coarse-to-fine sampling may lose specks that touch no brick face, such
+** as the lone interior point of the max_iter 40 case, but never the
+** surface. Symmetry and culling stay off so the plain build iterates
+** every point.
+**
+** Run with `make test` or ctest.
+*/
+
+# define MAX_MISMATCH 1e-4			// Fraction of lattice points allowed to differ
+# define FINE_STEP 0.01f			// 300 cells per axis
+# define FINE_DEPTH 3				// Deepest level FINE_STEP must not clamp
+
+typedef struct				s_case
+{
+	const char				*name;
+	int						fractal_type;
+	int						formula;
+	uint					max_iter;		// 0 keeps the default
+}							t_case;
+
+static const t_case			g_cases[] = {
+	{"Julia, default", 0, 0, 0},
+	{"Julia, formula 1", 0, 1, 0},
+	{"Julia, formula 5", 0, 5, 0},
+	{"Julia, formula 8", 0, 8, 0},
+	{"Julia, max_iter 40", 0, 0, 40},
+	{"Mandelbrot", 1, 0, 0},
+};
+
+static void					build(t_data *data, const t_case *c, int depth)
+{
+	clean_calcs(data);
+	data->fractal_type = c->fractal_type;
+	data->quaternion_formula = c->formula;
+	if (c->max_iter)
+		data->fract->julia->max_iter = c->max_iter;
+	data->use_symmetry = 0;
+	data->use_culling = 0;
+	data->adaptive_grid = depth >= 0;
+	data->max_grid_depth = depth;
+	calculate_point_cloud(data);
+}
+
+/**
+ * @brief Lattice points the two bit-packed lattices disagree on
+ */
+static size_t				count_mismatches(const uint64_t *a, const uint64_t *b, size_t words)
+{
+	size_t					n;
+
+	n = 0;
+	for (size_t i = 0; i < words; i++)
+		n += (size_t)__builtin_popcountll(a[i] ^ b[i]);
+	return n;
+}
+
+/**
+ * @param step Lattice step, 0 keeps the default
+ * @return Whether every depth matches the plain build of c
+ */
+static int					run_case(const t_case *c, float step)
+{
+	t_data					*data;
+	uint64_t				*plain;
+	uint					plain_tris;
+	size_t					words;
+	size_t					points;
+	size_t					wrong;
+	int						ok;
+
+	data = init_data();
+	if (step > 0.0f)
+		data->fract->step_size = step;
+	build(data, c, -1);
+	if (!data->packed_lattice)
+	{
+		printf("\x1b[31m[%s]\x1b[0m %s: lattice not bit-packed\n", __FILE__, c->name);
+		clean_up(data);
+		return 0;
+	}
+	points = (size_t)data->lattice_dim * data->lattice_dim * data->lattice_dim;
+	words = (size_t)OCCUPANCY_WORDS(data->lattice_dim) * data->lattice_dim * data->lattice_dim;
+	if (!(plain = (uint64_t *)malloc(words * sizeof(uint64_t))))
+		error(MALLOC_FAIL_ERR, data);
+	memcpy(plain, data->occupancy, words * sizeof(uint64_t));
+	plain_tris = data->gl->num_tris;
+	if (!(ok = plain_tris > 0))
+		printf("\x1b[31m[%s]\x1b[0m %s: the plain build emits no triangles\n", __FILE__, c->name);
+	for (int depth = 0; depth <= LATTICE_MS_MAX_DEPTH; depth++)
+	{
+		build(data, c, depth);
+		if (step == FINE_STEP && depth <= FINE_DEPTH && coarse_to_fine_depth(data) != (uint)depth)
+		{
+			printf("\x1b[31m[%s]\x1b[0m %s, depth %d: clamped to %u at step %.2f\n",
+				   __FILE__, c->name, depth, coarse_to_fine_depth(data), step);
+			ok = 0;
+		}
+		wrong = count_mismatches(plain, data->occupancy, words);
+		if ((double)wrong > MAX_MISMATCH * (double)points || !data->gl->num_tris)
+		{
+			printf("\x1b[31m[%s]\x1b[0m %s, depth %d: %zu points differ, %u triangles instead of %u\n",
+				   __FILE__, c->name, depth, wrong, data->gl->num_tris, plain_tris);
+			ok = 0;
+		}
+	}
+	free(plain);
+	clean_up(data);
+	return ok;
+}
+
+int							main(void)
+{
+	const float				steps[] = {0.0f, FINE_STEP};
+	int						failed;
+
+	failed = 0;
+	for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++)
+		for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); i++)
+		{
+			if (run_case(&g_cases[i], steps[s]))
+				printf("\x1b[32m[%s]\x1b[0m %s, step %s: adaptive grid agrees with the plain lattice\n",
+					   __FILE__, g_cases[i].name, steps[s] > 0.0f ? "fine" : "default");
+			else
+				failed++;
+		}
+	return failed != 0;
+}